@@ -8,10 +8,12 @@
 
 #include "url.h"
 #include "libmcu/pubsub.h"
-#include "sleep.h"
+#include "apptimer.h"
 
 #define WIFI_SCAN_MAXLEN		10
 #define WIFI_PASS_MAXLEN		63
+/* lets the response go out before moving on */
+#define NOTIFY_DELAY_MSEC		500
 
 #if !defined(MIN)
 #define MIN(a, b)			(((a) > (b))? (b) : (a))
@@ -180,8 +182,15 @@ static bool save(const char *ssid, const char *pass)
 	return true;
 }
 
+static void notify_provisioned(void *context)
+{
+	(void)context;
+	pubsub_publish("wifi/provisioning", NULL, 0);
+}
+
 static int handler_post(httpd_req_t *req)
 {
+	static apptimer_t notify_timer;
 	const char *result_string = "Failed associating with the AP";
 	bool newly_saved = false;
 
@@ -223,9 +232,9 @@ out_free_ssid:
 out:
 	if (newly_saved) {
 		httpd_sess_trigger_close(req->handle, httpd_req_to_sockfd(req));
-		sleep_ms(500); // TODO: wait until response complete
-
-		pubsub_publish("wifi/provisioning", NULL, 0);
+		// TODO: notify when the response completes
+		apptimer_start(&notify_timer, NOTIFY_DELAY_MSEC,
+				notify_provisioned, NULL);
 	}
 
 	return 0;
@@ -57,6 +57,7 @@ static bool decode_json(void *outcome, const void *msg, size_t msgsize)
 	jsmn_value_t force = { 0, };
 	jsmn_value_t index = { 0, };
 	jsmn_value_t data = { 0, };
+	jsmn_value_t url = { 0, };
 
 	jsmn_get(jsmn, &type, "type");
 	jsmn_get(jsmn, &version, "version");
@@ -64,6 +65,7 @@ static bool decode_json(void *outcome, const void *msg, size_t msgsize)
 	jsmn_get(jsmn, &force, "force");
 	jsmn_get(jsmn, &index, "index");
 	jsmn_get(jsmn, &data, "data");
+	jsmn_get(jsmn, &url, "url");
 
 	if ((type.string != NULL && strncmp(type.string, "request",
 				MAX(type.length, 7)) == 0)
@@ -78,6 +80,13 @@ static bool decode_json(void *outcome, const void *msg, size_t msgsize)
 		target->file_size = size.uintval;
 		target->force =
 			!strncmp("true", force.string, MAX(4, force.length));
+		target->url[0] = '\0';
+		if (url.string != NULL && url.length < sizeof(target->url)) {
+			strncpy(target->url, url.string, url.length);
+			target->url[url.length] = '\0';
+		} else if (url.string != NULL) {
+			warn("url too long. falling back to chunks");
+		}
 		debug("version %s, size %d, force %d", target->version,
 				target->file_size, target->force);
 		return true;
@@ -8,6 +8,10 @@
 #include "ota/parser.h"
 
 #define OTA_VERSION_MAXLEN		12
+#define OTA_RTT_HISTOGRAM_BUCKETS	4
+#if !defined(OTA_URL_MAXLEN)
+#define OTA_URL_MAXLEN			128
+#endif
 
 typedef enum {
 	OTA_SUCCESS			= 0,
@@ -24,6 +28,8 @@ typedef struct ota_request {
 	size_t file_size;
 	uint16_t file_chunk_size;
 	int file_chunk_index;
+	/* the image is fetched from here when the protocol can download */
+	char url[OTA_URL_MAXLEN];
 } ota_request_t;
 
 typedef struct ota_data_chunk {
@@ -35,5 +41,8 @@ typedef struct ota_data_chunk {
 void ota_init(void *context, const ota_protocol_t *protocol,
 		const ota_parser_t *parser);
 void ota_start(void *context, const void *msg, size_t msgsize);
+/* called once a download ends, before rebooting on success. The statistics
+ * of the download are in the Ota* metrics by then. */
+void ota_register_result_handler(void (*handler)(ota_error_t error));
 
 #endif /* OTA_H */
@@ -16,6 +16,15 @@ typedef struct {
 	bool (*request)(void *context, const void *data, size_t datasize);
 	/* report the current version */
 	bool (*report)(void *context, const void *data, size_t datasize);
+	/* fetch the range of the image at url, optional. rx_data_handler
+	 * gets called as data arrives and true is returned only when the
+	 * whole range has been delivered. It may get more than the range up
+	 * to the end of the body, when the server doesn't do ranges */
+	bool (*download)(void *context, const char *url,
+			size_t offset, size_t size,
+			void (*rx_data_handler)(void *context,
+				const void *data, size_t datasize),
+			void *rx_context);
 } ota_protocol_t;
 
 #endif /* OTA_PROTOCOL_H */
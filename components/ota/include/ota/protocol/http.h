@@ -0,0 +1,17 @@
+#ifndef OTA_PROTOCOL_HTTP_H
+#define OTA_PROTOCOL_HTTP_H
+
+#include "ota/protocol.h"
+
+/* downloads the image with HTTP range requests. The version handshake and
+ * the chunked transfer fallback stay on MQTT.
+ *
+ * Limits:
+ * - plain http:// only. https:// urls are rejected as there is no TLS on
+ *   the socket
+ * - responses in Transfer-Encoding: chunked are rejected
+ * - a server ignoring Range gets the image streamed from the offset on to
+ *   its Content-Length in a single response, beyond the range asked */
+const ota_protocol_t *ota_http(void);
+
+#endif /* OTA_PROTOCOL_HTTP_H */
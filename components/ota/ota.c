@@ -9,20 +9,61 @@
 #include "libmcu/compiler.h"
 #include "libmcu/system.h"
 #include "libmcu/timext.h"
+#include "libmcu/metrics.h"
 
 #include "jobpool.h"
 #include "topic.h"
+#include "mqtt.h"
+#include "sleep.h"
+#include "uptime.h"
+#include "histogram.h"
 #include "dfu/dfu.h"
 
+#if !defined(MIN)
+#define MIN(a, b)			(((a) > (b))? (b) : (a))
+#endif
+#if !defined(MAX)
+#define MAX(a, b)			(((a) < (b))? (b) : (a))
+#endif
+
+#if !defined(DEFAULT_FILE_CHUNK_SIZE)
 #define DEFAULT_FILE_CHUNK_SIZE		128
+#endif
+#if !defined(MIN_FILE_CHUNK_SIZE)
+#define MIN_FILE_CHUNK_SIZE		64
+#endif
+/* room for the topic and JSON framing around the chunk data */
+#define FILE_CHUNK_OVERHEAD		128
+/* chunk data is base64-encoded, 4 bytes on the wire for every 3 bytes */
+#define FILE_CHUNK_SIZE_LIMIT		\
+	((MQTT_NETWORK_BUFSIZE - FILE_CHUNK_OVERHEAD) / 4 * 3)
+/* successful chunks in a row before doubling the chunk size */
+#define FILE_CHUNK_GROW_STREAK		4
+#if !defined(OTA_TIMEOUT_SEC)
 #define OTA_TIMEOUT_SEC			300 // 5-min
+#endif
+#if !defined(RTT_TIMEOUT_MSEC) /* the upper bound of retransmit timeout */
 #define RTT_TIMEOUT_MSEC		5000
+#endif
+#if !defined(RTO_INITIAL_MSEC)
+#define RTO_INITIAL_MSEC		1000
+#endif
+#if !defined(RTO_MIN_MSEC)
+#define RTO_MIN_MSEC			200
+#endif
+#if !defined(OTA_REBOOT_DELAY_MSEC) /* time to flush the final report */
+#define OTA_REBOOT_DELAY_MSEC		1000
+#endif
+#if !defined(OTA_RANGE_SIZE)
+#define OTA_RANGE_SIZE			(64U * 1024)
+#endif
 #define PAYLOAD_BUFSIZE			80
 
 static struct {
 	pthread_mutex_t lock;
 	bool active;
 	ota_request_t target;
+	size_t downloaded;
 	dfu_t *dfu;
 
 	struct {
@@ -30,18 +71,52 @@ static struct {
 		void *handle;
 	} protocol;
 
+	/* RFC 6298 retransmit timer and chunk size control */
+	struct {
+		unsigned int requested_at;
+		unsigned int srtt;
+		unsigned int rttvar;
+		unsigned int rto;
+		unsigned int requests;
+		unsigned int timeouts;
+		uint16_t max_chunk_size;
+		uint8_t streak;
+		bool measured;
+		bool retransmitted;
+	} link;
+
+	struct {
+		unsigned int started_at;
+		unsigned int flash_ms;
+		unsigned int validation_ms;
+		unsigned int retries;
+		unsigned int dropped;
+		unsigned int rtt_histogram[OTA_RTT_HISTOGRAM_BUCKETS];
+	} stats;
+
 	const ota_parser_t *parser;
+	void (*result_handler)(ota_error_t error);
 } m;
 
+/* upper bounds of the RTT histogram buckets, the last one is unbounded */
+static const unsigned int rtt_histogram_msec[OTA_RTT_HISTOGRAM_BUCKETS-1] = {
+	100, 300, 1000,
+};
+
 static size_t get_downloaded_size(void)
 {
-	return (size_t)(m.target.file_chunk_index-1) * m.target.file_chunk_size;
+	return m.downloaded;
+}
+
+static size_t get_expected_chunk_size(void)
+{
+	return MIN(m.target.file_chunk_size,
+			m.target.file_size - get_downloaded_size());
 }
 
 static bool is_ota_done(void)
 {
-	int index = m.target.file_chunk_index;
-	return (index > 0) && (get_downloaded_size() >= m.target.file_size);
+	return get_downloaded_size() >= m.target.file_size;
 }
 
 static void file_chunk_arrived(void *context, const void *data, size_t datasize)
@@ -57,46 +132,146 @@ static void file_chunk_arrived(void *context, const void *data, size_t datasize)
 	if (chunk.index != m.target.file_chunk_index) {
 		error("wrong index %d, %d expected",
 				chunk.index, m.target.file_chunk_index);
+		m.stats.dropped++;
 		goto out;
 	}
-	if (chunk.data_size < m.target.file_chunk_size
-			&& chunk.index < (int)(m.target.file_size
-				/ m.target.file_chunk_size - 1)) {
+	if (chunk.data_size != get_expected_chunk_size()) {
 		error("wrong data chunk #%d, size %d",
 				chunk.index, chunk.data_size);
+		m.stats.dropped++;
 		goto out;
 	}
 
 	debug("file chunk arrived %u", chunk.data_size);
 
+	unsigned int t0 = uptime_get_ms();
 	if (dfu_write(m.dfu, chunk.data, chunk.data_size)) {
-		m.target.file_chunk_index++;
+		m.downloaded += chunk.data_size;
 	}
+	m.stats.flash_ms += uptime_get_ms() - t0;
 out:
 	sem_post(next_chunk);
 }
 
-static bool send_request(void *handle, const ota_protocol_t *protocol,
-		const ota_parser_t *parser)
+static uint16_t get_max_chunk_size(void)
 {
-	if (m.target.file_chunk_size == 0) {
-		m.target.file_chunk_size = DEFAULT_FILE_CHUNK_SIZE;
+	uint16_t size = MIN_FILE_CHUNK_SIZE;
+
+	while (size * 2 <= FILE_CHUNK_SIZE_LIMIT) {
+		size = (uint16_t)(size * 2);
 	}
-	m.target.file_chunk_index = 1;
 
-	uint8_t buf[PAYLOAD_BUFSIZE];
-	size_t len = parser->encode(buf, sizeof(buf), &m.target);
-	return protocol->request(handle, buf, len);
+	return size;
+}
+
+static void record_rtt(unsigned int rtt)
+{
+	unsigned int i;
+
+	for (i = 0; i < OTA_RTT_HISTOGRAM_BUCKETS-1; i++) {
+		if (rtt < rtt_histogram_msec[i]) {
+			break;
+		}
+	}
+
+	m.stats.rtt_histogram[i]++;
+	histogram_record(OtaChunkRtt, rtt);
+}
+
+static void update_rto(unsigned int rtt)
+{
+	record_rtt(rtt);
+
+	if (!m.link.measured) {
+		m.link.srtt = rtt;
+		m.link.rttvar = rtt / 2;
+		m.link.measured = true;
+	} else {
+		unsigned int delta = m.link.srtt > rtt?
+			m.link.srtt - rtt : rtt - m.link.srtt;
+		m.link.rttvar = (3 * m.link.rttvar + delta) / 4;
+		m.link.srtt = (7 * m.link.srtt + rtt) / 8;
+	}
+
+	m.link.rto = m.link.srtt + MAX(4 * m.link.rttvar, 1U);
+	m.link.rto = MIN(MAX(m.link.rto, RTO_MIN_MSEC), RTT_TIMEOUT_MSEC);
+}
+
+static void adapt_to_arrival(void)
+{
+	/* Karn's algorithm: no samples from retransmitted requests */
+	if (!m.link.retransmitted) {
+		update_rto(uptime_get_ms() - m.link.requested_at);
+	}
+	m.link.retransmitted = false;
+
+	if (++m.link.streak < FILE_CHUNK_GROW_STREAK) {
+		return;
+	}
+
+	/* the next index is derived from the offset, so keep it aligned */
+	uint16_t next = (uint16_t)(m.target.file_chunk_size * 2);
+	if (next <= m.link.max_chunk_size
+			&& (get_downloaded_size() % next) == 0) {
+		m.target.file_chunk_size = next;
+		m.link.streak = 0;
+	}
+}
+
+static void adapt_to_timeout(void)
+{
+	m.link.timeouts++;
+	m.link.streak = 0;
+	m.link.retransmitted = true;
+	m.link.rto = MIN(m.link.rto * 2, RTT_TIMEOUT_MSEC);
+	m.target.file_chunk_size = (uint16_t)MAX(m.target.file_chunk_size / 2,
+			MIN_FILE_CHUNK_SIZE);
 }
 
 static bool proceed_next(void *handle, const ota_protocol_t *protocol,
 		const ota_parser_t *parser)
 {
+	if (m.link.retransmitted) {
+		m.stats.retries++;
+	}
+	m.target.file_chunk_index = (int)(get_downloaded_size()
+			/ m.target.file_chunk_size) + 1;
+	m.link.requested_at = uptime_get_ms();
+	m.link.requests++;
+
 	uint8_t buf[PAYLOAD_BUFSIZE];
 	size_t len = parser->encode(buf, sizeof(buf), &m.target);
 	return protocol->request(handle, buf, len);
 }
 
+static bool send_request(void *handle, const ota_protocol_t *protocol,
+		const ota_parser_t *parser)
+{
+	m.link.max_chunk_size = get_max_chunk_size();
+
+	if (m.target.file_chunk_size == 0) {
+		m.target.file_chunk_size = DEFAULT_FILE_CHUNK_SIZE;
+	}
+	m.target.file_chunk_size = MIN(m.target.file_chunk_size,
+			m.link.max_chunk_size);
+
+	return proceed_next(handle, protocol, parser);
+}
+
+static void range_arrived(void *context, const void *data, size_t datasize)
+{
+	/* a body longer than the image is none of it */
+	datasize = MIN(datasize, m.target.file_size - get_downloaded_size());
+
+	unsigned int t0 = uptime_get_ms();
+	if (dfu_write(m.dfu, data, datasize)) {
+		m.downloaded += datasize;
+	}
+	m.stats.flash_ms += uptime_get_ms() - t0;
+
+	unused(context);
+}
+
 static bool send_current_version(void *handle, const ota_protocol_t *protocol,
 		const ota_parser_t *parser)
 {
@@ -114,57 +289,164 @@ static bool report_failure(void *handle, const ota_protocol_t *protocol,
 	return send_current_version(handle, protocol, parser);
 }
 
-static bool ota_run(void *handle, const ota_protocol_t *protocol,
-		const ota_parser_t *parser)
+static void update_metrics(ota_error_t error)
+{
+	unsigned int elapsed = uptime_get_ms() - m.stats.started_at;
+	uint64_t bps = elapsed? (uint64_t)get_downloaded_size() * 1000
+		/ elapsed : 0;
+
+	metrics_set(OtaResult, (int32_t)error);
+	metrics_set(OtaBytesPerSec, (int32_t)bps);
+	metrics_set(OtaSmoothedRtt, (int32_t)m.link.srtt);
+	metrics_set(OtaRttUnder100ms, (int32_t)m.stats.rtt_histogram[0]);
+	metrics_set(OtaRttUnder300ms, (int32_t)m.stats.rtt_histogram[1]);
+	metrics_set(OtaRttUnder1s, (int32_t)m.stats.rtt_histogram[2]);
+	metrics_set(OtaRttOver1s, (int32_t)m.stats.rtt_histogram[3]);
+	metrics_set(OtaRetries, (int32_t)m.stats.retries);
+	metrics_set(OtaTimeouts, (int32_t)m.link.timeouts);
+	metrics_set(OtaDroppedChunks, (int32_t)m.stats.dropped);
+	metrics_set(OtaFlashWriteTime, (int32_t)m.stats.flash_ms);
+	metrics_set(OtaValidationTime, (int32_t)m.stats.validation_ms);
+
+	info("%u bytes in %ums, %u requests, %u timed out",
+			get_downloaded_size(), elapsed,
+			m.link.requests, m.link.timeouts);
+}
+
+static bool download_in_chunks(void *handle, const ota_protocol_t *protocol,
+		const ota_parser_t *parser, unsigned int tout)
 {
 	sem_t next_chunk;
-	bool rc = false;
 
 	if (sem_init(&next_chunk, 0, 0) != 0) {
 		return false;
 	}
-	if ((m.dfu = dfu_new()) == NULL) {
-		return false;
-	}
 	if (!protocol->prepare(handle, file_chunk_arrived, &next_chunk)) {
 		return false;
 	}
 	if (!send_request(handle, protocol, parser)) {
+		protocol->finish(handle);
 		return false;
 	}
 
-	unsigned int tout;
-	timeout_set(&tout, OTA_TIMEOUT_SEC * 1000U);
 	while (!timeout_is_expired(tout)) {
-		if (sem_timedwait(&next_chunk, RTT_TIMEOUT_MSEC) != 0) {
-			error("timed out");
+		size_t downloaded = get_downloaded_size();
+
+		if (sem_timedwait(&next_chunk, m.link.rto) != 0) {
+			error("timed out in %ums", m.link.rto);
+			adapt_to_timeout();
+		} else if (get_downloaded_size() != downloaded) {
+			adapt_to_arrival();
+		} else { /* stale or broken one. wait for the requested chunk */
+			continue;
 		}
+
 		if (is_ota_done()) {
-			rc = dfu_validate(m.dfu);
-			if (rc) {
-				rc = dfu_register(m.dfu);
-			} else {
-				error("invalid image");
-			}
-			info("DFU #%d %s", dfu_count(), rc? "requested":"failed");
 			break;
 		}
 		if (!proceed_next(handle, protocol, parser)) {
 			// error
 		}
 
-		info("%u/%u downloaded",
-				get_downloaded_size(), m.target.file_size);
+		info("%u/%u downloaded, chunk %u, srtt %ums",
+				get_downloaded_size(), m.target.file_size,
+				m.target.file_chunk_size, m.link.srtt);
 	}
 
 	protocol->finish(handle);
 
+	return is_ota_done();
+}
+
+static bool download_in_ranges(void *handle, const ota_protocol_t *protocol,
+		unsigned int tout)
+{
+	while (!is_ota_done() && !timeout_is_expired(tout)) {
+		size_t offset = get_downloaded_size();
+		size_t size = MIN(OTA_RANGE_SIZE, m.target.file_size - offset);
+
+		m.link.requests++;
+
+		if (!protocol->download(handle, m.target.url, offset, size,
+					range_arrived, NULL)) {
+			/* resume from where it stopped after a while */
+			error("range %u+%u failed. %u received in %ums",
+					offset, size,
+					get_downloaded_size() - offset,
+					m.link.rto);
+			m.link.timeouts++;
+			m.stats.retries++;
+			sleep_ms(m.link.rto);
+			m.link.rto = MIN(m.link.rto * 2, RTT_TIMEOUT_MSEC);
+			continue;
+		}
+
+		m.link.rto = RTO_INITIAL_MSEC;
+		info("%u/%u downloaded", get_downloaded_size(),
+				m.target.file_size);
+	}
+
+	return is_ota_done();
+}
+
+static ota_error_t ota_run(void *handle, const ota_protocol_t *protocol,
+		const ota_parser_t *parser)
+{
+	ota_error_t rc = OTA_TIMEOUT;
+	bool downloaded;
+	unsigned int tout;
+
+	if ((m.dfu = dfu_new()) == NULL) {
+		return OTA_NO_ENOUGH_SPACE;
+	}
+
+	memset(&m.link, 0, sizeof(m.link));
+	memset(&m.stats, 0, sizeof(m.stats));
+	m.stats.started_at = uptime_get_ms();
+	m.link.rto = RTO_INITIAL_MSEC;
+	m.downloaded = 0;
+
+	timeout_set(&tout, OTA_TIMEOUT_SEC * 1000U);
+
+	if (protocol->download != NULL && m.target.url[0] != '\0') {
+		info("downloading from %s", m.target.url);
+		downloaded = download_in_ranges(handle, protocol, tout);
+	} else {
+		downloaded = download_in_chunks(handle, protocol, parser, tout);
+	}
+
+	if (downloaded) {
+		unsigned int t0 = uptime_get_ms();
+		bool valid = dfu_validate(m.dfu);
+		m.stats.validation_ms = uptime_get_ms() - t0;
+
+		if (!valid) {
+			error("invalid image");
+			rc = OTA_CORRUPTED_FILE;
+		} else if (!dfu_register(m.dfu)) {
+			rc = OTA_CANCELED;
+		} else {
+			rc = OTA_SUCCESS;
+		}
+		info("DFU #%d %s", dfu_count(),
+				rc == OTA_SUCCESS? "requested":"failed");
+	}
+
+	update_metrics(rc);
+
 	return rc;
 }
 
 static void ota_task(void *context)
 {
-	if (ota_run(context, m.protocol.ops, m.parser)) {
+	ota_error_t rc = ota_run(context, m.protocol.ops, m.parser);
+
+	if (m.result_handler != NULL) {
+		m.result_handler(rc);
+	}
+
+	if (rc == OTA_SUCCESS) {
+		sleep_ms(OTA_REBOOT_DELAY_MSEC);
 		system_reboot();
 	}
 
@@ -209,7 +491,12 @@ void ota_start(void *context, const void *msg, size_t msgsize)
 	}
 
 	memcpy(&m.target, &target, sizeof(m.target));
-	jobpool_schedule(ota_task, context);
+	jobpool_schedule_prio(JOBPOOL_PRIO_BULK, ota_task, context, 0);
+}
+
+void ota_register_result_handler(void (*handler)(ota_error_t error))
+{
+	m.result_handler = handler;
 }
 
 void ota_init(void *handle, const ota_protocol_t *protocol,
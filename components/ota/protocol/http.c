@@ -0,0 +1,324 @@
+#include "ota/protocol/http.h"
+#include "ota/protocol/mqtt.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netdb.h>
+
+#include "libmcu/logging.h"
+#include "libmcu/compiler.h"
+
+#if !defined(MIN)
+#define MIN(a, b)			(((a) > (b))? (b) : (a))
+#endif
+
+#if !defined(OTA_HTTP_BUFSIZE)
+#define OTA_HTTP_BUFSIZE		1024
+#endif
+#if !defined(OTA_HTTP_TIMEOUT_SEC)
+#define OTA_HTTP_TIMEOUT_SEC		10
+#endif
+#define HOST_MAXLEN			64
+#define PORT_MAXLEN			6
+
+struct url {
+	char host[HOST_MAXLEN];
+	char port[PORT_MAXLEN];
+	bool port_given;
+	const char *path;
+};
+
+static struct {
+	ota_protocol_t ops;
+	char buf[OTA_HTTP_BUFSIZE];
+} m;
+
+static bool parse_url(struct url *url, const char *str)
+{
+	const char *scheme = "http://";
+	size_t scheme_len = strlen(scheme);
+
+	if (strncmp(str, scheme, scheme_len) != 0) {
+		return false;
+	}
+
+	const char *host = &str[scheme_len];
+	const char *path = strchr(host, '/');
+	if (path == NULL) {
+		path = &host[strlen(host)];
+	}
+	const char *colon = memchr(host, ':', (size_t)(path - host));
+	size_t host_len = (size_t)((colon != NULL? colon : path) - host);
+
+	if (host_len == 0 || host_len >= sizeof(url->host)) {
+		return false;
+	}
+	memcpy(url->host, host, host_len);
+	url->host[host_len] = '\0';
+
+	if (colon != NULL) {
+		size_t port_len = (size_t)(path - colon - 1);
+		if (port_len == 0 || port_len >= sizeof(url->port)) {
+			return false;
+		}
+		memcpy(url->port, &colon[1], port_len);
+		url->port[port_len] = '\0';
+	} else {
+		strcpy(url->port, "80");
+	}
+
+	url->port_given = strcmp(url->port, "80") != 0;
+
+	url->path = *path != '\0'? path : "/";
+
+	return true;
+}
+
+static int connect_to(const struct url *url)
+{
+	struct addrinfo hints = {
+		.ai_family = AF_INET,
+		.ai_socktype = SOCK_STREAM,
+	};
+	struct addrinfo *res = NULL;
+
+	if (getaddrinfo(url->host, url->port, &hints, &res) != 0
+			|| res == NULL) {
+		return -1;
+	}
+
+	int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+	if (fd >= 0) {
+		struct timeval tv = { .tv_sec = OTA_HTTP_TIMEOUT_SEC, };
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+		setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+		if (connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+			close(fd);
+			fd = -1;
+		}
+	}
+
+	freeaddrinfo(res);
+
+	return fd;
+}
+
+static bool send_all(int fd, const char *data, size_t datasize)
+{
+	while (datasize > 0) {
+		ssize_t n = send(fd, data, datasize, 0);
+		if (n <= 0) {
+			return false;
+		}
+		data += n;
+		datasize -= (size_t)n;
+	}
+
+	return true;
+}
+
+/* reads until the end of the response header. m.buf holds the header
+ * followed by the first bytes of the body then. */
+static bool read_header(int fd, size_t *header_len, size_t *received)
+{
+	size_t len = 0;
+
+	while (len < sizeof(m.buf) - 1) {
+		ssize_t n = recv(fd, &m.buf[len], sizeof(m.buf) - 1 - len, 0);
+		if (n <= 0) {
+			return false;
+		}
+		len += (size_t)n;
+		m.buf[len] = '\0';
+
+		const char *end = strstr(m.buf, "\r\n\r\n");
+		if (end != NULL) {
+			*header_len = (size_t)(end - m.buf) + 4;
+			*received = len;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static const char *get_header_field(const char *name, size_t header_len)
+{
+	size_t name_len = strlen(name);
+	const char *p = m.buf;
+
+	while (p != NULL && p < &m.buf[header_len]) {
+		if (strncasecmp(p, name, name_len) == 0 && p[name_len] == ':') {
+			p = &p[name_len + 1];
+			while (*p == ' ') {
+				p++;
+			}
+			return p;
+		}
+		if ((p = strstr(p, "\r\n")) != NULL) {
+			p += 2;
+		}
+	}
+
+	return NULL;
+}
+
+/* A server not doing ranges answers 200 with the whole image. The body is
+ * taken from the offset on to the Content-Length then, so the rest of the
+ * image still comes in a single pass rather than failing every range.
+ * Without the length given, it stops at the range asked. */
+static bool get_body_range(size_t offset, size_t size, size_t header_len,
+		size_t *skip, size_t *want)
+{
+	int status = 0;
+
+	if (sscanf(m.buf, "HTTP/%*d.%*d %d", &status) != 1) {
+		return false;
+	}
+
+	const char *encoding = get_header_field("Transfer-Encoding",
+			header_len);
+	if (encoding != NULL && strncasecmp(encoding, "chunked", 7) == 0) {
+		error("chunked transfer encoding not supported");
+		return false;
+	}
+
+	if (status == 200) {
+		const char *length = get_header_field("Content-Length",
+				header_len);
+		size_t body_len = length != NULL?
+			(size_t)strtoul(length, NULL, 10) : offset + size;
+
+		if (body_len <= offset) {
+			error("body of %lu ends before %lu",
+					(unsigned long)body_len,
+					(unsigned long)offset);
+			return false;
+		}
+
+		warn("range ignored. taking the body from %lu to %lu",
+				(unsigned long)offset, (unsigned long)body_len);
+		*skip = offset;
+		*want = body_len - offset;
+		return true;
+	} else if (status != 206) {
+		error("http status %d", status);
+		return false;
+	}
+
+	const char *range = get_header_field("Content-Range", header_len);
+	if (range == NULL || strncmp(range, "bytes ", 6) != 0) {
+		return false;
+	}
+
+	*skip = 0;
+	*want = size;
+
+	return strtoul(&range[6], NULL, 10) == offset;
+}
+
+static size_t feed(const char *data, size_t datasize,
+		size_t *skip, size_t want,
+		void (*rx_data_handler)(void *context,
+			const void *data, size_t datasize),
+		void *rx_context)
+{
+	if (*skip >= datasize) {
+		*skip -= datasize;
+		return 0;
+	}
+
+	data += *skip;
+	datasize = MIN(datasize - *skip, want);
+	*skip = 0;
+
+	if (datasize > 0) {
+		rx_data_handler(rx_context, data, datasize);
+	}
+
+	return datasize;
+}
+
+static bool download(void *context, const char *url_str,
+		size_t offset, size_t size,
+		void (*rx_data_handler)(void *context,
+			const void *data, size_t datasize),
+		void *rx_context)
+{
+	struct url url;
+	size_t received = 0;
+	size_t header_len;
+	size_t len;
+	size_t skip;
+	size_t want;
+	int fd;
+
+	unused(context);
+
+	if (size == 0) {
+		return true;
+	}
+	if (!parse_url(&url, url_str)) {
+		error("unsupported url %s", url_str);
+		return false;
+	}
+	if ((fd = connect_to(&url)) < 0) {
+		error("cannot connect to %s:%s", url.host, url.port);
+		return false;
+	}
+
+	/* the port goes along unless it is the default one. RFC 7230 5.4 */
+	int n = snprintf(m.buf, sizeof(m.buf), "GET %s HTTP/1.1\r\n"
+			"Host: %s%s%s\r\n"
+			"Range: bytes=%lu-%lu\r\n"
+			"Connection: close\r\n\r\n",
+			url.path, url.host, url.port_given? ":" : "",
+			url.port_given? url.port : "", (unsigned long)offset,
+			(unsigned long)(offset + size - 1));
+	if (n <= 0 || (size_t)n >= sizeof(m.buf)
+			|| !send_all(fd, m.buf, (size_t)n)) {
+		goto out;
+	}
+
+	if (!read_header(fd, &header_len, &len)
+			|| !get_body_range(offset, size, header_len,
+				&skip, &want)) {
+		goto out;
+	}
+
+	received = feed(&m.buf[header_len], len - header_len, &skip, want,
+			rx_data_handler, rx_context);
+
+	while (received < want) {
+		size_t left = want - received + skip;
+
+		ssize_t bytes = recv(fd, m.buf, MIN(sizeof(m.buf), left), 0);
+		if (bytes <= 0) {
+			break;
+		}
+		received += feed(m.buf, (size_t)bytes, &skip, want - received,
+				rx_data_handler, rx_context);
+	}
+out:
+	close(fd);
+
+	return received >= size;
+}
+
+const ota_protocol_t *ota_http(void)
+{
+	if (m.ops.download == NULL) {
+		memcpy(&m.ops, ota_mqtt(), sizeof(m.ops));
+		m.ops.name = "http";
+		m.ops.download = download;
+	}
+
+	return &m.ops;
+}
@@ -0,0 +1,44 @@
+#ifndef APPTIMER_H
+#define APPTIMER_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stdbool.h>
+
+/* One-shot timers on a hashed timing wheel, all driven by a single
+ * hardware timer of the port. Callbacks run in the context of the port
+ * timer. Anything that may block should go on to the jobpool from there.
+ * A callback may start its own timer again for a retry. */
+typedef struct apptimer {
+	struct apptimer *next;
+	struct apptimer *prev;
+	unsigned int expiry; /* uptime in ms */
+	void (*callback)(void *context);
+	void *context;
+	bool pending;
+} apptimer_t;
+
+bool apptimer_init(void);
+/* restarts the timer when it's pending already */
+bool apptimer_start(apptimer_t *timer, unsigned int delay_ms,
+		void (*callback)(void *context), void *context);
+/* returns false when the timer was not pending */
+bool apptimer_stop(apptimer_t *timer);
+bool apptimer_is_pending(const apptimer_t *timer);
+/* runs the timers expired and arms the hardware timer for the next,
+ * returning milliseconds to it, 0 for none. Called by the port when the
+ * hardware timer fires. */
+unsigned int apptimer_process(unsigned int now_ms);
+
+/* provided by the port. apptimer_hw_arm() makes apptimer_process() get
+ * called after delay_ms, replacing the one armed before. */
+extern bool apptimer_hw_init(void);
+extern void apptimer_hw_arm(unsigned int delay_ms);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* APPTIMER_H */
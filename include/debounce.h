@@ -0,0 +1,68 @@
+#ifndef DEBOUNCE_H
+#define DEBOUNCE_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if !defined(DEBOUNCE_QUEUE_LEN)
+#define DEBOUNCE_QUEUE_LEN			16 /* must be a power of 2 */
+#endif
+
+struct debounce_edge {
+	uint32_t usec;
+	uint8_t channel;
+	bool pressed;
+};
+
+/* Lock-free ring of edges from a single producer, the ISR, to a single
+ * consumer, the debounce task. */
+struct debounce_queue {
+	uint32_t head; /* written by the producer only */
+	uint32_t tail; /* written by the consumer only */
+	uint32_t dropped;
+	struct debounce_edge edges[DEBOUNCE_QUEUE_LEN];
+};
+
+/* Safe to call from an ISR. An edge dropped for the queue being full still
+ * gets caught up with when the channel settles. */
+static inline bool debounce_push(struct debounce_queue *q,
+		uint8_t channel, bool pressed, uint32_t usec)
+{
+	uint32_t head = q->head;
+
+	if (head - __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE)
+			>= DEBOUNCE_QUEUE_LEN) {
+		q->dropped++;
+		return false;
+	}
+
+	q->edges[head & (DEBOUNCE_QUEUE_LEN - 1)] = (struct debounce_edge) {
+		.usec = usec,
+		.channel = channel,
+		.pressed = pressed,
+	};
+	__atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+/* The first edge of a channel takes effect at once and the ones following
+ * within DEBOUNCE_LOCKOUT_USEC are taken as bounce. get_level reads the
+ * channel when the lockout is over not to miss the last one. */
+void debounce_init(unsigned int nr_channels,
+		void (*changed)(unsigned int channel, bool pressed,
+			uint32_t usec),
+		int (*get_level)(unsigned int channel));
+/* drains the queue. Returns microseconds to come back after for a channel
+ * still settling or 0 when all settled. */
+uint32_t debounce_process(struct debounce_queue *q, uint32_t now_usec);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* DEBOUNCE_H */
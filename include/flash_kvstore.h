@@ -0,0 +1,33 @@
+#ifndef FLASH_KVSTORE_H
+#define FLASH_KVSTORE_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libmcu/kvstore.h"
+#include "dfu/io.h"
+
+/* Log-structured kvstore on a raw flash region of nr_sectors erasable
+ * sectors starting at base. Records are only appended, each with its CRC,
+ * and stale ones are reclaimed sector by sector keeping one sector spare.
+ * An index in RAM is rebuilt from the log on open so that a record torn by
+ * power loss just gets dropped. At least two sectors are required.
+ *
+ * Keys are up to 15 characters as in NVS. */
+kvstore_t *flash_kvstore_new(const dfu_io_t *io, uintptr_t base,
+		size_t sector_size, unsigned int nr_sectors);
+void flash_kvstore_delete(kvstore_t *kvstore);
+bool flash_kvstore_remove(kvstore_t *kvstore, const char *key);
+/* the number of keys stored */
+size_t flash_kvstore_count(const kvstore_t *kvstore);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* FLASH_KVSTORE_H */
@@ -0,0 +1,41 @@
+#ifndef GESTURE_H
+#define GESTURE_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+	GESTURE_PRESS			= 0, /* at once on every press */
+	GESTURE_CLICK,
+	GESTURE_DOUBLE_CLICK,
+	GESTURE_TRIPLE_CLICK,
+	GESTURE_LONG_PRESS,
+	GESTURE_HOLD_REPEAT, /* while held after a long press */
+	GESTURE_MAX,
+} gesture_t;
+
+struct gesture_timing {
+	uint16_t click_gap_ms; /* between a release and the next press */
+	uint16_t long_press_ms;
+	uint16_t repeat_ms;
+};
+
+/* timing falls back to GESTURE_*_MSEC when NULL */
+void gesture_init(unsigned int nr_channels,
+		const struct gesture_timing *timing,
+		void (*recognized)(unsigned int channel, gesture_t gesture));
+/* takes a debounced edge. Constant time. */
+void gesture_feed(unsigned int channel, bool pressed, uint32_t usec);
+/* recognizes what only time can tell, a click not followed by another or a
+ * press held. Returns microseconds to come back after or 0 when idle. */
+uint32_t gesture_poll(uint32_t now_usec);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* GESTURE_H */
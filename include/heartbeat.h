@@ -0,0 +1,41 @@
+#ifndef HEARTBEAT_H
+#define HEARTBEAT_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+#include "libmcu/metrics.h"
+#include "histogram.h"
+
+enum {
+	HEARTBEAT_NR_METRICS = 0
+#define METRICS_DEFINE(id, key)			+ 1
+#include "metrics.def"
+#undef METRICS_DEFINE
+	,
+	/* when every metric and bucket is nonzero */
+	HEARTBEAT_MAXLEN = 4 + HEARTBEAT_NR_METRICS * (2 + 5)
+		+ HISTOGRAM_MAX * (2 + HISTOGRAM_BUCKETS * (1 + 3)),
+};
+
+/* Encodes the metrics and histograms returning the bytes written, 0 when
+ * the buffer is too small:
+ *
+ *   heartbeat := 'H' version(1) nr_metrics metric* nr_histograms histogram*
+ *   metric    := key_delta value
+ *   histogram := key_delta nr_buckets bucket*
+ *   bucket    := index_delta count
+ *
+ * Zeros are left out. Keys and bucket indexes go as the difference from
+ * the previous one, the first from 0. All numbers are LEB128 varints and
+ * metric values are zigzag encoded. */
+size_t heartbeat_encode(void *buf, size_t bufsize);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* HEARTBEAT_H */
@@ -0,0 +1,31 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+typedef enum {
+#define HISTOGRAM_DEFINE(id, key)		key = id,
+#include "histogram.def"
+#undef HISTOGRAM_DEFINE
+	HISTOGRAM_MAX,
+} histogram_key_t;
+
+/* Bucket 0 counts zeros and bucket n values in [2^(n-1), 2^n). The last
+ * bucket takes the rest. Values are in the unit given in histogram.def. */
+#define HISTOGRAM_BUCKETS			24
+
+void histogram_record(histogram_key_t key, uint32_t value);
+/* counts saturate at UINT16_MAX until reset */
+void histogram_get(histogram_key_t key, uint16_t counts[HISTOGRAM_BUCKETS]);
+void histogram_reset(void);
+unsigned int histogram_get_bucket(uint32_t value);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* HISTOGRAM_H */
@@ -0,0 +1,66 @@
+#ifndef JOBPOOL_H
+#define JOBPOOL_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stdbool.h>
+
+/* Each lane has its own queue and workers. A worker serves its own lane and
+ * the ones above it, higher first, so a job never waits behind a job of a
+ * lower lane however long that runs. */
+typedef enum {
+	JOBPOOL_PRIO_HIGH, /* latency sensitive like buttons. must not block */
+	JOBPOOL_PRIO_NORMAL,
+	JOBPOOL_PRIO_LOW, /* connectivity like reconnecting. may block a while */
+	/* long running like an OTA download, not to hold the reconnection */
+	JOBPOOL_PRIO_BULK,
+	JOBPOOL_PRIO_MAX,
+} jobpool_prio_t;
+
+/* under 10ms, 100ms, 1s and the rest */
+#define JOBPOOL_HISTOGRAM_BUCKETS		4
+/* job functions tracked apart. The rest add up in an entry of their own */
+#if !defined(JOBPOOL_STATS_JOBS)
+#define JOBPOOL_STATS_JOBS			4
+#endif
+#define JOBPOOL_STATS_MAX			(JOBPOOL_STATS_JOBS + 1)
+#define JOBPOOL_STATS_OTHER			JOBPOOL_STATS_JOBS
+
+/* per job function, since the last reset */
+struct jobpool_stats {
+	void (*job)(void *context); /* NULL for the other jobs */
+	unsigned int wait[JOBPOOL_HISTOGRAM_BUCKETS]; /* from enqueue to run */
+	unsigned int run[JOBPOOL_HISTOGRAM_BUCKETS];
+	unsigned int max_wait_ms;
+	unsigned int max_run_ms;
+	unsigned int expired;
+	unsigned int rejected;
+};
+
+bool jobpool_init(void);
+/* stops the workers after the jobs running. Pending jobs get dropped */
+void jobpool_deinit(void);
+/* on the normal lane without a deadline */
+bool jobpool_schedule(void (*job)(void *context), void *job_context);
+/* Jobs of a lane run the earliest deadline first. A job not started within
+ * deadline_ms gets dropped without running, 0 for no deadline. */
+bool jobpool_schedule_prio(jobpool_prio_t prio,
+		void (*job)(void *context), void *job_context,
+		unsigned int deadline_ms);
+/* the number of jobs pending */
+unsigned int jobpool_count(void);
+/* The first JOBPOOL_STATS_JOBS job functions seen since the last reset take
+ * an entry each in the order seen. Any other job counts in the entry of
+ * JOBPOOL_STATS_OTHER. Unused entries are all zero. */
+void jobpool_get_stats(struct jobpool_stats stats[JOBPOOL_STATS_MAX]);
+/* the most jobs the lane held at a time since the last reset */
+unsigned int jobpool_get_max_depth(jobpool_prio_t prio);
+void jobpool_reset_stats(void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* JOBPOOL_H */
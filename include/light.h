@@ -1,10 +0,0 @@
-#ifndef LIGHT_H
-#define LIGHT_H
-
-#include <stdbool.h>
-
-struct light {
-	bool state;
-};
-
-#endif /* LIGHT_H */
@@ -0,0 +1,29 @@
+#ifndef LINKQ_H
+#define LINKQ_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#if !defined(LINKQ_WINDOW_SIZE)
+#define LINKQ_WINDOW_SIZE			16
+#endif
+
+/* Link quality kept from periodic RSSI samples. There is a single writer,
+ * the sampler, and getters return the cached values without blocking. */
+void linkq_reset(void);
+void linkq_update(int8_t rssi);
+/* exponentially weighted moving average of all samples */
+int8_t linkq_get_rssi(void);
+/* the weakest and strongest of the last LINKQ_WINDOW_SIZE samples */
+int8_t linkq_get_rssi_min(void);
+int8_t linkq_get_rssi_max(void);
+unsigned int linkq_count(void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* LINKQ_H */
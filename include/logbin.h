@@ -0,0 +1,80 @@
+#ifndef LOGBIN_H
+#define LOGBIN_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libmcu/logging.h"
+
+#if !defined(LOGBIN_RECORD_MAXLEN)
+#define LOGBIN_RECORD_MAXLEN			96
+#endif
+#if !defined(LOGBIN_STRING_MAXLEN)
+#define LOGBIN_STRING_MAXLEN			32
+#endif
+/* a batch of the size takes any record */
+#define LOGBIN_BATCH_MINLEN			(2 + LOGBIN_RECORD_MAXLEN)
+
+struct logbin_status {
+	size_t count; /* records pending */
+	size_t bytes; /* of the records pending */
+	unsigned int oldest_ms; /* timestamp of the oldest pending */
+	logging_t max_type; /* the most severe saved since drained */
+};
+
+/* Binary logs keep the address of the format string and the arguments as
+ * they are, leaving the formatting to the host. tools/logdecode.py looks
+ * the format strings up in the elf of the same build:
+ *
+ *   batch  := 'L' version(1) record*
+ *   record := len(1) type(1) timestamp format arg*
+ *
+ * len counts the bytes following it. timestamp is the uptime in ms and
+ * format the address of the format string. Arguments follow the
+ * conversions of the format: integers are LEB128 varints, zigzag encoded
+ * when signed, doubles 8 bytes little endian and strings len(1) followed
+ * by up to LOGBIN_STRING_MAXLEN bytes. Arguments not fitting in
+ * LOGBIN_RECORD_MAXLEN get dropped. */
+void logbin_init(void *buf, size_t bufsize);
+/* drops the oldest records when the buffer is full. Returns 0 for the ones
+ * below the level */
+size_t logbin_save(logging_t type, const char *format, ...)
+	__attribute__((format(printf, 2, 3)));
+/* moves as many whole records as fit into a batch, returning the bytes
+ * written or 0 when none */
+size_t logbin_read(void *buf, size_t bufsize);
+/* the number of records pending */
+size_t logbin_count(void);
+void logbin_get_status(struct logbin_status *status);
+/* records below the level are not saved. All are by default */
+void logbin_set_level(logging_t min_type);
+logging_t logbin_get_level(void);
+
+/* With LOGGING_BINARY defined, the logging macros log in binary where
+ * this header is included. The build forces it in for all. */
+#if defined(LOGGING_BINARY)
+#undef verbose
+#undef debug
+#undef info
+#undef notice
+#undef warn
+#undef error
+#undef alert
+#define verbose(...)	logbin_save(LOGGING_TYPE_VERBOSE, __VA_ARGS__)
+#define debug(...)	logbin_save(LOGGING_TYPE_DEBUG, __VA_ARGS__)
+#define info(...)	logbin_save(LOGGING_TYPE_INFO, __VA_ARGS__)
+#define notice(...)	logbin_save(LOGGING_TYPE_NOTICE, __VA_ARGS__)
+#define warn(...)	logbin_save(LOGGING_TYPE_WARN, __VA_ARGS__)
+#define error(...)	logbin_save(LOGGING_TYPE_ERROR, __VA_ARGS__)
+#define alert(...)	logbin_save(LOGGING_TYPE_ALERT, __VA_ARGS__)
+#endif
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* LOGBIN_H */
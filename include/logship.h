@@ -0,0 +1,43 @@
+#ifndef LOGSHIP_H
+#define LOGSHIP_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "logbin.h"
+
+#if !defined(LOGSHIP_BATCH_MAXLEN)
+#define LOGSHIP_BATCH_MAXLEN			512
+#endif
+#if !defined(LOGSHIP_FLUSH_BYTES)
+#define LOGSHIP_FLUSH_BYTES			384
+#endif
+#if !defined(LOGSHIP_FLUSH_AGE_MSEC)
+#define LOGSHIP_FLUSH_AGE_MSEC			30000
+#endif
+#if !defined(LOGSHIP_FLUSH_TYPE)
+#define LOGSHIP_FLUSH_TYPE			LOGGING_TYPE_ERROR
+#endif
+
+/* Ships the binary logs in batches, flushing when LOGSHIP_FLUSH_BYTES are
+ * pending, the oldest gets LOGSHIP_FLUSH_AGE_MSEC old or one of
+ * LOGSHIP_FLUSH_TYPE or higher comes. A batch goes compressed when it
+ * gets smaller:
+ *
+ *   compressed := 'Z' version(1) len batch_lz
+ *
+ * len is the size of the batch decompressed in a LEB128 varint. A batch
+ * failed to send is retried on the next poll, holding the new ones. */
+void logship_init(bool (*send)(const void *data, size_t datasize));
+/* returns true when a batch went out */
+bool logship_poll(unsigned int now_ms);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* LOGSHIP_H */
@@ -0,0 +1,27 @@
+#ifndef LZ_H
+#define LZ_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+/* LZSS with a 4KiB window. A flag byte leads every 8 items, bit n set for
+ * a match of item n and clear for a literal. A match is 2 bytes of 12-bit
+ * distance minus 1 followed by 4-bit length minus 3, the low byte of the
+ * distance first. Only the input itself is the window, so it takes no
+ * memory other than a small hash table on the stack. */
+#define LZ_SRC_MAXLEN				65534
+
+/* Both return the bytes written, 0 when the output does not fit or the
+ * input is broken. The output may grow by 1/8 for incompressible input. */
+size_t lz_compress(const void *src, size_t srclen, void *dst, size_t dstsize);
+size_t lz_decompress(const void *src, size_t srclen,
+		void *dst, size_t dstsize);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* LZ_H */
@@ -5,6 +5,10 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#if !defined(MQTT_NETWORK_BUFSIZE)
+#define MQTT_NETWORK_BUFSIZE		1024
+#endif
+
 typedef enum {
 	MQTT_SUCCESS			= 0,
 	MQTT_ERROR,
@@ -79,4 +83,6 @@ mqtt_error_t mqtt_unsubscribe(mqtt_t * const self,
 		const mqtt_subscribe_t * const sub);
 mqtt_error_t mqtt_publish(mqtt_t * const self, const mqtt_message_t * const pub);
 
+bool mqtt_is_topic_matched(const char *filter, const char *topic);
+
 #endif /* MQTT_H */
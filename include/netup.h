@@ -0,0 +1,23 @@
+#ifndef NETUP_H
+#define NETUP_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stdbool.h>
+
+typedef void (*netup_cb_t)(bool connected, void *context);
+
+/* brings the station up in the background, trying the last AP, the best
+ * saved network in range and then every saved network in turn, so that the
+ * caller goes on with its own initialization meanwhile. done gets called
+ * once at the end, in a jobpool worker or the wifi event context, and must
+ * not block. It returns false if a bring-up is already in progress. */
+bool netup_start(netup_cb_t done, void *context);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* NETUP_H */
@@ -1,10 +1,17 @@
 #ifndef NVS_KVSTORE_H
 #define NVS_KVSTORE_H
 
+#include <stdbool.h>
 #include "libmcu/kvstore.h"
 
 int nvs_kvstore_init(void);
+/* handles are pooled per namespace. Opening an open namespace again is
+ * cheap and the close keeps it open for the next one. */
 kvstore_t *nvs_kvstore_open(const char *ns);
 void nvs_kvstore_close(kvstore_t *kvstore);
+/* writes between begin and commit go to flash with a single commit.
+ * They can be nested. */
+bool nvs_kvstore_begin(kvstore_t *kvstore);
+bool nvs_kvstore_commit(kvstore_t *kvstore);
 
 #endif /* NVS_KVSTORE_H */
@@ -0,0 +1,50 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if !defined(PROFILE_TASKS_MAX)
+#define PROFILE_TASKS_MAX			16
+#endif
+#define PROFILE_TASK_NAME_MAXLEN		15
+
+struct profile_task {
+	uint32_t id; /* unique while the task lives */
+	uint32_t runtime; /* accumulated in the unit of total_runtime */
+	uint32_t stack_free; /* the least ever in bytes */
+	uint8_t prio;
+	char name[PROFILE_TASK_NAME_MAXLEN + 1];
+};
+
+struct profile_sample {
+	uint32_t free_heap;
+	uint32_t min_free_heap; /* the least ever since boot */
+	uint32_t total_runtime; /* 0 when the port keeps no runtime stats */
+	unsigned int nr_tasks;
+	struct profile_task tasks[PROFILE_TASKS_MAX];
+};
+
+/* Samples the system and encodes it returning the bytes written, 0 when
+ * the buffer is too small:
+ *
+ *   profile := 'P' version(1) free_heap min_free_heap nr_tasks(1) task*
+ *   task    := name_len(1) name prio(1) cpu stack_free
+ *
+ * Numbers other than the ones sized are LEB128 varints. cpu is per mille
+ * of the time since the previous profile, or since boot for the first. */
+size_t profile_encode(void *buf, size_t bufsize);
+void profile_init(void);
+
+/* provided by the port */
+extern void profile_hw_sample(struct profile_sample *sample);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* PROFILE_H */
@@ -4,7 +4,7 @@
 #include <stdbool.h>
 
 void relay_init(void);
-void relay_1_set(bool on);
-void relay_2_set(bool on);
+/* n starts from 0 */
+void relay_set(unsigned int n, bool on);
 
 #endif /* RELAY_H */
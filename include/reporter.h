@@ -10,10 +10,14 @@ typedef enum {
 	REPORT_DATA,
 	REPORT_EVENT,
 	REPORT_ROOM,
+	REPORT_SCENE,
+	REPORT_PROFILE,
 } report_t;
 
 typedef struct reporter_s reporter_t;
 
+/* returns without waiting for the network. reporter_name is kept as the
+ * client id of the broker session opened later, so it must outlive it */
 reporter_t *reporter_new(const char *reporter_name);
 bool reporter_start(void);
 
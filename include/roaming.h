@@ -0,0 +1,19 @@
+#ifndef ROAMING_H
+#define ROAMING_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* Watches the link RSSI and hands over to a stronger AP of the same network
+ * in the background once it drops below ROAMING_RSSI_THRESHOLD. on_roamed
+ * gets called after a successful handover. */
+void roaming_init(void (*on_roamed)(void *context), void *context);
+/* cheap enough to be called from a main loop */
+void roaming_poll(void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* ROAMING_H */
@@ -0,0 +1,67 @@
+#ifndef RULES_H
+#define RULES_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libmcu/kvstore.h"
+
+/* A rule table is compiled off the device and runs on it as is:
+ *
+ *   table := 'R' 'L' version(1) nr_rules rule*
+ *   rule  := trigger key(u16 le) code_len code
+ *   code  := op*
+ *
+ * Ops run in order. A condition failing stops the rule there so that the
+ * actions following it are skipped. Multibyte operands are little endian
+ * and switch masks have bit 0 for channel 1. */
+typedef enum {
+	RULE_TRIGGER_BUTTON			= 1, /* key: channel from 0,
+						      value: gesture_t */
+	RULE_TRIGGER_TIME			= 2, /* key: minute of the day */
+	RULE_TRIGGER_TOPIC			= 3, /* key: subscribed topic */
+	RULE_TRIGGER_SENSOR			= 4, /* key: sensor id */
+} rule_trigger_t;
+
+typedef enum {
+	RULE_OP_IF_SWITCH			= 0x01, /* mask states */
+	RULE_OP_IF_VALUE_EQ			= 0x02, /* i16 */
+	RULE_OP_IF_VALUE_GT			= 0x03, /* i16 */
+	RULE_OP_IF_VALUE_LT			= 0x04, /* i16 */
+	RULE_OP_IF_PAYLOAD			= 0x05, /* len bytes */
+	RULE_OP_IF_TIME				= 0x06, /* from(u16) to(u16) */
+	RULE_OP_SET				= 0x10, /* mask states */
+	RULE_OP_TOGGLE				= 0x11, /* mask */
+	RULE_OP_PUBLISH				= 0x12, /* len bytes */
+} rule_op_t;
+
+struct rules_ops {
+	void (*set_switches)(uint32_t mask, uint32_t states);
+	uint32_t (*get_switches)(void);
+	bool (*publish)(const void *payload, size_t payload_size);
+	/* negative when the time is unknown yet */
+	int (*get_minute_of_day)(void);
+};
+
+void rules_init(const struct rules_ops *ops, kvstore_t *kvstore);
+/* validates the table and saves it in place of the current one. An empty
+ * table clears all rules. */
+bool rules_update(const void *table, size_t table_size);
+/* runs the rules of the trigger returning how many ran to the end. The
+ * caller may skip its own default action when it's not 0. */
+int rules_trigger(rule_trigger_t trigger, uint16_t key, int32_t value,
+		const void *payload, size_t payload_size);
+/* fires time rules as the minute of the day changes */
+void rules_poll(void);
+unsigned int rules_count(void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* RULES_H */
@@ -1,12 +1,29 @@
 #ifndef SWITCH_H
 #define SWITCH_H
 
-#include "light.h"
+#include <stdbool.h>
+#include <stdint.h>
 
-extern int switch1_get_state(void);
-extern int switch2_get_state(void);
+#if !defined(SWITCH_CHANNELS)
+#define SWITCH_CHANNELS				2
+#endif
 
+/* provided by the board. n starts from 0 */
+extern int switch_get_state(unsigned int n);
+/* provided by the board. changed gets called from the board's debounce task
+ * on every debounced press and release. poll gets called whenever the task
+ * wakes up and returns microseconds to wake it up again after, 0 for none. */
+extern void switch_hw_init(void (*changed)(unsigned int n, bool pressed,
+			uint32_t usec), uint32_t (*poll)(uint32_t now_usec));
+
+/* n starts from 1 */
 void switch_set(int n, bool state);
-void switch_init(void (*callback)(int n, const struct light *light));
+/* sets the channels in the mask at once, reported in a single callback.
+ * Bit 0 is for channel 1. */
+void switch_set_mask(uint32_t mask, uint32_t states);
+uint32_t switch_get_mask(void);
+void switch_init(void (*callback)(uint32_t states));
+/* writes the relay state out once the coalescing interval has passed */
+void switch_poll(void);
 
 #endif /* SWITCH_H */
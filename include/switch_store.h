@@ -0,0 +1,30 @@
+#ifndef SWITCH_STORE_H
+#define SWITCH_STORE_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "libmcu/kvstore.h"
+
+/* Keeps the relay state as a bitmask across power cycles. Writes rotate
+ * over SWITCH_STORE_SLOTS keys tagged with a sequence number and the
+ * latest one wins at boot. */
+void switch_store_init(kvstore_t *kvstore);
+/* returns false when nothing has been saved yet */
+bool switch_store_load(uint32_t *state);
+/* A burst of changes gets coalesced into a single write at most every
+ * SWITCH_STORE_INTERVAL_MSEC. The last one goes out on a later poll. */
+void switch_store_save(uint32_t state);
+void switch_store_poll(void);
+/* writes a pending state out at once, e.g. on a brown-out warning */
+bool switch_store_flush(void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* SWITCH_STORE_H */
@@ -0,0 +1,17 @@
+#ifndef UPTIME_H
+#define UPTIME_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/* milliseconds since boot, wrapping around at UINT_MAX */
+unsigned int uptime_get_ms(void);
+/* microseconds since boot, wrapping around in about 71 minutes */
+unsigned int uptime_get_us(void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* UPTIME_H */
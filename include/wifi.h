@@ -61,6 +61,7 @@ typedef struct {
 } wifiman_network_profile_t;
 
 typedef void (*wifiman_event_handler_t)(wifiman_event_t event, void *context);
+typedef void (*wifiman_connect_cb_t)(wifiman_error_t rc, void *context);
 
 bool wifiman_on(void);
 void wifiman_off(void);
@@ -74,6 +75,21 @@ bool wifiman_stop_ap(void);
 // wifiman_configure_ap()
 
 wifiman_error_t wifiman_connect(const wifiman_network_profile_t *info);
+/* returns as soon as the association starts. cb gets WIFIMAN_SUCCESS once an
+ * IP is allocated, or an error on a failure or after timeout_ms unless it is
+ * 0. cb runs in the event context and must not block. */
+wifiman_error_t wifiman_connect_async(const wifiman_network_profile_t *info,
+		wifiman_connect_cb_t cb, void *context, unsigned int timeout_ms);
+/* reconnect to the last associated AP on its channel, reusing the last DHCP
+ * lease. It fails fast so that the caller can fall back to wifiman_connect() */
+wifiman_error_t wifiman_connect_last(void);
+/* scans once and tries the saved networks in range, best ranked first by
+ * signal, security and past success rate */
+wifiman_error_t wifiman_connect_best(void);
+/* hands over to the strongest AP of the current network if it beats the
+ * current link by min_gain_db. Event handlers don't see the handover unless
+ * it fails and the link cannot be restored. */
+wifiman_error_t wifiman_roam(uint8_t min_gain_db);
 wifiman_error_t wifiman_disconnect(void);
 bool wifiman_is_connected(void);
 bool wifiman_get_ip(uint8_t ip[WIFIMAN_IP4_MAXLEN]);
@@ -82,8 +98,11 @@ int8_t wifiman_get_rssi(void);
 
 int wifiman_scan(wifiman_network_profile_t *scanlist, int maxlen);
 
+/* multiple handlers can be registered for an event */
 wifiman_error_t wifiman_register_event_handler(wifiman_event_t event,
 		wifiman_event_handler_t handler);
+wifiman_error_t wifiman_unregister_event_handler(wifiman_event_t event,
+		wifiman_event_handler_t handler);
 
 bool wifiman_set_hostname(const char *hostname);
 bool wifiman_get_hostname(const char **hostname);
@@ -0,0 +1,17 @@
+#ifndef WIFIMAN_EVENT_H
+#define WIFIMAN_EVENT_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include "wifi.h"
+
+/* for ports to fan an event out to all the handlers registered for it */
+void wifiman_event_publish(wifiman_event_t event);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* WIFIMAN_EVENT_H */
@@ -0,0 +1,40 @@
+#ifndef WIFIMAN_RANK_H
+#define WIFIMAN_RANK_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "wifi.h"
+
+typedef struct {
+	const char *ssid;
+	const uint8_t *bssid; /* NULL for any BSSID of the SSID */
+	uint8_t index; /* slot in the network registry */
+	uint8_t attempts;
+	uint8_t successes;
+} wifiman_saved_network_t;
+
+typedef struct {
+	uint8_t index; /* slot in the network registry */
+	uint8_t bssid[WIFIMAN_BSSID_MAXLEN];
+	uint8_t channel;
+	int8_t rssi;
+	wifiman_security_t security;
+	int score;
+} wifiman_candidate_t;
+
+/* Intersects a scan result with saved networks and sorts them best first.
+ * A saved network appears once, with its strongest BSSID. The score is
+ * the RSSI in dBm adjusted by the security and the past success rate.
+ * Returns the number of candidates. */
+int wifiman_rank(wifiman_candidate_t *candidates, int maxlen,
+		const wifiman_network_profile_t *scanlist, int nr_scanned,
+		const wifiman_saved_network_t *saved, int nr_saved);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* WIFIMAN_RANK_H */
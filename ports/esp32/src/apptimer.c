@@ -0,0 +1,33 @@
+#include "apptimer.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_timer.h"
+#include "uptime.h"
+
+static esp_timer_handle_t timer;
+
+static void on_timeout(void *arg)
+{
+	(void)arg;
+	apptimer_process(uptime_get_ms());
+}
+
+void apptimer_hw_arm(unsigned int delay_ms)
+{
+	esp_timer_stop(timer);
+	esp_timer_start_once(timer, (uint64_t)delay_ms * 1000);
+}
+
+bool apptimer_hw_init(void)
+{
+	if (timer != NULL) {
+		return true;
+	}
+
+	return esp_timer_create(&(const esp_timer_create_args_t) {
+				.callback = on_timeout,
+				.name = "apptimer",
+			}, &timer) == ESP_OK;
+}
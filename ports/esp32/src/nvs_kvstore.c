@@ -3,65 +3,273 @@
 
 #include <stdbool.h>
 #include <stddef.h>
-#include <stdlib.h>
-#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
 
 #include "esp_system.h"
 #include "nvs_flash.h"
 #include "nvs.h"
 
+/* namespaces kept open at the same time. An idle one gets closed only when
+ * another needs its slot. */
+#if !defined(NVS_KVSTORE_MAX_HANDLES)
+#define NVS_KVSTORE_MAX_HANDLES			4
+#endif
+/* small values cached per namespace not to hit the flash on every read */
+#if !defined(NVS_KVSTORE_CACHE_ENTRIES)
+#define NVS_KVSTORE_CACHE_ENTRIES		4
+#endif
+#if !defined(NVS_KVSTORE_CACHE_VALUE_MAXLEN)
+#define NVS_KVSTORE_CACHE_VALUE_MAXLEN		32
+#endif
+
+#define NAME_MAXLEN				15
+
+struct cache_entry {
+	char key[NAME_MAXLEN + 1];
+	uint8_t value[NVS_KVSTORE_CACHE_VALUE_MAXLEN];
+	uint8_t len;
+	uint32_t used_at;
+};
+
 struct nvs_kvstore_s {
 	kvstore_t ops;
 	nvs_handle handle;
+	char ns[NAME_MAXLEN + 1];
+	bool opened;
+	uint8_t refcount;
+	uint8_t transaction; /* nesting depth of begin() */
+	bool uncommitted;
+	uint32_t used_at;
+	struct cache_entry cache[NVS_KVSTORE_CACHE_ENTRIES];
 };
 
-static int open_internal(const char *ns, nvs_handle *namespace_handle)
+static struct {
+	pthread_mutex_t lock;
+	struct nvs_kvstore_s pool[NVS_KVSTORE_MAX_HANDLES];
+	uint32_t clock;
+} m = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static struct cache_entry *find_cache(struct nvs_kvstore_s *p,
+		const char *key)
 {
-	return !nvs_open(ns, NVS_READWRITE, namespace_handle);
+	for (int i = 0; i < NVS_KVSTORE_CACHE_ENTRIES; i++) {
+		struct cache_entry *entry = &p->cache[i];
+		if (entry->key[0] != '\0'
+				&& strncmp(entry->key, key, NAME_MAXLEN) == 0) {
+			entry->used_at = ++m.clock;
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+static void update_cache(struct nvs_kvstore_s *p, const char *key,
+		const void *value, size_t size)
+{
+	struct cache_entry *entry = find_cache(p, key);
+
+	if (size > NVS_KVSTORE_CACHE_VALUE_MAXLEN) {
+		if (entry != NULL) {
+			entry->key[0] = '\0';
+		}
+		return;
+	}
+
+	if (entry == NULL) { /* least recently used */
+		entry = &p->cache[0];
+		for (int i = 1; i < NVS_KVSTORE_CACHE_ENTRIES; i++) {
+			if (p->cache[i].used_at < entry->used_at) {
+				entry = &p->cache[i];
+			}
+		}
+	}
+
+	strncpy(entry->key, key, NAME_MAXLEN);
+	entry->key[NAME_MAXLEN] = '\0';
+	memcpy(entry->value, value, size);
+	entry->len = (uint8_t)size;
+	entry->used_at = ++m.clock;
 }
 
 static size_t write_internal(kvstore_t *self, const char *key, const void *value, size_t size)
 {
 	struct nvs_kvstore_s *p = (typeof(p))self;
+	size_t written = 0;
+
+	pthread_mutex_lock(&m.lock);
+	{
+		const struct cache_entry *entry = find_cache(p, key);
 
-	if (nvs_set_blob(p->handle, key, value, size)) {
-		return 0;
+		if (entry != NULL && entry->len == size
+				&& memcmp(entry->value, value, size) == 0) {
+			written = size; /* unchanged. spare the flash */
+		} else if (!nvs_set_blob(p->handle, key, value, size)) {
+			update_cache(p, key, value, size);
+			p->uncommitted = true;
+			written = size;
+		}
+
+		/* left uncommitted on a failure for the next one to retry */
+		if (written && p->transaction == 0 && p->uncommitted) {
+			if (nvs_commit(p->handle)) {
+				written = 0;
+			} else {
+				p->uncommitted = false;
+			}
+		}
 	}
+	pthread_mutex_unlock(&m.lock);
 
-	return !nvs_commit(p->handle)? size : 0;
+	return written;
 }
 
 static size_t read_internal(const kvstore_t *self, const char *key, void *buf, size_t bufsize)
 {
-	const struct nvs_kvstore_s *p = (typeof(p))self;
-	return !nvs_get_blob(p->handle, key, buf, &bufsize)? bufsize : 0;
+	struct nvs_kvstore_s *p = (typeof(p))(uintptr_t)self;
+	size_t len = 0;
+
+	pthread_mutex_lock(&m.lock);
+	{
+		const struct cache_entry *entry = find_cache(p, key);
+
+		if (entry != NULL) {
+			if (entry->len <= bufsize) {
+				memcpy(buf, entry->value, entry->len);
+				len = entry->len;
+			}
+		} else if (!nvs_get_blob(p->handle, key, buf, &bufsize)) {
+			update_cache(p, key, buf, bufsize);
+			len = bufsize;
+		}
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	return len;
+}
+
+static struct nvs_kvstore_s *find_handle(const char *ns)
+{
+	for (int i = 0; i < NVS_KVSTORE_MAX_HANDLES; i++) {
+		struct nvs_kvstore_s *p = &m.pool[i];
+		if (p->opened && strncmp(p->ns, ns, NAME_MAXLEN) == 0) {
+			return p;
+		}
+	}
+
+	return NULL;
+}
+
+/* a never used slot first, then the least recently used idle one */
+static struct nvs_kvstore_s *get_free_handle(void)
+{
+	struct nvs_kvstore_s *victim = NULL;
+
+	for (int i = 0; i < NVS_KVSTORE_MAX_HANDLES; i++) {
+		struct nvs_kvstore_s *p = &m.pool[i];
+
+		if (!p->opened) {
+			return p;
+		}
+		if (p->refcount == 0
+				&& (victim == NULL || p->used_at < victim->used_at)) {
+			victim = p;
+		}
+	}
+
+	if (victim != NULL) {
+		/* closing it uncommitted would lose the writes */
+		if (victim->uncommitted) {
+			if (nvs_commit(victim->handle)) {
+				return NULL;
+			}
+			victim->uncommitted = false;
+		}
+		nvs_close(victim->handle);
+		victim->opened = false;
+	}
+
+	return victim;
 }
 
 kvstore_t *nvs_kvstore_open(const char *ns)
 {
 	struct nvs_kvstore_s *p;
 
-	if (!(p = malloc(sizeof(*p)))) {
-		return NULL;
+	pthread_mutex_lock(&m.lock);
+	{
+		if ((p = find_handle(ns)) == NULL
+				&& (p = get_free_handle()) != NULL) {
+			memset(p, 0, sizeof(*p));
+
+			if (nvs_open(ns, NVS_READWRITE, &p->handle) == ESP_OK) {
+				strncpy(p->ns, ns, NAME_MAXLEN);
+				p->opened = true;
+				p->ops = (typeof(p->ops)) {
+					.write = write_internal,
+					.read = read_internal,
+				};
+			} else {
+				p = NULL;
+			}
+		}
+
+		if (p != NULL) {
+			p->refcount++;
+			p->used_at = ++m.clock;
+		}
 	}
+	pthread_mutex_unlock(&m.lock);
 
-	if (!open_internal(ns, &p->handle)) {
-		free(p);
-		return NULL;
+	return p != NULL? &p->ops : NULL;
+}
+
+void nvs_kvstore_close(kvstore_t *kvstore)
+{
+	struct nvs_kvstore_s *p = (typeof(p))kvstore;
+
+	pthread_mutex_lock(&m.lock);
+	{
+		if (p->refcount > 0) {
+			p->refcount--;
+		}
 	}
+	pthread_mutex_unlock(&m.lock);
+}
+
+bool nvs_kvstore_begin(kvstore_t *kvstore)
+{
+	struct nvs_kvstore_s *p = (typeof(p))kvstore;
 
-	p->ops = (typeof(p->ops)) {
-		.write = write_internal,
-		.read = read_internal,
-	};
+	pthread_mutex_lock(&m.lock);
+	{
+		p->transaction++;
+	}
+	pthread_mutex_unlock(&m.lock);
 
-	return &p->ops;
+	return true;
 }
 
-void nvs_kvstore_close(kvstore_t *kvstore)
+bool nvs_kvstore_commit(kvstore_t *kvstore)
 {
-	nvs_close(((typeof(struct nvs_kvstore_s *))kvstore)->handle);
-	free(kvstore);
+	struct nvs_kvstore_s *p = (typeof(p))kvstore;
+	bool rc = true;
+
+	pthread_mutex_lock(&m.lock);
+	{
+		if (p->transaction > 0 && --p->transaction == 0
+				&& p->uncommitted) {
+			rc = !nvs_commit(p->handle);
+			p->uncommitted = !rc;
+		}
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	return rc;
 }
 
 int nvs_kvstore_init(void)
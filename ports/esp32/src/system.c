@@ -65,6 +65,11 @@ unsigned int system_get_current_stack_watermark(void)
 	return uxTaskGetStackHighWaterMark(NULL);
 }
 
+unsigned int system_get_heap_watermark(void)
+{
+	return esp_get_minimum_free_heap_size();
+}
+
 const char *system_get_version_string(void)
 {
         const esp_app_desc_t *app_desc = esp_ota_get_app_description();
@@ -83,14 +88,6 @@ const char *system_get_current_task_name(void)
 
 void system_print_tasks_info(void)
 {
-#if 0
-	char *buf = malloc(2048);
-	if (buf) {
-		vTaskGetRunTimeStats(buf);
-		printf("%s\n", buf);
-		free(buf);
-	}
-#else
 	const size_t bytes_per_task = 40; /* see vTaskList description */
 	char *task_list_buffer = malloc(uxTaskGetNumberOfTasks() * bytes_per_task);
 	if (task_list_buffer == NULL) {
@@ -101,7 +98,6 @@ void system_print_tasks_info(void)
 	printf("Task Name\tStatus\tPrio\tHWM\tTask Number\tCore\n");
 	printf("%s\n", task_list_buffer);
 	free(task_list_buffer);
-#endif
 }
 
 int system_random(void)
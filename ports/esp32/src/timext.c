@@ -1,5 +1,7 @@
 #include "libmcu/timext.h"
+#include "uptime.h"
 
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
@@ -23,3 +25,13 @@ void sleep_ms(unsigned int msec)
 {
 	vTaskDelay(MSEC_TO_TICKS(msec));
 }
+
+unsigned int uptime_get_ms(void)
+{
+	return (unsigned int)(esp_timer_get_time() / 1000);
+}
+
+unsigned int uptime_get_us(void)
+{
+	return (unsigned int)esp_timer_get_time();
+}
@@ -47,7 +47,7 @@ static void button_task(void *context)
 
 static void isr_boot0(void *arg)
 {
-	jobpool_schedule(button_task, arg);
+	jobpool_schedule_prio(JOBPOOL_PRIO_HIGH, button_task, arg, 0);
 	disable_boot0_interrupt();
 }
 
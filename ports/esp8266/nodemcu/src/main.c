@@ -8,16 +8,18 @@
 
 #include "sleep.h"
 #include "jobpool.h"
+#include "apptimer.h"
 
 #include "dfu/dfu.h"
 #include "dfu/flash.h"
 
 #include "ota/ota.h"
-#include "ota/protocol/mqtt.h"
+#include "ota/protocol/http.h"
 #include "ota/format/json.h"
 
 #include "provisioning.h"
 #include "reporter.h"
+#include "roaming.h"
 
 extern void system_print_tasks_info(void);
 extern void mdns_test(void);
@@ -48,6 +50,8 @@ int main(void)
 
 	bool initialized = jobpool_init();
 	assert(initialized == true);
+	initialized = apptimer_init();
+	assert(initialized == true);
 
 	button_init(get_time_ms, sleep_ms);
 
@@ -67,12 +71,13 @@ int main(void)
 	assert(reporter != NULL);
 
 	dfu_init(dfu_flash());
-	ota_init(reporter, ota_mqtt(), ota_json_parser());
+	ota_init(reporter, ota_http(), ota_json_parser());
 
 	while (1) {
 		system_print_tasks_info();
 		debug("%s", system_get_reboot_reason_string());
 		debug("heap: %d", system_get_free_heap_bytes());
+		roaming_poll();
 
 		sleep_ms(20000);
 		reporter_send("Hello", 5);
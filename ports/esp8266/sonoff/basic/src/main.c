@@ -6,12 +6,13 @@
 
 #include "sleep.h"
 #include "jobpool.h"
+#include "apptimer.h"
 
 #include "dfu/dfu.h"
 #include "dfu/flash.h"
 
 #include "ota/ota.h"
-#include "ota/protocol/mqtt.h"
+#include "ota/protocol/http.h"
 #include "ota/format/json.h"
 
 #include "provisioning.h"
@@ -40,6 +41,8 @@ int main(void)
 
 	bool initialized = jobpool_init();
 	assert(initialized == true);
+	initialized = apptimer_init();
+	assert(initialized == true);
 
 	//mdns_test();
 	sntp_test();
@@ -57,7 +60,7 @@ int main(void)
 	assert(reporter != NULL);
 
 	dfu_init(dfu_flash());
-	ota_init(reporter, ota_mqtt(), ota_json_parser());
+	ota_init(reporter, ota_http(), ota_json_parser());
 
 	while (1) {
 		system_print_tasks_info();
@@ -15,9 +15,6 @@
 #if !defined(MQTT_MAX_SUBSCRIPTIONS)
 #define MQTT_MAX_SUBSCRIPTIONS		10
 #endif
-#if !defined(MQTT_NETWORK_BUFSIZE)
-#define MQTT_NETWORK_BUFSIZE		1024
-#endif
 
 struct mqtt_server_info {
 	esp_mqtt_client_handle_t handle;
@@ -70,47 +67,6 @@ static inline mqtt_subscribe_t *get_unused_subscription(mqtt_t * const mqtt)
 	return NULL;
 }
 
-static void get_next_topic_word(const char **s)
-{
-	while (**s != '/' && **s != '\0') {
-		(*s)++;
-	}
-}
-
-static bool is_topic_matched(const char *filter, const char *topic)
-{
-	if (filter == NULL || topic == NULL) {
-		return false;
-	}
-
-	while (*filter != '\0' && *topic != '\0') {
-		if (*filter == '#') {
-			return true;
-		}
-		if (*filter == '+') {
-			get_next_topic_word(&filter);
-			get_next_topic_word(&topic);
-			continue;
-		}
-
-		if (*filter != *topic) {
-			return false;
-		}
-
-		filter++;
-		topic++;
-	}
-
-	if (*filter != '\0') {
-		return false;
-	}
-	if (*topic == '\0') {
-		return true;
-	}
-
-	return false;
-}
-
 static const mqtt_subscribe_t *get_subscription_by_topic(
 		const mqtt_t * const mqtt, const char *topic)
 {
@@ -119,7 +75,7 @@ static const mqtt_subscribe_t *get_subscription_by_topic(
 		if (is_subscription_unused(p)) {
 			continue;
 		}
-		if (is_topic_matched(p->topic_filter, topic)) {
+		if (mqtt_is_topic_matched(p->topic_filter, topic)) {
 			return p;
 		}
 	}
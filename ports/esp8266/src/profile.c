@@ -0,0 +1,38 @@
+#include "profile.h"
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "libmcu/system.h"
+
+void profile_hw_sample(struct profile_sample *sample)
+{
+	/* static not to take the stack. profile_encode() serializes calls */
+	static TaskStatus_t tasks[PROFILE_TASKS_MAX];
+	uint32_t total = 0;
+	UBaseType_t n;
+
+	sample->free_heap = system_get_free_heap_bytes();
+	sample->min_free_heap = system_get_heap_watermark();
+
+	/* 0 when there are more tasks than the room */
+	n = uxTaskGetSystemState(tasks, PROFILE_TASKS_MAX, &total);
+
+	for (UBaseType_t i = 0; i < n; i++) {
+		struct profile_task *task = &sample->tasks[i];
+
+		task->id = (uint32_t)tasks[i].xTaskNumber;
+		task->runtime = (uint32_t)tasks[i].ulRunTimeCounter;
+		task->stack_free = (uint32_t)tasks[i].usStackHighWaterMark
+			* sizeof(StackType_t);
+		task->prio = (uint8_t)tasks[i].uxCurrentPriority;
+		strncpy(task->name, tasks[i].pcTaskName,
+				PROFILE_TASK_NAME_MAXLEN);
+	}
+
+	sample->nr_tasks = (unsigned int)n;
+#if configGENERATE_RUN_TIME_STATS
+	sample->total_runtime = total;
+#endif
+}
@@ -2,18 +2,27 @@
 
 #include <assert.h>
 #include <string.h>
+#include <time.h>
 #include <pthread.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
+#include "freertos/timers.h"
 #include "esp_wifi.h"
+#include "lwip/dhcp.h"
 
 #include "libmcu/logging.h"
 #include "libmcu/compiler.h"
 #include "nvs_kvstore.h"
+#include "jobpool.h"
+#include "linkq.h"
+#include "wifiman_rank.h"
+#include "wifiman_event.h"
 
 #define WIFI_KVSTORE_NAMESPACE		"wifi"
 #define WIFI_KVSTORE_REGISTRY		"registry"
+#define WIFI_KVSTORE_LAST		"last"
+#define WIFI_KVSTORE_HISTORY		"history"
 
 #if !defined(DEFAULT_WIFI_SSID)
 #define DEFAULT_WIFI_SSID		"smarthome"
@@ -25,7 +34,46 @@
 #define DEFAULT_WIFI_MAX_CONNECTIONS	1
 #endif
 
+#if !defined(WIFIMAN_FAST_CONNECT_TIMEOUT_MSEC)
+#define WIFIMAN_FAST_CONNECT_TIMEOUT_MSEC	5000
+#endif
+/* consecutive boots reusing the last DHCP lease before asking for a new one */
+#if !defined(WIFIMAN_STATIC_IP_MAX_REUSE)
+#define WIFIMAN_STATIC_IP_MAX_REUSE	8
+#endif
+
+#if !defined(WIFIMAN_CONNECT_TIMEOUT_MSEC)
+#define WIFIMAN_CONNECT_TIMEOUT_MSEC	10000
+#endif
+#if !defined(WIFIMAN_SCAN_MAXLEN)
+#define WIFIMAN_SCAN_MAXLEN		20
+#endif
+/* attempts kept per network before halving, so recent outcomes weigh more */
+#if !defined(WIFIMAN_HISTORY_MAX_ATTEMPTS)
+#define WIFIMAN_HISTORY_MAX_ATTEMPTS	16
+#endif
+
+#if !defined(WIFIMAN_RSSI_SAMPLE_INTERVAL_MSEC)
+#define WIFIMAN_RSSI_SAMPLE_INTERVAL_MSEC	2000
+#endif
+
+/* history updates are held back this long to go out in one flush */
+#if !defined(WIFIMAN_REGISTRY_FLUSH_DELAY_MSEC)
+#define WIFIMAN_REGISTRY_FLUSH_DELAY_MSEC	3000
+#endif
+
 #define PASSWORD_MAXLEN			63
+/* a wall clock earlier than this is not set yet */
+#define CLOCK_VALID_SINCE		1577836800u /* 2020-01-01 */
+#define PROFILE_SIZE			\
+	(sizeof(wifiman_network_profile_t) + WIFIMAN_PASS_MAXLEN)
+
+/* bits of network_cache.dirty. The lower ones are of the profiles. */
+enum {
+	DIRTY_REGISTRY			= 1UL << WIFIMAN_MAX_NETWORK_PROFILES,
+	DIRTY_HISTORY			= DIRTY_REGISTRY << 1,
+	DIRTY_LAST			= DIRTY_HISTORY << 1,
+};
 
 enum {
 	EVENT_STARTED			= BIT0,
@@ -33,6 +81,20 @@ enum {
 	EVENT_DISCONNECTED		= BIT2,
 };
 
+struct last_connection {
+	char ssid[WIFIMAN_SSID_MAXLEN + 1];
+	uint8_t bssid[WIFIMAN_BSSID_MAXLEN];
+	uint8_t channel;
+	uint8_t security;
+	uint8_t ip[WIFIMAN_IP4_MAXLEN];
+	uint8_t netmask[WIFIMAN_IP4_MAXLEN];
+	uint8_t gateway[WIFIMAN_IP4_MAXLEN];
+	uint8_t dns[WIFIMAN_IP4_MAXLEN];
+	uint32_t lease_expiry; /* wall clock in seconds. 0 for unknown */
+	uint32_t lease_renew_at; /* T1 of the lease */
+	uint8_t reused;
+};
+
 struct network_registry {
 	uint8_t count;
 	struct {
@@ -40,16 +102,274 @@ struct network_registry {
 	} index[WIFIMAN_MAX_NETWORK_PROFILES];
 };
 
+/* kept apart from the registry so that the registry layout stays as is */
+struct network_history {
+	struct {
+		uint8_t attempts;
+		uint8_t successes;
+	} slot[WIFIMAN_MAX_NETWORK_PROFILES];
+};
+
+/* the registry, history and profiles are read from flash only once */
+struct network_cache {
+	bool loaded;
+	uint32_t dirty;
+	struct network_registry registry;
+	struct network_history history;
+	uint32_t profiles[WIFIMAN_MAX_NETWORK_PROFILES]
+		[(PROFILE_SIZE + sizeof(uint32_t) - 1) / sizeof(uint32_t)];
+};
+
 static struct {
 	bool initialized;
 	pthread_mutex_t lock;
 	bool connected;
 	EventGroupHandle_t event;
+	TimerHandle_t rssi_sampler;
 	wifiman_network_profile_t ap;
 	uint8_t ip[WIFIMAN_IP4_MAXLEN];
-	wifiman_event_handler_t event_handlers[WIFIMAN_EVENT_MAX];
+	uint8_t netmask[WIFIMAN_IP4_MAXLEN];
+	uint8_t gateway[WIFIMAN_IP4_MAXLEN];
+
+	struct last_connection last;
+	bool last_loaded;
+	bool static_ip;
+	bool roaming;
+
+	struct network_cache cache;
+	TimerHandle_t flusher;
+	TimerHandle_t lease_renewer;
+
+	struct {
+		pthread_mutex_t lock;
+		TimerHandle_t timer;
+		wifiman_connect_cb_t cb;
+		void *context;
+	} pending;
 } m;
 
+static void get_dns(uint8_t dns[WIFIMAN_IP4_MAXLEN])
+{
+	tcpip_adapter_dns_info_t info = { 0, };
+	tcpip_adapter_get_dns_info(TCPIP_ADAPTER_IF_STA,
+			TCPIP_ADAPTER_DNS_MAIN, &info);
+	memcpy(dns, &ip_2_ip4(&info.ip)->addr, WIFIMAN_IP4_MAXLEN);
+}
+
+static bool set_static_ip(const struct last_connection *last)
+{
+	tcpip_adapter_ip_info_t ip_info = { 0, };
+	tcpip_adapter_dns_info_t dns = { 0, };
+
+	memcpy(&ip_info.ip.addr, last->ip, sizeof(ip_info.ip.addr));
+	memcpy(&ip_info.netmask.addr, last->netmask, sizeof(ip_info.netmask.addr));
+	memcpy(&ip_info.gw.addr, last->gateway, sizeof(ip_info.gw.addr));
+	memcpy(&ip_2_ip4(&dns.ip)->addr, last->dns, sizeof(ip_info.ip.addr));
+
+	tcpip_adapter_dhcpc_stop(TCPIP_ADAPTER_IF_STA);
+	if (tcpip_adapter_set_ip_info(TCPIP_ADAPTER_IF_STA, &ip_info)
+			!= ESP_OK) {
+		tcpip_adapter_dhcpc_start(TCPIP_ADAPTER_IF_STA);
+		return false;
+	}
+	tcpip_adapter_set_dns_info(TCPIP_ADAPTER_IF_STA,
+			TCPIP_ADAPTER_DNS_MAIN, &dns);
+
+	return true;
+}
+
+static void restore_dhcp(void)
+{
+	tcpip_adapter_dhcpc_start(TCPIP_ADAPTER_IF_STA);
+}
+
+/* the lease times of the address bound by DHCP in seconds */
+static bool get_lease(uint32_t *t0, uint32_t *t1)
+{
+	struct netif *netif = NULL;
+
+	if (tcpip_adapter_get_netif(TCPIP_ADAPTER_IF_STA, (void **)&netif)
+			!= ESP_OK || netif == NULL
+			|| !dhcp_supplied_address(netif)) {
+		return false;
+	}
+
+	const struct dhcp *dhcp = netif_dhcp_data(netif);
+	*t0 = dhcp->offered_t0_lease;
+	*t1 = dhcp->offered_t1_renew? dhcp->offered_t1_renew : *t0 / 2;
+
+	return *t0 != 0;
+}
+
+static bool get_wall_clock(uint32_t *now)
+{
+	time_t t = time(NULL);
+
+	if (t < (time_t)CLOCK_VALID_SINCE) {
+		return false;
+	}
+
+	*now = (uint32_t)t;
+	return true;
+}
+
+/* nothing tells the lease is still ours without the wall clock */
+static bool is_lease_valid(const struct last_connection *last)
+{
+	uint32_t now;
+
+	return last->ip[0] != 0 && get_wall_clock(&now)
+		&& (int32_t)(last->lease_expiry - now) > 0;
+}
+
+static void renew_lease_job(void *context)
+{
+	pthread_mutex_lock(&m.lock);
+	{
+		if (m.static_ip && m.connected) {
+			info("renewing the lease");
+			m.static_ip = false;
+			restore_dhcp();
+		}
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	unused(context);
+}
+
+static void request_lease_renewal(TimerHandle_t timer)
+{
+	if (!jobpool_schedule(renew_lease_job, NULL)) {
+		xTimerReset(timer, 0);
+	}
+}
+
+/* an address kept as static is handed back to the DHCP client at T1 of
+ * its lease, which then renews it as usual */
+static void schedule_lease_renewal(const struct last_connection *last)
+{
+	uint32_t now = 0;
+	int32_t left = get_wall_clock(&now)?
+		(int32_t)(last->lease_renew_at - now) : 0;
+	TickType_t ticks = left > 0? (TickType_t)left * configTICK_RATE_HZ : 1;
+
+	xTimerChangePeriod(m.lease_renewer, ticks, 0);
+}
+
+static const struct last_connection *get_last_connection(void)
+{
+	if (m.last_loaded) {
+		return &m.last;
+	}
+
+	kvstore_t *kv = nvs_kvstore_open(WIFI_KVSTORE_NAMESPACE);
+	if (kv == NULL) {
+		return &m.last;
+	}
+
+	if (kvstore_read(kv, WIFI_KVSTORE_LAST, &m.last, sizeof(m.last))
+			!= sizeof(m.last)) {
+		memset(&m.last, 0, sizeof(m.last));
+	}
+	m.last_loaded = true;
+
+	nvs_kvstore_close(kv);
+
+	return &m.last;
+}
+
+static void save_last_connection(const struct last_connection *last)
+{
+	if (memcmp(last, get_last_connection(), sizeof(*last)) == 0) {
+		return;
+	}
+
+	kvstore_t *kv = nvs_kvstore_open(WIFI_KVSTORE_NAMESPACE);
+	if (kv == NULL) {
+		return;
+	}
+
+	if (kvstore_write(kv, WIFI_KVSTORE_LAST, last, sizeof(*last))
+			== sizeof(*last)) {
+		memcpy(&m.last, last, sizeof(m.last));
+	}
+
+	nvs_kvstore_close(kv);
+}
+
+static void update_last_connection(void)
+{
+	struct last_connection last = { 0, };
+
+	strncpy(last.ssid, m.ap.ssid, WIFIMAN_SSID_MAXLEN);
+	memcpy(last.bssid, m.ap.bssid, sizeof(last.bssid));
+	last.channel = m.ap.channel;
+	last.security = (uint8_t)m.ap.security;
+	memcpy(last.ip, m.ip, sizeof(last.ip));
+	memcpy(last.netmask, m.netmask, sizeof(last.netmask));
+	memcpy(last.gateway, m.gateway, sizeof(last.gateway));
+	get_dns(last.dns);
+	/* counted once a fast connect gets through, not on every
+	 * association */
+	last.reused = get_last_connection()->reused;
+
+	uint32_t t0, t1, now;
+	if (get_lease(&t0, &t1) && get_wall_clock(&now)) {
+		last.lease_expiry = now + t0;
+		last.lease_renew_at = now + t1;
+	} else if (memcmp(last.ip, get_last_connection()->ip,
+				sizeof(last.ip)) == 0) { /* kept as static */
+		last.lease_expiry = get_last_connection()->lease_expiry;
+		last.lease_renew_at = get_last_connection()->lease_renew_at;
+	}
+
+	save_last_connection(&last);
+}
+
+static void sample_rssi(TimerHandle_t timer)
+{
+	wifi_ap_record_t ap;
+
+	if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+		linkq_update(ap.rssi);
+	}
+
+	unused(timer);
+}
+
+/* returns false if nothing was waiting for the completion */
+static bool complete_connecting(wifiman_error_t rc)
+{
+	wifiman_connect_cb_t cb;
+	void *context;
+
+	pthread_mutex_lock(&m.pending.lock);
+	{
+		cb = m.pending.cb;
+		context = m.pending.context;
+		m.pending.cb = NULL;
+	}
+	pthread_mutex_unlock(&m.pending.lock);
+
+	if (cb == NULL) {
+		return false;
+	}
+
+	xTimerStop(m.pending.timer, 0);
+	cb(rc, context);
+
+	return true;
+}
+
+static void connect_timed_out(TimerHandle_t timer)
+{
+	if (complete_connecting(WIFIMAN_NOT_RESPONDING)) {
+		esp_wifi_disconnect();
+	}
+
+	unused(timer);
+}
+
 static void wifi_event_handler(void *arg, int32_t event_id, void *event_data)
 {
 	unused(arg);
@@ -60,6 +380,7 @@ static void wifi_event_handler(void *arg, int32_t event_id, void *event_data)
 	switch (event_id) {
 	case WIFI_EVENT_WIFI_READY:
 		info("WiFi ready.");
+		etype = WIFIMAN_EVENT_READY;
 		break;
 	case WIFI_EVENT_STA_START:
 		xEventGroupSetBits(m.event, EVENT_STARTED);
@@ -74,6 +395,9 @@ static void wifi_event_handler(void *arg, int32_t event_id, void *event_data)
 		m.ap.rssi = ap.rssi;
 		m.ap.channel = ap.primary;
 		m.ap.security = ap.authmode + 1;
+		linkq_reset();
+		linkq_update(ap.rssi);
+		xTimerStart(m.rssi_sampler, 0);
 		info("WiFi station connected(RSSI: %d, country: %s, mode %d).",
 				ap.rssi, ap.country.cc, ap.authmode);
 		etype = WIFIMAN_EVENT_CONNECTED;
@@ -81,10 +405,16 @@ static void wifi_event_handler(void *arg, int32_t event_id, void *event_data)
 	case WIFI_EVENT_STA_DISCONNECTED:
 		disconnected_event = (system_event_sta_disconnected_t *)event_data;
 		m.connected = false;
+		xTimerStop(m.rssi_sampler, 0);
 		xEventGroupClearBits(m.event, EVENT_CONNECTED);
 		xEventGroupSetBits(m.event, EVENT_DISCONNECTED);
 		info("WiFi station disconnected: %x.", disconnected_event->reason);
 		etype = WIFIMAN_EVENT_DISCONNECTED;
+		complete_connecting(WIFIMAN_ERROR);
+		if (m.static_ip) { /* the next connection goes through DHCP */
+			m.static_ip = false;
+			restore_dhcp();
+		}
 #if 0
 		if (disconnected_event == WIFI_REASON_BASIC_RATE_NOT_SUPPORT) {
 			esp_wifi_set_protocol(ESP_IF_WIFI_STA,
@@ -97,6 +427,7 @@ static void wifi_event_handler(void *arg, int32_t event_id, void *event_data)
 		break;
 	case WIFI_EVENT_SCAN_DONE:
 		info("WiFi scanning done.");
+		etype = WIFIMAN_EVENT_SCAN_COMPLETED;
 		break;
 	case WIFI_EVENT_STA_AUTHMODE_CHANGE:
 		info("WiFi station autentication mode changed.");
@@ -111,8 +442,8 @@ static void wifi_event_handler(void *arg, int32_t event_id, void *event_data)
 		break;
 	}
 
-	if (etype != WIFIMAN_EVENT_UNKNOWN && m.event_handlers[etype] != NULL) {
-		m.event_handlers[etype](etype, NULL);
+	if (etype != WIFIMAN_EVENT_UNKNOWN && !m.roaming) {
+		wifiman_event_publish(etype);
 	}
 }
 
@@ -128,7 +459,14 @@ static void ip_event_handler(void *arg, int32_t event_id, void *event_data)
 		xEventGroupSetBits(m.event, EVENT_CONNECTED);
 		event = (ip_event_got_ip_t *)event_data;
 		memcpy(m.ip, &event->ip_info.ip.addr, sizeof(m.ip));
+		memcpy(m.netmask, &event->ip_info.netmask.addr, sizeof(m.netmask));
+		memcpy(m.gateway, &event->ip_info.gw.addr, sizeof(m.gateway));
 		info("IP allocated: %s", ip4addr_ntoa(&event->ip_info.ip));
+		update_last_connection();
+		complete_connecting(WIFIMAN_SUCCESS);
+		if (!m.roaming) {
+			wifiman_event_publish(WIFIMAN_EVENT_IP_ALLOCATED);
+		}
 		break;
 	default:
 		error("Unknown event %x", event_id);
@@ -148,7 +486,20 @@ static void event_handler(void *arg, esp_event_base_t event_base,
 	}
 }
 
-static wifiman_error_t connect_internal(const wifiman_network_profile_t *info)
+static bool is_bssid_set(const uint8_t bssid[WIFIMAN_BSSID_MAXLEN])
+{
+	for (int i = 0; i < WIFIMAN_BSSID_MAXLEN; i++) {
+		if (bssid[i] != 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/* channel 0 scans all channels. With a channel and a BSSID given, it
+ * associates right away without a full scan. */
+static wifiman_error_t prepare_connecting(const wifiman_network_profile_t *info,
+		uint8_t channel)
 {
 	if (!m.initialized) {
 		return WIFIMAN_NOT_INITIALIZED;
@@ -174,20 +525,37 @@ static wifiman_error_t connect_internal(const wifiman_network_profile_t *info)
 	strncpy((char *)esp_conf.sta.password, info->password, PASSWORD_MAXLEN);
 
 	memcpy(esp_conf.sta.bssid, info->bssid, sizeof(esp_conf.sta.bssid));
-	if (info->bssid[0] != 0 && info->bssid[1] != 0 &&
-			info->bssid[2] != 0 && info->bssid[3] != 0 &&
-			info->bssid[4] != 0 && info->bssid[5] != 0) {
-		esp_conf.sta.bssid_set = true;
-	}
+	esp_conf.sta.bssid_set = is_bssid_set(info->bssid);
+	esp_conf.sta.channel = channel;
+	esp_conf.sta.scan_method = WIFI_FAST_SCAN;
 
 	if (esp_wifi_set_config(ESP_IF_WIFI_STA, &esp_conf) != ESP_OK) {
 		return WIFIMAN_WRONG_SETTINGS;
 	}
 
 	memcpy(&m.ap, info, sizeof(m.ap)); // keep the conncted ap information
+
+	return WIFIMAN_SUCCESS;
+}
+
+static wifiman_error_t connect_internal(const wifiman_network_profile_t *info,
+		uint8_t channel, TickType_t timeout)
+{
+	wifiman_error_t rc = prepare_connecting(info, channel);
+	if (rc != WIFIMAN_SUCCESS) {
+		return rc;
+	}
+
 	esp_wifi_connect();
-	xEventGroupWaitBits(m.event, EVENT_CONNECTED | EVENT_DISCONNECTED,
-					pdTRUE, pdFALSE, portMAX_DELAY);
+	EventBits_t bits = xEventGroupWaitBits(m.event,
+			EVENT_CONNECTED | EVENT_DISCONNECTED,
+			pdTRUE, pdFALSE, timeout);
+	if (!(bits & (EVENT_CONNECTED | EVENT_DISCONNECTED))) {
+		esp_wifi_disconnect();
+		xEventGroupWaitBits(m.event, EVENT_DISCONNECTED,
+				pdTRUE, pdFALSE, pdMS_TO_TICKS(1000));
+		return WIFIMAN_NOT_RESPONDING;
+	}
 	if (!m.connected) {
 		return WIFIMAN_ERROR;
 	}
@@ -240,6 +608,10 @@ static void turn_wifi_off_internal(void)
 	esp_wifi_deinit();
 }
 
+static void request_flush(TimerHandle_t timer);
+static bool flush_network_cache(void);
+static void schedule_flush(uint32_t dirty);
+
 bool wifiman_on(void)
 {
 	bool rc;
@@ -248,6 +620,21 @@ bool wifiman_on(void)
 		pthread_mutex_init(&m.lock, NULL);
 		m.event = xEventGroupCreate();
 		assert(m.event != NULL);
+		m.rssi_sampler = xTimerCreate("rssi",
+				pdMS_TO_TICKS(WIFIMAN_RSSI_SAMPLE_INTERVAL_MSEC),
+				pdTRUE, NULL, sample_rssi);
+		assert(m.rssi_sampler != NULL);
+		pthread_mutex_init(&m.pending.lock, NULL);
+		m.pending.timer = xTimerCreate("connect", 1, pdFALSE, NULL,
+				connect_timed_out);
+		assert(m.pending.timer != NULL);
+		m.flusher = xTimerCreate("flush",
+				pdMS_TO_TICKS(WIFIMAN_REGISTRY_FLUSH_DELAY_MSEC),
+				pdFALSE, NULL, request_flush);
+		assert(m.flusher != NULL);
+		m.lease_renewer = xTimerCreate("lease", 1, pdFALSE, NULL,
+				request_lease_renewal);
+		assert(m.lease_renewer != NULL);
 		m.initialized = true;
 	}
 
@@ -269,6 +656,7 @@ void wifiman_off(void)
 
 	pthread_mutex_lock(&m.lock);
 	{
+		flush_network_cache();
 		turn_wifi_off_internal();
 	}
 	pthread_mutex_unlock(&m.lock);
@@ -380,18 +768,80 @@ bool wifiman_get_hostname(const char **hostname)
 	return tcpip_adapter_get_hostname(interface, hostname) == ESP_OK;
 }
 
-wifiman_error_t wifiman_connect(const wifiman_network_profile_t *info)
+static bool is_profile_valid(const wifiman_network_profile_t *info)
 {
 	if (info == NULL) {
-		return WIFIMAN_INVALID_PARAM;
+		return false;
 	}
 
 	size_t len = strnlen(info->ssid, WIFIMAN_SSID_MAXLEN);
 	if (len == 0 || len >= WIFIMAN_SSID_MAXLEN) {
-		return WIFIMAN_INVALID_PARAM;
+		return false;
 	}
 	len = strnlen(info->password, WIFIMAN_PASS_MAXLEN);
 	if (len == 0 || len >= WIFIMAN_PASS_MAXLEN) {
+		return false;
+	}
+
+	return true;
+}
+
+wifiman_error_t wifiman_connect(const wifiman_network_profile_t *info)
+{
+	if (!is_profile_valid(info)) {
+		return WIFIMAN_INVALID_PARAM;
+	}
+
+	wifiman_error_t rc;
+
+	pthread_mutex_lock(&m.lock);
+	{
+		rc = connect_internal(info, 0, portMAX_DELAY);
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	return rc;
+}
+
+static wifiman_error_t connect_async_internal(
+		const wifiman_network_profile_t *info,
+		wifiman_connect_cb_t cb, void *context, unsigned int timeout_ms)
+{
+	wifiman_error_t rc = prepare_connecting(info, 0);
+	if (rc != WIFIMAN_SUCCESS) {
+		return rc;
+	}
+
+	/* armed before connecting not to miss a quick completion */
+	pthread_mutex_lock(&m.pending.lock);
+	{
+		m.pending.cb = cb;
+		m.pending.context = context;
+	}
+	pthread_mutex_unlock(&m.pending.lock);
+
+	if (timeout_ms > 0) {
+		TickType_t ticks = pdMS_TO_TICKS(timeout_ms);
+		xTimerChangePeriod(m.pending.timer, ticks > 0? ticks : 1, 0);
+	}
+
+	if (esp_wifi_connect() != ESP_OK) {
+		pthread_mutex_lock(&m.pending.lock);
+		{
+			m.pending.cb = NULL;
+		}
+		pthread_mutex_unlock(&m.pending.lock);
+		xTimerStop(m.pending.timer, 0);
+		return WIFIMAN_NOT_RESPONDING;
+	}
+
+	return WIFIMAN_SUCCESS;
+}
+
+wifiman_error_t wifiman_connect_async(const wifiman_network_profile_t *info,
+		wifiman_connect_cb_t cb, void *context, unsigned int timeout_ms)
+{
+	if (!is_profile_valid(info) || cb == NULL) {
 		return WIFIMAN_INVALID_PARAM;
 	}
 
@@ -399,7 +849,114 @@ wifiman_error_t wifiman_connect(const wifiman_network_profile_t *info)
 
 	pthread_mutex_lock(&m.lock);
 	{
-		rc = connect_internal(info);
+		rc = connect_async_internal(info, cb, context, timeout_ms);
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	return rc;
+}
+
+static bool find_saved_network(wifiman_network_profile_t *profile,
+		const char *ssid);
+
+/* the count goes out with the next flush rather than from the event
+ * handler on every association */
+static void count_lease_reuse(bool reused)
+{
+	uint8_t count = reused? (uint8_t)(m.last.reused + 1) : 0;
+
+	if (count != m.last.reused) {
+		m.last.reused = count;
+		schedule_flush(DIRTY_LAST);
+	}
+}
+
+static wifiman_error_t connect_last_internal(void)
+{
+	uint8_t buf[sizeof(wifiman_network_profile_t) + WIFIMAN_PASS_MAXLEN]
+		= { 0, };
+	wifiman_network_profile_t *profile = (void *)buf;
+	const struct last_connection *last = get_last_connection();
+
+	if (last->ssid[0] == '\0' || !find_saved_network(profile, last->ssid)) {
+		return WIFIMAN_ERROR;
+	}
+
+	memcpy(profile->bssid, last->bssid, sizeof(profile->bssid));
+	profile->channel = last->channel;
+
+	m.static_ip = is_lease_valid(last)
+		&& last->reused < WIFIMAN_STATIC_IP_MAX_REUSE
+		&& set_static_ip(last);
+
+	info("fast connecting to %s on channel %u%s", last->ssid,
+			last->channel, m.static_ip? " with the last lease" : "");
+
+	wifiman_error_t rc = connect_internal(profile, last->channel,
+			pdMS_TO_TICKS(WIFIMAN_FAST_CONNECT_TIMEOUT_MSEC));
+
+	if (rc != WIFIMAN_SUCCESS && m.static_ip) {
+		m.static_ip = false;
+		restore_dhcp();
+	} else if (rc == WIFIMAN_SUCCESS) {
+		count_lease_reuse(m.static_ip);
+		if (m.static_ip) {
+			schedule_lease_renewal(last);
+		}
+	}
+
+	return rc;
+}
+
+wifiman_error_t wifiman_connect_last(void)
+{
+	if (!m.initialized) {
+		return WIFIMAN_NOT_INITIALIZED;
+	}
+
+	wifiman_error_t rc;
+
+	pthread_mutex_lock(&m.lock);
+	{
+		rc = connect_last_internal();
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	return rc;
+}
+
+static wifiman_error_t connect_best_internal(void);
+
+wifiman_error_t wifiman_connect_best(void)
+{
+	if (!m.initialized) {
+		return WIFIMAN_NOT_INITIALIZED;
+	}
+
+	wifiman_error_t rc;
+
+	pthread_mutex_lock(&m.lock);
+	{
+		rc = connect_best_internal();
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	return rc;
+}
+
+static wifiman_error_t roam_internal(uint8_t min_gain_db);
+
+wifiman_error_t wifiman_roam(uint8_t min_gain_db)
+{
+	if (!m.initialized) {
+		return WIFIMAN_NOT_INITIALIZED;
+	}
+
+	wifiman_error_t rc;
+
+	pthread_mutex_lock(&m.lock);
+	{
+		rc = roam_internal(min_gain_db);
 	}
 	pthread_mutex_unlock(&m.lock);
 
@@ -570,40 +1127,7 @@ int8_t wifiman_get_rssi(void)
 		return 0;
 	}
 
-	wifi_scan_config_t conf = {
-		.ssid = (uint8_t *)m.ap.ssid,
-		.bssid = m.ap.bssid,
-	};
-	wifi_ap_record_t ap = { 0, };
-
-	int n = 1;
-	int nr_scanned;
-	pthread_mutex_lock(&m.lock);
-	{
-		nr_scanned = scan_internal(&ap, &conf, (uint16_t *)&n);
-	}
-	pthread_mutex_unlock(&m.lock);
-	assert(nr_scanned == 1);
-
-	m.ap.rssi = ap.rssi;
-
-	return ap.rssi;
-}
-
-wifiman_error_t wifiman_register_event_handler(wifiman_event_t event,
-		wifiman_event_handler_t handler)
-{
-	switch (event) {
-	case WIFIMAN_EVENT_CONNECTED:
-	case WIFIMAN_EVENT_DISCONNECTED:
-		m.event_handlers[event] = handler;
-		break;
-	default:
-		warn("Unsupported type handler: %d.", event);
-		return WIFIMAN_INVALID_PARAM;
-	}
-
-	return WIFIMAN_SUCCESS;
+	return linkq_get_rssi();
 }
 
 static void load_network_registry(kvstore_t *kv,
@@ -615,25 +1139,6 @@ static void load_network_registry(kvstore_t *kv,
 	}
 }
 
-static size_t count_saved_networks_internal(void)
-{
-	size_t count = 0;
-
-	kvstore_t *kv = nvs_kvstore_open(WIFI_KVSTORE_NAMESPACE);
-	if (kv == NULL) {
-		error("cannot open %s kvstore", WIFI_KVSTORE_NAMESPACE);
-		return 0;
-	}
-
-	struct network_registry registry;
-	load_network_registry(kv, &registry);
-	count = registry.count;
-
-	nvs_kvstore_close(kv);
-
-	return count;
-}
-
 static uint8_t get_empty_network_slot_index(const struct network_registry *p)
 {
 	for (uint8_t i = 0; i < WIFIMAN_MAX_NETWORK_PROFILES; i++) {
@@ -676,8 +1181,7 @@ static bool read_network_profile(wifiman_network_profile_t *profile,
 	char index_string[4] = { 0, };
 	snprintf(index_string, 3, "%u", index);
 
-	size_t len = sizeof(*profile) + WIFIMAN_PASS_MAXLEN;
-	if (kvstore_read(kv, index_string, profile, len) == 0) {
+	if (kvstore_read(kv, index_string, profile, PROFILE_SIZE) == 0) {
 		error("cannot read");
 		return false;
 	}
@@ -685,9 +1189,25 @@ static bool read_network_profile(wifiman_network_profile_t *profile,
 	return true;
 }
 
-static bool save_network_internal(const wifiman_network_profile_t *profile)
+static void load_network_history(kvstore_t *kv,
+		struct network_history *history)
+{
+	if (kvstore_read(kv, WIFI_KVSTORE_HISTORY, history, sizeof(*history))
+			!= sizeof(*history)) {
+		memset(history, 0, sizeof(*history));
+	}
+}
+
+static wifiman_network_profile_t *get_cached_profile(uint8_t index)
 {
-	bool rc = false;
+	return (wifiman_network_profile_t *)(void *)m.cache.profiles[index];
+}
+
+static bool load_network_cache(void)
+{
+	if (m.cache.loaded) {
+		return true;
+	}
 
 	kvstore_t *kv = nvs_kvstore_open(WIFI_KVSTORE_NAMESPACE);
 	if (kv == NULL) {
@@ -695,39 +1215,33 @@ static bool save_network_internal(const wifiman_network_profile_t *profile)
 		return false;
 	}
 
-	struct network_registry registry;
-	load_network_registry(kv, &registry);
-
-	uint8_t index = get_empty_network_slot_index(&registry);
-
-	if (index >= WIFIMAN_MAX_NETWORK_PROFILES) {
-		error("no space for additional network profile(max: %u).",
-				WIFIMAN_MAX_NETWORK_PROFILES);
-		goto out;
-	}
+	load_network_registry(kv, &m.cache.registry);
+	load_network_history(kv, &m.cache.history);
 
-	if (!write_network_profile(profile, kv, index)) {
-		goto out;
+	for (uint8_t i = 0; i < WIFIMAN_MAX_NETWORK_PROFILES; i++) {
+		memset(m.cache.profiles[i], 0, sizeof(m.cache.profiles[i]));
+		if (m.cache.registry.index[i].used
+				&& !read_network_profile(get_cached_profile(i),
+					kv, i)) {
+			m.cache.registry.index[i].used = false;
+		}
 	}
 
-	registry.index[index].used = true;
-	registry.count = (uint8_t)(registry.count + 1);
+	nvs_kvstore_close(kv);
 
-	if (!update_network_registry(&registry, kv)) {
-		goto out;
-	}
+	m.cache.dirty = 0;
+	m.cache.loaded = true;
 
-	rc = true;
-out:
-	nvs_kvstore_close(kv);
-	return rc;
+	return true;
 }
 
-static bool get_network_internal(wifiman_network_profile_t *profile,
-		uint8_t index)
+/* everything dirty goes out with a single commit. The registry goes last
+ * so that it never points to a profile not written yet. */
+static bool flush_network_cache(void)
 {
-	struct network_registry registry;
-	bool rc = false;
+	if (m.cache.dirty == 0) {
+		return true;
+	}
 
 	kvstore_t *kv = nvs_kvstore_open(WIFI_KVSTORE_NAMESPACE);
 	if (kv == NULL) {
@@ -735,81 +1249,380 @@ static bool get_network_internal(wifiman_network_profile_t *profile,
 		return false;
 	}
 
-	load_network_registry(kv, &registry);
+	nvs_kvstore_begin(kv);
 
-	if (!registry.index[index].used) {
-		goto out;
+	for (uint8_t i = 0; i < WIFIMAN_MAX_NETWORK_PROFILES; i++) {
+		if (!(m.cache.dirty & (1UL << i))) {
+			continue;
+		}
+		if (!m.cache.registry.index[i].used
+				|| write_network_profile(get_cached_profile(i),
+					kv, i)) {
+			m.cache.dirty &= ~(1UL << i);
+		}
 	}
-	if (!read_network_profile(profile, kv, index)) {
-		goto out;
+
+	if ((m.cache.dirty & DIRTY_HISTORY)
+			&& kvstore_write(kv, WIFI_KVSTORE_HISTORY,
+				&m.cache.history, sizeof(m.cache.history))
+			== sizeof(m.cache.history)) {
+		m.cache.dirty &= ~DIRTY_HISTORY;
 	}
 
-	rc = true;
-out:
+	if ((m.cache.dirty & DIRTY_LAST)
+			&& kvstore_write(kv, WIFI_KVSTORE_LAST,
+				&m.last, sizeof(m.last)) == sizeof(m.last)) {
+		m.cache.dirty &= ~DIRTY_LAST;
+	}
+
+	if ((m.cache.dirty & ~(DIRTY_HISTORY | DIRTY_LAST)) == DIRTY_REGISTRY
+			&& update_network_registry(&m.cache.registry, kv)) {
+		m.cache.dirty &= ~DIRTY_REGISTRY;
+	}
+
+	if (!nvs_kvstore_commit(kv)) {
+		error("cannot commit");
+	}
 	nvs_kvstore_close(kv);
-	return rc;
+
+	return m.cache.dirty == 0;
 }
 
-static bool clear_networks_internal(void)
+static void flush_network_cache_job(void *context)
 {
-	struct network_registry registry = { 0, };
-	bool rc = false;
+	pthread_mutex_lock(&m.lock);
+	{
+		if (!flush_network_cache()) {
+			xTimerReset(m.flusher, 0);
+		}
+	}
+	pthread_mutex_unlock(&m.lock);
 
-	kvstore_t *kv = nvs_kvstore_open(WIFI_KVSTORE_NAMESPACE);
-	if (kv == NULL) {
-		error("cannot open %s kvstore", WIFI_KVSTORE_NAMESPACE);
+	unused(context);
+}
+
+/* the timer task has not enough stack for flash writes */
+static void request_flush(TimerHandle_t timer)
+{
+	if (!jobpool_schedule(flush_network_cache_job, NULL)) {
+		xTimerReset(timer, 0);
+	}
+}
+
+/* every change within the delay is coalesced into a flush */
+static void schedule_flush(uint32_t dirty)
+{
+	m.cache.dirty |= dirty;
+
+	if (m.flusher == NULL || xTimerReset(m.flusher, 0) != pdPASS) {
+		flush_network_cache();
+	}
+}
+
+static size_t count_saved_networks_internal(void)
+{
+	if (!load_network_cache()) {
+		return 0;
+	}
+
+	return m.cache.registry.count;
+}
+
+static void record_connection_result(uint8_t index, bool success)
+{
+	if (!load_network_cache()) {
+		return;
+	}
+
+	struct network_history *history = &m.cache.history;
+
+	if (history->slot[index].attempts >= WIFIMAN_HISTORY_MAX_ATTEMPTS) {
+		history->slot[index].attempts /= 2;
+		history->slot[index].successes /= 2;
+	}
+	history->slot[index].attempts++;
+	if (success) {
+		history->slot[index].successes++;
+	}
+
+	schedule_flush(DIRTY_HISTORY);
+}
+
+static bool save_network_internal(const wifiman_network_profile_t *profile)
+{
+	if (!load_network_cache()) {
 		return false;
 	}
 
-	if (kvstore_write(kv, WIFI_KVSTORE_REGISTRY, &registry, sizeof(registry))
-			!= sizeof(registry)) {
+	uint8_t index = get_empty_network_slot_index(&m.cache.registry);
+
+	if (index >= WIFIMAN_MAX_NETWORK_PROFILES) {
+		error("no space for additional network profile(max: %u).",
+				WIFIMAN_MAX_NETWORK_PROFILES);
+		return false;
+	}
+
+	memset(m.cache.profiles[index], 0, sizeof(m.cache.profiles[index]));
+	memcpy(get_cached_profile(index), profile, sizeof(*profile)
+			+ strnlen(profile->password, WIFIMAN_PASS_MAXLEN - 1));
+
+	m.cache.registry.index[index].used = true;
+	m.cache.registry.count = (uint8_t)(m.cache.registry.count + 1);
+	memset(&m.cache.history.slot[index], 0,
+			sizeof(m.cache.history.slot[index]));
+
+	/* written through as the caller may reboot right after */
+	m.cache.dirty |= (1UL << index) | DIRTY_REGISTRY | DIRTY_HISTORY;
+	return flush_network_cache();
+}
+
+static bool get_network_internal(wifiman_network_profile_t *profile,
+		uint8_t index)
+{
+	if (index >= WIFIMAN_MAX_NETWORK_PROFILES || !load_network_cache()
+			|| !m.cache.registry.index[index].used) {
+		return false;
+	}
+
+	memcpy(profile, get_cached_profile(index), PROFILE_SIZE);
+
+	return true;
+}
+
+static bool find_saved_network(wifiman_network_profile_t *profile,
+		const char *ssid)
+{
+	for (uint8_t i = 0; i < WIFIMAN_MAX_NETWORK_PROFILES; i++) {
+		if (get_network_internal(profile, i)
+				&& strncmp(profile->ssid, ssid,
+					WIFIMAN_SSID_MAXLEN) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static int load_saved_networks(wifiman_saved_network_t *saved)
+{
+	int n = 0;
+
+	if (!load_network_cache()) {
+		return 0;
+	}
+
+	for (uint8_t i = 0; i < WIFIMAN_MAX_NETWORK_PROFILES; i++) {
+		const wifiman_network_profile_t *profile =
+			get_cached_profile(i);
+
+		if (!m.cache.registry.index[i].used) {
+			continue;
+		}
+
+		saved[n++] = (wifiman_saved_network_t) {
+			.ssid = profile->ssid,
+			.bssid = is_bssid_set(profile->bssid)?
+				profile->bssid : NULL,
+			.index = i,
+			.attempts = m.cache.history.slot[i].attempts,
+			.successes = m.cache.history.slot[i].successes,
+		};
+	}
+
+	return n;
+}
+
+/* one scan for all the saved networks instead of one per network */
+static int rank_saved_networks(wifiman_candidate_t *candidates, int maxlen)
+{
+	wifiman_saved_network_t saved[WIFIMAN_MAX_NETWORK_PROFILES];
+	wifi_ap_record_t *records = NULL;
+	wifiman_network_profile_t *scanlist = NULL;
+	uint16_t nr_records = WIFIMAN_SCAN_MAXLEN;
+	int n = 0;
+
+	int nr_saved = load_saved_networks(saved);
+	if (nr_saved == 0) {
+		return 0;
+	}
+
+	if ((records = calloc(nr_records, sizeof(*records))) == NULL
+			|| (scanlist = calloc(nr_records, sizeof(*scanlist)))
+			== NULL) {
+		error("Failed to allocate.");
 		goto out;
 	}
 
-	rc = true;
+	int nr_scanned = scan_internal(records, NULL, &nr_records);
+	for (int i = 0; i < nr_scanned; i++) {
+		convert_esp_record_to_profile(&scanlist[i], &records[i]);
+	}
+
+	n = wifiman_rank(candidates, maxlen,
+			scanlist, nr_scanned, saved, nr_saved);
 out:
-	nvs_kvstore_close(kv);
+	free(scanlist);
+	free(records);
+	return n;
+}
+
+static wifiman_error_t connect_best_internal(void)
+{
+	wifiman_candidate_t candidates[WIFIMAN_MAX_NETWORK_PROFILES];
+	uint8_t buf[sizeof(wifiman_network_profile_t) + WIFIMAN_PASS_MAXLEN];
+	wifiman_network_profile_t *profile = (void *)buf;
+	wifiman_error_t rc = WIFIMAN_ERROR;
+
+	int n = rank_saved_networks(candidates, WIFIMAN_MAX_NETWORK_PROFILES);
+
+	for (int i = 0; i < n && rc != WIFIMAN_SUCCESS; i++) {
+		const wifiman_candidate_t *p = &candidates[i];
+
+		memset(buf, 0, sizeof(buf));
+		if (!get_network_internal(profile, p->index)) {
+			continue;
+		}
+		memcpy(profile->bssid, p->bssid, sizeof(profile->bssid));
+
+		info("connecting to %s(%d dBm, score %d) on channel %u",
+				profile->ssid, p->rssi, p->score, p->channel);
+
+		rc = connect_internal(profile, p->channel,
+				pdMS_TO_TICKS(WIFIMAN_CONNECT_TIMEOUT_MSEC));
+		record_connection_result(p->index, rc == WIFIMAN_SUCCESS);
+	}
+
 	return rc;
 }
 
-static bool delete_network(const wifiman_network_profile_t *profile)
+static bool find_roaming_target(wifiman_network_profile_t *target,
+		int8_t rssi, uint8_t min_gain_db)
 {
-	struct network_registry registry;
-	bool rc = false;
+	wifi_scan_config_t conf = { .ssid = (uint8_t *)m.ap.ssid, };
+	uint16_t n = WIFIMAN_SCAN_MAXLEN;
+	bool found = false;
 
-	kvstore_t *kv = nvs_kvstore_open(WIFI_KVSTORE_NAMESPACE);
-	if (kv == NULL) {
-		error("cannot open %s kvstore", WIFI_KVSTORE_NAMESPACE);
+	wifi_ap_record_t *records = calloc(n, sizeof(*records));
+	if (records == NULL) {
+		error("Failed to allocate.");
 		return false;
 	}
 
-	load_network_registry(kv, &registry);
+	n = (uint16_t)scan_internal(records, &conf, &n);
 
-	for (uint8_t i = 0; i < WIFIMAN_MAX_NETWORK_PROFILES; i++) {
-		if (!registry.index[i].used) {
+	for (uint16_t i = 0; i < n; i++) {
+		const wifi_ap_record_t *p = &records[i];
+
+		if (memcmp(p->bssid, m.ap.bssid, sizeof(p->bssid)) == 0
+				|| p->rssi < rssi + min_gain_db
+				|| (found && p->rssi <= target->rssi)) {
 			continue;
 		}
 
-		uint8_t buf[sizeof(wifiman_network_profile_t)
-			+ WIFIMAN_PASS_MAXLEN] = { 0, };
-		wifiman_network_profile_t *saved = (void *)buf;
+		convert_esp_record_to_profile(target, p);
+		found = true;
+	}
+
+	free(records);
+
+	return found;
+}
+
+static wifiman_error_t roam_internal(uint8_t min_gain_db)
+{
+	uint8_t buf[sizeof(wifiman_network_profile_t) + WIFIMAN_PASS_MAXLEN]
+		= { 0, };
+	wifiman_network_profile_t *profile = (void *)buf;
+	wifiman_network_profile_t target = { 0, };
+
+	if (!m.connected) {
+		return WIFIMAN_ERROR;
+	}
+	if (!find_roaming_target(&target, linkq_get_rssi(), min_gain_db)
+			|| !find_saved_network(profile, m.ap.ssid)) {
+		return WIFIMAN_ERROR;
+	}
+
+	uint8_t channel = m.ap.channel;
+	uint8_t bssid[WIFIMAN_BSSID_MAXLEN];
+	memcpy(bssid, m.ap.bssid, sizeof(bssid));
+
+	info("roaming to %02x:%02x:%02x:%02x:%02x:%02x(%d dBm) on channel %u",
+			target.bssid[0], target.bssid[1], target.bssid[2],
+			target.bssid[3], target.bssid[4], target.bssid[5],
+			target.rssi, target.channel);
 
-		if (!read_network_profile(saved, kv, i)) {
+	m.roaming = true;
+
+	/* keep the address so that open sessions survive the handover, as
+	 * long as the lease does */
+	const struct last_connection *last = get_last_connection();
+	m.static_ip = false;
+	bool keep_ip = is_lease_valid(last) && set_static_ip(last);
+
+	memcpy(profile->bssid, target.bssid, sizeof(profile->bssid));
+	wifiman_error_t rc = connect_internal(profile, target.channel,
+			pdMS_TO_TICKS(WIFIMAN_FAST_CONNECT_TIMEOUT_MSEC));
+
+	if (rc != WIFIMAN_SUCCESS) {
+		warn("roaming failed. back to the previous AP");
+		memcpy(profile->bssid, bssid, sizeof(profile->bssid));
+		rc = connect_internal(profile, channel,
+				pdMS_TO_TICKS(WIFIMAN_FAST_CONNECT_TIMEOUT_MSEC));
+	}
+
+	m.static_ip = keep_ip && rc == WIFIMAN_SUCCESS;
+	if (m.static_ip) {
+		schedule_lease_renewal(last);
+	} else if (keep_ip) {
+		restore_dhcp();
+	}
+
+	m.roaming = false;
+
+	if (rc != WIFIMAN_SUCCESS) {
+		wifiman_event_publish(WIFIMAN_EVENT_DISCONNECTED);
+	}
+
+	return rc;
+}
+
+static bool clear_networks_internal(void)
+{
+	if (!load_network_cache()) {
+		return false;
+	}
+
+	memset(&m.cache.registry, 0, sizeof(m.cache.registry));
+	m.cache.dirty |= DIRTY_REGISTRY;
+
+	return flush_network_cache();
+}
+
+static bool delete_network(const wifiman_network_profile_t *profile)
+{
+	if (!load_network_cache()) {
+		return false;
+	}
+
+	for (uint8_t i = 0; i < WIFIMAN_MAX_NETWORK_PROFILES; i++) {
+		const wifiman_network_profile_t *saved = get_cached_profile(i);
+
+		if (!m.cache.registry.index[i].used) {
 			continue;
 		}
 		if (strcmp(profile->ssid, saved->ssid) == 0 &&
 				memcmp(profile->bssid, saved->bssid,
 					WIFIMAN_BSSID_MAXLEN) == 0) {
-			registry.index[i].used = false;
-			if (update_network_registry(&registry, kv)) {
-				rc = true;
-			}
-			break;
+			m.cache.registry.index[i].used = false;
+			m.cache.registry.count =
+				(uint8_t)(m.cache.registry.count - 1);
+			m.cache.dirty |= DIRTY_REGISTRY;
+			return flush_network_cache();
 		}
 	}
 
-	nvs_kvstore_close(kv);
-	return rc;
+	return false;
 }
 
 size_t wifiman_count_networks(void)
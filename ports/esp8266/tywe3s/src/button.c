@@ -1,61 +1,99 @@
-#include "libmcu/button.h"
 #include <stdint.h>
 #include <stdbool.h>
 #include "driver/gpio.h"
-#include "jobpool.h"
-#include "light.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "debounce.h"
 #include "switch.h"
 
-#define BUTTON1_BIT				GPIO_Pin_14
-#define BUTTON1_PIN				GPIO_NUM_14
-#define BUTTON2_BIT				GPIO_Pin_12
-#define BUTTON2_PIN				GPIO_NUM_12
+/* above the jobpool and the network so that OTA does not delay a press */
+#define DEBOUNCE_TASK_PRIORITY			(configMAX_PRIORITIES - 2)
+#define DEBOUNCE_TASK_STACK_SIZE		2048
 
-static void enable_button_interrupt(void)
-{
-	gpio_set_intr_type(BUTTON1_PIN, GPIO_INTR_NEGEDGE);
-	gpio_set_intr_type(BUTTON2_PIN, GPIO_INTR_NEGEDGE);
-}
+static const gpio_num_t buttons[] = {
+	GPIO_NUM_14,
+	GPIO_NUM_12,
+};
 
-static void disable_button_interrupt(void)
-{
-	gpio_set_intr_type(BUTTON1_PIN, GPIO_INTR_DISABLE);
-	gpio_set_intr_type(BUTTON2_PIN, GPIO_INTR_DISABLE);
-}
+#define NR_BUTTONS				(sizeof(buttons) / sizeof(buttons[0]))
 
-static void button_task(void *context)
+static struct debounce_queue queue;
+static TaskHandle_t debounce_task_handle;
+static uint32_t (*poll_switch)(uint32_t now_usec);
+
+static uint32_t get_earlier(uint32_t a, uint32_t b)
 {
-	button_poll(context);
-	enable_button_interrupt();
+	if (a == 0 || (b != 0 && b < a)) {
+		return b;
+	}
+	return a;
 }
 
-static void isr_button(void *arg)
+static void debounce_task(void *context)
 {
-	jobpool_schedule(button_task, arg);
-	disable_button_interrupt();
+	TickType_t timeout = portMAX_DELAY;
+
+	(void)context;
+
+	while (1) {
+		ulTaskNotifyTake(pdTRUE, timeout);
+
+		uint32_t now = (uint32_t)esp_timer_get_time();
+		uint32_t usec = get_earlier(debounce_process(&queue, now),
+				poll_switch(now));
+
+		timeout = usec? pdMS_TO_TICKS((usec + 999) / 1000) + 1
+			: portMAX_DELAY;
+	}
 }
 
-int switch1_get_state(void)
+static void IRAM_ATTR isr_button(void *arg)
 {
-	return !gpio_get_level(BUTTON1_PIN);
+	unsigned int n = (unsigned int)(uintptr_t)arg;
+	BaseType_t woken = pdFALSE;
+
+	debounce_push(&queue, (uint8_t)n, !gpio_get_level(buttons[n]),
+			(uint32_t)esp_timer_get_time());
+	vTaskNotifyGiveFromISR(debounce_task_handle, &woken);
+
+	if (woken == pdTRUE) {
+		portYIELD_FROM_ISR();
+	}
 }
 
-int switch2_get_state(void)
+int switch_get_state(unsigned int n)
 {
-	return !gpio_get_level(BUTTON2_PIN);
+	if (n >= NR_BUTTONS) {
+		return 0;
+	}
+
+	return !gpio_get_level(buttons[n]);
 }
 
-void button_hw_init(void)
+void switch_hw_init(void (*changed)(unsigned int n, bool pressed,
+			uint32_t usec), uint32_t (*poll)(uint32_t now_usec))
 {
 	gpio_config_t io_conf = {
-		.pin_bit_mask = BUTTON1_BIT | BUTTON2_BIT,
-		.intr_type = GPIO_INTR_NEGEDGE,
+		.intr_type = GPIO_INTR_ANYEDGE,
 		.mode = GPIO_MODE_INPUT,
 		.pull_up_en = GPIO_PULLUP_ENABLE,
 	};
+
+	for (unsigned int i = 0; i < NR_BUTTONS; i++) {
+		io_conf.pin_bit_mask |= 1UL << buttons[i];
+	}
 	gpio_config(&io_conf);
 
+	poll_switch = poll;
+	debounce_init(NR_BUTTONS, changed, switch_get_state);
+	xTaskCreate(debounce_task, "debounce", DEBOUNCE_TASK_STACK_SIZE,
+			NULL, DEBOUNCE_TASK_PRIORITY, &debounce_task_handle);
+
 	gpio_install_isr_service(0);
-	gpio_isr_handler_add(BUTTON1_PIN, isr_button, (void *)BUTTON1_PIN);
-	gpio_isr_handler_add(BUTTON2_PIN, isr_button, (void *)BUTTON2_PIN);
+	for (unsigned int i = 0; i < NR_BUTTONS; i++) {
+		gpio_isr_handler_add(buttons[i], isr_button,
+				(void *)(uintptr_t)i);
+	}
 }
@@ -1,4 +1,6 @@
 #include <assert.h>
+#include <string.h>
+#include <pthread.h>
 
 #include "libmcu/logging.h"
 #include "libmcu/system.h"
@@ -9,39 +11,134 @@
 
 #include "sleep.h"
 #include "jobpool.h"
+#include "apptimer.h"
 #include "memory_storage.h"
 
 #include "dfu/dfu.h"
 #include "dfu/flash.h"
 
 #include "ota/ota.h"
-#include "ota/protocol/mqtt.h"
+#include "ota/protocol/http.h"
 #include "ota/format/json.h"
 
 #include "provisioning.h"
 #include "reporter.h"
+#include "roaming.h"
 #include "switch.h"
+#include "rules.h"
+#include "profile.h"
+#include "histogram.h"
+#include "heartbeat.h"
+#include "logbin.h"
+#include "logship.h"
+#include "uptime.h"
+#include "nvs_kvstore.h"
 
 extern void system_print_tasks_info(void);
 extern void mdns_test(void);
 extern void sntp_test(void);
 
+#if defined(LOGGING_BINARY)
+static bool ship_logs(const void *data, size_t datasize)
+{
+	return reporter_send(REPORT_LOGGING, data, datasize);
+}
+
+static void send_logs(void)
+{
+	logship_poll(uptime_get_ms());
+}
+#else
 static void send_logs(void)
 {
 	uint8_t buf[LOGGING_MESSAGE_MAXLEN + 32];
 	size_t bytes_read;
 
 	if (logging_count() &&
-			(bytes_read = logging_read(buf, sizeof(buf)) > 0)) {
+			(bytes_read = logging_read(buf, sizeof(buf))) > 0) {
 		reporter_send(REPORT_LOGGING, buf, bytes_read);
 	}
 }
+#endif
 
 #include <time.h>
 #include "wifi.h"
+#include "linkq.h"
+#include "mqtt.h"
 
 #define METRICS_REPORT_INTERVAL_SEC			3600 /* 1 hour */
 
+/* room left for the topic and the mqtt header */
+_Static_assert(HEARTBEAT_MAXLEN <= MQTT_NETWORK_BUFSIZE - 128,
+		"heartbeat may not fit in an mqtt packet");
+
+_Static_assert(JOBPOOL_STATS_JOBS == 4, "a metric set per job in metrics.def");
+
+/* a job has its function, to look up in the elf, followed by the wait and
+ * the run histograms in metrics.def. The other jobs have no function */
+static void update_jobpool_metrics(void)
+{
+	static const metric_key_t keys[JOBPOOL_STATS_MAX] = {
+		Job0Function, Job1Function, Job2Function, Job3Function,
+		[JOBPOOL_STATS_OTHER] = JobOtherWaitUnder10ms,
+	};
+	struct jobpool_stats stats[JOBPOOL_STATS_MAX];
+	unsigned int max_depth = 0;
+	unsigned int expired = 0;
+	unsigned int rejected = 0;
+
+	jobpool_get_stats(stats);
+
+	for (int i = 0; i < JOBPOOL_STATS_MAX; i++) {
+		metric_key_t key = keys[i];
+
+		if (i != JOBPOOL_STATS_OTHER) {
+			metrics_set(key, (int32_t)(uintptr_t)stats[i].job);
+			key = (metric_key_t)(key + 1);
+		}
+
+		for (int j = 0; j < JOBPOOL_HISTOGRAM_BUCKETS; j++) {
+			metrics_set((metric_key_t)(key + j),
+					(int32_t)stats[i].wait[j]);
+			metrics_set((metric_key_t)(key
+						+ JOBPOOL_HISTOGRAM_BUCKETS + j),
+					(int32_t)stats[i].run[j]);
+		}
+
+		expired += stats[i].expired;
+		rejected += stats[i].rejected;
+	}
+
+	for (int prio = 0; prio < JOBPOOL_PRIO_MAX; prio++) {
+		unsigned int depth = jobpool_get_max_depth((jobpool_prio_t)prio);
+		if (depth > max_depth) {
+			max_depth = depth;
+		}
+	}
+
+	metrics_set(JobMaxDepth, (int32_t)max_depth);
+	metrics_set(JobExpired, (int32_t)expired);
+	metrics_set(JobRejected, (int32_t)rejected);
+}
+
+/* the buffer is too big for the stack of the callers. OTA reports from a
+ * task of its own */
+static void send_heartbeat(void)
+{
+	static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+	static uint8_t buf[HEARTBEAT_MAXLEN];
+
+	pthread_mutex_lock(&lock);
+	{
+		size_t size_to_send = heartbeat_encode(buf, sizeof(buf));
+
+		if (size_to_send > 0) {
+			reporter_send(REPORT_HEARTBEAT, buf, size_to_send);
+		}
+	}
+	pthread_mutex_unlock(&lock);
+}
+
 static void send_metrics(bool force)
 {
 	static int32_t stamp;
@@ -55,35 +152,111 @@ static void send_metrics(bool force)
 	metrics_set(HeapHighWaterMark, system_get_heap_watermark());
 	metrics_set(StackHighWaterMark, system_get_current_stack_watermark());
 	metrics_set(WifiRssi, wifiman_get_rssi());
+	metrics_set(WifiRssiMin, linkq_get_rssi_min());
+	metrics_set(WifiRssiMax, linkq_get_rssi_max());
+	update_jobpool_metrics();
 
 	metrics_increase_by(ReportInterval, elapsed);
 	stamp = now;
 
-	uint8_t buf[32];
-	size_t size_to_send = metrics_get_encoded(buf, sizeof(buf));
-	if (size_to_send > 0 && force) {
-		reporter_send(REPORT_HEARTBEAT, buf, size_to_send);
+	if (force) {
+		send_heartbeat();
 	}
 
 	metrics_reset();
+	histogram_reset();
+	jobpool_reset_stats();
+}
+
+static void report_ota_result(ota_error_t error)
+{
+	update_jobpool_metrics();
+	send_heartbeat();
+
+	unused(error);
+}
+
+/* one byte of bitmask for all channels. bit 0 is for channel 1 */
+static void report_room(uint32_t states)
+{
+	uint8_t mask = (uint8_t)states;
+	reporter_send_event(REPORT_ROOM, &mask, sizeof(mask));
 }
 
-static void report_room(int n, const struct light *light)
+#define SCENE_PAYLOAD_MAXLEN				32
+
+static struct {
+	uint8_t payload[SCENE_PAYLOAD_MAXLEN];
+	size_t payload_size;
+	volatile bool pending;
+} scene;
+
+static void send_scene(void *context)
 {
-	reporter_send_event(REPORT_ROOM, &light->state, sizeof(light->state));
-	unused(n);
+	reporter_send(REPORT_SCENE, scene.payload, scene.payload_size);
+	scene.pending = false;
+	unused(context);
 }
 
+/* rules may run in the button path. Publishing goes to the jobpool not to
+ * hold it. */
+static bool publish_scene(const void *payload, size_t payload_size)
+{
+	if (scene.pending || payload_size > sizeof(scene.payload)) {
+		return false;
+	}
+
+	memcpy(scene.payload, payload, payload_size);
+	scene.payload_size = payload_size;
+	scene.pending = true;
+
+	if (!jobpool_schedule(send_scene, NULL)) {
+		scene.pending = false;
+		return false;
+	}
+
+	return true;
+}
+
+static int get_minute_of_day(void)
+{
+	time_t now = time(NULL);
+	struct tm tm;
+
+	if (now < 1600000000 /* not synchronized yet */
+			|| localtime_r(&now, &tm) == NULL) {
+		return -1;
+	}
+
+	return tm.tm_hour * 60 + tm.tm_min;
+}
+
+static const struct rules_ops rules_ops = {
+	.set_switches = switch_set_mask,
+	.get_switches = switch_get_mask,
+	.publish = publish_scene,
+	.get_minute_of_day = get_minute_of_day,
+};
+
 int main(void)
 {
 	static uint8_t logbuf[1024];
+#if defined(LOGGING_BINARY)
+	logbin_init(logbuf, sizeof(logbuf));
+	logship_init(ship_logs);
+#else
 	logging_init(memory_storage_init(logbuf, sizeof(logbuf)));
+#endif
 	pubsub_init();
 	metrics_init();
+	profile_init();
 
 	bool initialized = jobpool_init();
 	assert(initialized == true);
+	initialized = apptimer_init();
+	assert(initialized == true);
 
+	rules_init(&rules_ops, nvs_kvstore_open("rules"));
 	switch_init(report_room);
 
 	//mdns_test();
@@ -102,13 +275,17 @@ int main(void)
 	assert(reporter != NULL);
 
 	dfu_init(dfu_flash());
-	ota_init(reporter, ota_mqtt(), ota_json_parser());
+	ota_register_result_handler(report_ota_result);
+	ota_init(reporter, ota_http(), ota_json_parser());
 
 	send_metrics(false);
 
 	while (1) {
 		send_logs();
 		send_metrics(true);
+		roaming_poll();
+		switch_poll();
+		rules_poll();
 		sleep_ms(100);
 	}
 }
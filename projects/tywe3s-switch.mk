@@ -1,9 +1,11 @@
 PLATFORM_DIR := ports/esp8266
 BOARD_DIR := $(PLATFORM_DIR)/tywe3s
 PREREQUISITES += $(OUTDIR)/$(PLATFORM).elf
-DEFS += BUTTON_MAX=2
+DEFS += SWITCH_CHANNELS=2
+# logs in binary. tools/logdecode.py decodes them with $(OUTELF)
+DEFS += LOGGING_BINARY
+CFLAGS += -include include/logbin.h
 EXTRA_SRCS += \
-	external/libmcu/examples/jobpool.c \
 	$(wildcard $(BOARD_DIR)/src/*.c)
 
 OUTPUT := \
@@ -0,0 +1,206 @@
+#include "apptimer.h"
+
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "uptime.h"
+
+#if !defined(APPTIMER_TICK_MSEC)
+#define APPTIMER_TICK_MSEC			10
+#endif
+#if !defined(APPTIMER_SLOTS)
+#define APPTIMER_SLOTS				64 /* must be a power of 2 */
+#endif
+
+static struct {
+	pthread_mutex_t lock;
+	apptimer_t *slots[APPTIMER_SLOTS];
+	unsigned int tick; /* processed up to */
+	unsigned int armed_at; /* expiry the hardware timer is armed for */
+	bool armed;
+} m = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static unsigned int get_tick(unsigned int ms)
+{
+	return ms / APPTIMER_TICK_MSEC;
+}
+
+static apptimer_t **get_slot(unsigned int expiry)
+{
+	return &m.slots[get_tick(expiry) & (APPTIMER_SLOTS - 1)];
+}
+
+static bool is_due(unsigned int expiry, unsigned int now)
+{
+	return (int)(now - expiry) >= 0;
+}
+
+static void link_timer(apptimer_t *timer)
+{
+	apptimer_t **head = get_slot(timer->expiry);
+
+	timer->prev = NULL;
+	timer->next = *head;
+	if (*head != NULL) {
+		(*head)->prev = timer;
+	}
+	*head = timer;
+	timer->pending = true;
+}
+
+static void unlink_timer(apptimer_t *timer)
+{
+	if (timer->prev != NULL) {
+		timer->prev->next = timer->next;
+	} else {
+		*get_slot(timer->expiry) = timer->next;
+	}
+	if (timer->next != NULL) {
+		timer->next->prev = timer->prev;
+	}
+
+	timer->next = timer->prev = NULL;
+	timer->pending = false;
+}
+
+static bool get_earliest(unsigned int *expiry)
+{
+	bool found = false;
+
+	for (unsigned int i = 0; i < APPTIMER_SLOTS; i++) {
+		for (apptimer_t *p = m.slots[i]; p != NULL; p = p->next) {
+			if (!found || (int)(p->expiry - *expiry) < 0) {
+				*expiry = p->expiry;
+				found = true;
+			}
+		}
+	}
+
+	return found;
+}
+
+/* runs the due ones one by one as a callback may start or stop any timer.
+ * One started meanwhile is not due yet as the delay is at least 1ms. */
+static void run_slot(apptimer_t **head, unsigned int now)
+{
+	apptimer_t *p = *head;
+
+	while (p != NULL) {
+		if (!is_due(p->expiry, now)) {
+			p = p->next;
+			continue;
+		}
+
+		void (*callback)(void *context) = p->callback;
+		void *context = p->context;
+
+		unlink_timer(p);
+
+		pthread_mutex_unlock(&m.lock);
+		callback(context);
+		pthread_mutex_lock(&m.lock);
+
+		p = *head;
+	}
+}
+
+unsigned int apptimer_process(unsigned int now_ms)
+{
+	unsigned int tick = get_tick(now_ms);
+	unsigned int next = 0;
+
+	pthread_mutex_lock(&m.lock);
+	{
+		unsigned int elapsed = tick - m.tick;
+		unsigned int n = elapsed < APPTIMER_SLOTS?
+			elapsed + 1 : APPTIMER_SLOTS;
+
+		for (unsigned int i = 0; i < n; i++) {
+			run_slot(&m.slots[(m.tick + i) & (APPTIMER_SLOTS - 1)],
+					now_ms);
+		}
+
+		m.tick = tick;
+
+		/* armed under the lock not to override an earlier one started
+		 * right after */
+		if ((m.armed = get_earliest(&m.armed_at))) {
+			next = is_due(m.armed_at, now_ms)?
+				1 : m.armed_at - now_ms;
+			apptimer_hw_arm(next);
+		}
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	return next;
+}
+
+bool apptimer_start(apptimer_t *timer, unsigned int delay_ms,
+		void (*callback)(void *context), void *context)
+{
+	if (timer == NULL || callback == NULL) {
+		return false;
+	}
+
+	if (delay_ms == 0) {
+		delay_ms = 1;
+	}
+
+	pthread_mutex_lock(&m.lock);
+	{
+		if (timer->pending) {
+			unlink_timer(timer);
+		}
+
+		timer->expiry = uptime_get_ms() + delay_ms;
+		timer->callback = callback;
+		timer->context = context;
+		link_timer(timer);
+
+		if (!m.armed || (int)(timer->expiry - m.armed_at) < 0) {
+			m.armed = true;
+			m.armed_at = timer->expiry;
+			apptimer_hw_arm(delay_ms);
+		}
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	return true;
+}
+
+bool apptimer_stop(apptimer_t *timer)
+{
+	bool pending;
+
+	pthread_mutex_lock(&m.lock);
+	{
+		/* the hardware timer is left armed. It just finds nothing */
+		if ((pending = timer->pending)) {
+			unlink_timer(timer);
+		}
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	return pending;
+}
+
+bool apptimer_is_pending(const apptimer_t *timer)
+{
+	return timer->pending;
+}
+
+bool apptimer_init(void)
+{
+	pthread_mutex_lock(&m.lock);
+	{
+		memset(m.slots, 0, sizeof(m.slots));
+		m.tick = get_tick(uptime_get_ms());
+		m.armed = false;
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	return apptimer_hw_init();
+}
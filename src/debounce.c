@@ -0,0 +1,131 @@
+#include "debounce.h"
+
+#if !defined(DEBOUNCE_LOCKOUT_USEC)
+#define DEBOUNCE_LOCKOUT_USEC			30000
+#endif
+#if !defined(DEBOUNCE_CHANNELS_MAX)
+#define DEBOUNCE_CHANNELS_MAX			8
+#endif
+
+struct channel {
+	uint32_t changed_at;
+	bool pressed;
+	bool settling;
+};
+
+static struct {
+	struct channel channels[DEBOUNCE_CHANNELS_MAX];
+	unsigned int nr_channels;
+	void (*changed)(unsigned int channel, bool pressed,
+			uint32_t usec);
+	int (*get_level)(unsigned int channel);
+} m;
+
+static bool is_settling(const struct channel *ch, uint32_t now_usec)
+{
+	return ch->settling
+		&& now_usec - ch->changed_at < DEBOUNCE_LOCKOUT_USEC;
+}
+
+static void change(unsigned int n, bool pressed, uint32_t usec)
+{
+	struct channel *ch = &m.channels[n];
+
+	ch->pressed = pressed;
+	ch->changed_at = usec;
+	ch->settling = true;
+
+	m.changed(n, pressed, usec);
+}
+
+static bool pop(struct debounce_queue *q, struct debounce_edge *edge)
+{
+	uint32_t tail = q->tail;
+
+	if (tail == __atomic_load_n(&q->head, __ATOMIC_ACQUIRE)) {
+		return false;
+	}
+
+	*edge = q->edges[tail & (DEBOUNCE_QUEUE_LEN - 1)];
+	__atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+static void feed(const struct debounce_edge *edge)
+{
+	if (edge->channel >= m.nr_channels) {
+		return;
+	}
+
+	struct channel *ch = &m.channels[edge->channel];
+
+	if (is_settling(ch, edge->usec) || edge->pressed == ch->pressed) {
+		return;
+	}
+
+	change(edge->channel, edge->pressed, edge->usec);
+}
+
+static uint32_t settle(uint32_t now_usec)
+{
+	uint32_t next = 0;
+
+	for (unsigned int i = 0; i < m.nr_channels; i++) {
+		struct channel *ch = &m.channels[i];
+
+		if (!ch->settling) {
+			continue;
+		}
+
+		if (is_settling(ch, now_usec)) {
+			uint32_t left = DEBOUNCE_LOCKOUT_USEC
+				- (now_usec - ch->changed_at);
+			if (next == 0 || left < next) {
+				next = left;
+			}
+			continue;
+		}
+
+		ch->settling = false;
+
+		bool pressed = !!m.get_level(i);
+		if (pressed != ch->pressed) { /* the last edge got swallowed */
+			change(i, pressed, now_usec);
+			next = DEBOUNCE_LOCKOUT_USEC;
+		}
+	}
+
+	return next;
+}
+
+uint32_t debounce_process(struct debounce_queue *q, uint32_t now_usec)
+{
+	struct debounce_edge edge;
+
+	while (pop(q, &edge)) {
+		feed(&edge);
+	}
+
+	return settle(now_usec);
+}
+
+void debounce_init(unsigned int nr_channels,
+		void (*changed)(unsigned int channel, bool pressed,
+			uint32_t usec),
+		int (*get_level)(unsigned int channel))
+{
+	if (nr_channels > DEBOUNCE_CHANNELS_MAX) {
+		nr_channels = DEBOUNCE_CHANNELS_MAX;
+	}
+
+	m.nr_channels = nr_channels;
+	m.changed = changed;
+	m.get_level = get_level;
+
+	for (unsigned int i = 0; i < nr_channels; i++) {
+		m.channels[i] = (struct channel) {
+			.pressed = !!get_level(i),
+		};
+	}
+}
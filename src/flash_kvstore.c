@@ -0,0 +1,622 @@
+#include "flash_kvstore.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#if !defined(MIN)
+#define MIN(a, b)				(((a) > (b))? (b) : (a))
+#endif
+
+#if !defined(FLASH_KVSTORE_MAX_KEYS)
+#define FLASH_KVSTORE_MAX_KEYS			32
+#endif
+
+#define KEY_MAXLEN				15
+#define SECTOR_MAGIC				0x4b56534cu
+#define RECORD_MAGIC				0x4b52u
+#define ERASED_MAGIC				0xffffu
+#define RECORD_REMOVED				0x01u
+#define ALIGN					4u
+#define CHUNK_SIZE				32
+
+struct sector_header {
+	uint32_t magic;
+	uint32_t seq;
+};
+
+/* followed by the key and the value, padded to ALIGN. The CRC covers
+ * everything after the magic but itself. */
+struct record_header {
+	uint16_t magic;
+	uint8_t key_len;
+	uint8_t flags;
+	uint16_t value_len;
+	uint16_t padding;
+	uint32_t crc;
+};
+
+struct index_entry {
+	uint32_t hash;
+	uint32_t offset; /* of the record from the base */
+	uint16_t value_len;
+	uint8_t key_len;
+};
+
+struct flash_kvstore_s {
+	kvstore_t ops;
+	const dfu_io_t *io;
+	uintptr_t base;
+	uint32_t sector_size;
+	uint16_t nr_sectors;
+	uint16_t head; /* sector being appended */
+	uint16_t tail; /* the oldest sector in use */
+	uint32_t head_offset;
+	uint32_t seq; /* of the head sector */
+	pthread_mutex_t lock;
+	uint16_t nr_keys;
+	struct index_entry index[FLASH_KVSTORE_MAX_KEYS];
+};
+
+static uint32_t crc32(uint32_t crc, const void *data, size_t datasize)
+{
+	const uint8_t *p = (const uint8_t *)data;
+
+	crc = ~crc;
+	while (datasize--) {
+		crc ^= *p++;
+		for (int i = 0; i < 8; i++) {
+			crc = (crc >> 1) ^ (0xedb88320u & -(crc & 1u));
+		}
+	}
+
+	return ~crc;
+}
+
+static uint32_t hash_key(const char *key, size_t key_len)
+{
+	uint32_t hash = 2166136261u; /* FNV-1a */
+
+	for (size_t i = 0; i < key_len; i++) {
+		hash = (hash ^ (uint8_t)key[i]) * 16777619u;
+	}
+
+	return hash;
+}
+
+static uint32_t record_size(size_t key_len, size_t value_len)
+{
+	size_t len = sizeof(struct record_header) + key_len + value_len;
+	return (uint32_t)((len + ALIGN - 1) & ~(ALIGN - 1));
+}
+
+static uint32_t header_crc(const struct record_header *hdr)
+{
+	return crc32(0, &hdr->key_len,
+			offsetof(struct record_header, crc)
+			- offsetof(struct record_header, key_len));
+}
+
+static void *flash_addr(const struct flash_kvstore_s *p, uint32_t offset)
+{
+	return (void *)(p->base + offset);
+}
+
+static uint32_t sector_offset(const struct flash_kvstore_s *p, uint16_t sector)
+{
+	return (uint32_t)sector * p->sector_size;
+}
+
+static uint16_t next_sector(const struct flash_kvstore_s *p, uint16_t sector)
+{
+	return (uint16_t)((sector + 1u) % p->nr_sectors);
+}
+
+static unsigned int count_free_sectors(const struct flash_kvstore_s *p)
+{
+	unsigned int used = (unsigned int)(p->head + p->nr_sectors - p->tail)
+		% p->nr_sectors + 1;
+	return p->nr_sectors - used;
+}
+
+static bool read_flash(const struct flash_kvstore_s *p, void *buf,
+		uint32_t offset, size_t size)
+{
+	return p->io->read(buf, flash_addr(p, offset), size);
+}
+
+static bool write_flash(const struct flash_kvstore_s *p, uint32_t offset,
+		const void *data, size_t size)
+{
+	return size == 0 || p->io->write(flash_addr(p, offset), data, size);
+}
+
+static bool is_blank(const struct flash_kvstore_s *p,
+		uint32_t offset, size_t size)
+{
+	uint8_t buf[CHUNK_SIZE];
+
+	while (size > 0) {
+		size_t len = MIN(size, sizeof(buf));
+		if (!read_flash(p, buf, offset, len)) {
+			return false;
+		}
+		for (size_t i = 0; i < len; i++) {
+			if (buf[i] != 0xff) {
+				return false;
+			}
+		}
+		offset += (uint32_t)len;
+		size -= len;
+	}
+
+	return true;
+}
+
+static bool compare_flash(const struct flash_kvstore_s *p, uint32_t offset,
+		const void *data, size_t size)
+{
+	const uint8_t *src = (const uint8_t *)data;
+	uint8_t buf[CHUNK_SIZE];
+
+	while (size > 0) {
+		size_t len = MIN(size, sizeof(buf));
+		if (!read_flash(p, buf, offset, len) || memcmp(buf, src, len)) {
+			return false;
+		}
+		offset += (uint32_t)len;
+		src += len;
+		size -= len;
+	}
+
+	return true;
+}
+
+static struct index_entry *find_entry(struct flash_kvstore_s *p,
+		const char *key, size_t key_len)
+{
+	uint32_t hash = hash_key(key, key_len);
+
+	for (uint16_t i = 0; i < p->nr_keys; i++) {
+		struct index_entry *entry = &p->index[i];
+		if (entry->hash == hash && entry->key_len == key_len
+				&& compare_flash(p, entry->offset
+					+ (uint32_t)sizeof(struct record_header),
+					key, key_len)) {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+static bool update_index(struct flash_kvstore_s *p, const char *key,
+		size_t key_len, uint32_t offset, uint16_t value_len,
+		bool removed)
+{
+	struct index_entry *entry = find_entry(p, key, key_len);
+
+	if (removed) {
+		if (entry != NULL) {
+			*entry = p->index[--p->nr_keys];
+		}
+		return true;
+	}
+
+	if (entry == NULL) {
+		if (p->nr_keys >= FLASH_KVSTORE_MAX_KEYS) {
+			return false;
+		}
+		entry = &p->index[p->nr_keys++];
+	}
+
+	*entry = (struct index_entry) {
+		.hash = hash_key(key, key_len),
+		.offset = offset,
+		.value_len = value_len,
+		.key_len = (uint8_t)key_len,
+	};
+
+	return true;
+}
+
+static bool open_sector(struct flash_kvstore_s *p, uint16_t sector,
+		uint32_t seq)
+{
+	uint32_t offset = sector_offset(p, sector);
+	struct sector_header hdr = {
+		.magic = SECTOR_MAGIC,
+		.seq = seq,
+	};
+
+	if (!is_blank(p, offset, p->sector_size)
+			&& !p->io->erase(flash_addr(p, offset), p->sector_size)) {
+		return false;
+	}
+	if (!write_flash(p, offset, &hdr, sizeof(hdr))) {
+		return false;
+	}
+
+	p->head = sector;
+	p->head_offset = sizeof(hdr);
+	p->seq = seq;
+
+	return true;
+}
+
+static bool open_next_sector(struct flash_kvstore_s *p)
+{
+	if (count_free_sectors(p) == 0) {
+		return false;
+	}
+
+	return open_sector(p, next_sector(p, p->head), p->seq + 1);
+}
+
+static bool reserve(struct flash_kvstore_s *p, uint32_t len, uint32_t *offset)
+{
+	if (p->head_offset + len > p->sector_size) {
+		return false;
+	}
+
+	*offset = sector_offset(p, p->head) + p->head_offset;
+	p->head_offset += len;
+
+	return true;
+}
+
+/* scan_sector stops at a torn record, so nothing may follow one. The next
+ * write goes to a new sector */
+static void seal_head(struct flash_kvstore_s *p)
+{
+	p->head_offset = p->sector_size;
+}
+
+static bool relocate(struct flash_kvstore_s *p, struct index_entry *entry)
+{
+	uint32_t len = record_size(entry->key_len, entry->value_len);
+	uint32_t src = entry->offset + (uint32_t)sizeof(struct record_header);
+	size_t size = (size_t)entry->key_len + entry->value_len;
+	struct record_header hdr;
+	uint8_t buf[CHUNK_SIZE];
+	uint32_t offset;
+
+	if (p->head_offset + len > p->sector_size && !open_next_sector(p)) {
+		return false;
+	}
+	if (!read_flash(p, &hdr, entry->offset, sizeof(hdr))
+			|| !reserve(p, len, &offset)) {
+		return false;
+	}
+
+	for (uint32_t dst = offset + (uint32_t)sizeof(hdr); size > 0; ) {
+		size_t chunk = MIN(size, sizeof(buf));
+		if (!read_flash(p, buf, src, chunk)
+				|| !write_flash(p, dst, buf, chunk)) {
+			seal_head(p);
+			return false;
+		}
+		src += (uint32_t)chunk;
+		dst += (uint32_t)chunk;
+		size -= chunk;
+	}
+
+	if (!write_flash(p, offset, &hdr, sizeof(hdr))) {
+		seal_head(p);
+		return false;
+	}
+
+	entry->offset = offset;
+	return true;
+}
+
+/* moves the live records of the oldest sector to the head and erases it.
+ * Tombstones and overwritten records are left behind. */
+static bool collect(struct flash_kvstore_s *p)
+{
+	if (p->tail == p->head && !open_next_sector(p)) {
+		return false;
+	}
+
+	uint16_t victim = p->tail;
+	uint32_t start = sector_offset(p, victim);
+
+	for (uint16_t i = 0; i < p->nr_keys; i++) {
+		struct index_entry *entry = &p->index[i];
+		if (entry->offset >= start
+				&& entry->offset < start + p->sector_size
+				&& !relocate(p, entry)) {
+			return false;
+		}
+	}
+
+	if (!p->io->erase(flash_addr(p, start), p->sector_size)) {
+		return false;
+	}
+
+	p->tail = next_sector(p, victim);
+
+	return true;
+}
+
+static bool make_room(struct flash_kvstore_s *p, uint32_t len)
+{
+	unsigned int collected = 0;
+
+	while (p->head_offset + len > p->sector_size) {
+		if (count_free_sectors(p) > 1) { /* the last one is spare */
+			if (!open_next_sector(p)) {
+				return false;
+			}
+		} else if (collected++ >= p->nr_sectors || !collect(p)) {
+			return false; /* full of live records */
+		}
+	}
+
+	return true;
+}
+
+/* the body goes first and then the header so that a record with its header
+ * written is complete unless the CRC tells otherwise */
+static bool put(struct flash_kvstore_s *p, const char *key, size_t key_len,
+		const void *value, uint16_t value_len, bool removed)
+{
+	uint32_t len = record_size(key_len, value_len);
+	struct record_header hdr = {
+		.magic = RECORD_MAGIC,
+		.key_len = (uint8_t)key_len,
+		.flags = removed? RECORD_REMOVED : 0,
+		.value_len = value_len,
+		.padding = 0xffff,
+	};
+	uint32_t offset;
+
+	hdr.crc = crc32(crc32(header_crc(&hdr), key, key_len),
+			value, value_len);
+
+	if (!make_room(p, len) || !reserve(p, len, &offset)) {
+		return false;
+	}
+
+	uint32_t body = offset + (uint32_t)sizeof(hdr);
+
+	if (!write_flash(p, body, key, key_len)
+			|| !write_flash(p, body + (uint32_t)key_len,
+				value, value_len)
+			|| !write_flash(p, offset, &hdr, sizeof(hdr))) {
+		seal_head(p);
+		return false;
+	}
+
+	return update_index(p, key, key_len, offset, value_len, removed);
+}
+
+static bool is_record_valid(const struct flash_kvstore_s *p,
+		const struct record_header *hdr, uint32_t offset, char *key)
+{
+	uint32_t sector_end = (offset / p->sector_size + 1) * p->sector_size;
+	uint32_t crc = header_crc(hdr);
+	uint8_t buf[CHUNK_SIZE];
+
+	if (hdr->magic != RECORD_MAGIC || hdr->key_len == 0
+			|| hdr->key_len > KEY_MAXLEN
+			|| offset + record_size(hdr->key_len, hdr->value_len)
+				> sector_end) {
+		return false;
+	}
+
+	offset += (uint32_t)sizeof(*hdr);
+	if (!read_flash(p, key, offset, hdr->key_len)) {
+		return false;
+	}
+	key[hdr->key_len] = '\0';
+	crc = crc32(crc, key, hdr->key_len);
+	offset += hdr->key_len;
+
+	for (size_t size = hdr->value_len; size > 0; ) {
+		size_t len = MIN(size, sizeof(buf));
+		if (!read_flash(p, buf, offset, len)) {
+			return false;
+		}
+		crc = crc32(crc, buf, len);
+		offset += (uint32_t)len;
+		size -= len;
+	}
+
+	return crc == hdr->crc;
+}
+
+/* indexes the records of a sector returning where the free space starts.
+ * A torn record makes the rest of the sector unusable. */
+static uint32_t scan_sector(struct flash_kvstore_s *p, uint16_t sector)
+{
+	uint32_t start = sector_offset(p, sector);
+	uint32_t offset = sizeof(struct sector_header);
+	struct record_header hdr;
+	char key[KEY_MAXLEN + 1];
+
+	while (offset + sizeof(hdr) <= p->sector_size) {
+		if (!read_flash(p, &hdr, start + offset, sizeof(hdr))) {
+			return p->sector_size;
+		}
+		if (hdr.magic == ERASED_MAGIC) {
+			if (!is_blank(p, start + offset, p->sector_size - offset)) {
+				return p->sector_size;
+			}
+			break;
+		}
+		if (!is_record_valid(p, &hdr, start + offset, key)) {
+			return p->sector_size;
+		}
+
+		update_index(p, key, hdr.key_len, start + offset,
+				hdr.value_len, !!(hdr.flags & RECORD_REMOVED));
+		offset += record_size(hdr.key_len, hdr.value_len);
+	}
+
+	return offset;
+}
+
+static bool mount(struct flash_kvstore_s *p)
+{
+	struct sector_header hdr;
+	bool found = false;
+	uint32_t oldest = 0;
+
+	for (uint16_t i = 0; i < p->nr_sectors; i++) {
+		if (!read_flash(p, &hdr, sector_offset(p, i), sizeof(hdr))) {
+			return false;
+		}
+		if (hdr.magic != SECTOR_MAGIC) {
+			continue;
+		}
+		if (!found || hdr.seq < oldest) {
+			oldest = hdr.seq;
+			p->tail = i;
+		}
+		if (!found || hdr.seq > p->seq) {
+			p->seq = hdr.seq;
+			p->head = i;
+		}
+		found = true;
+	}
+
+	if (!found) {
+		p->tail = 0;
+		return open_sector(p, 0, 1);
+	}
+
+	/* oldest first for the newer records to win */
+	for (uint16_t i = p->tail; ; i = next_sector(p, i)) {
+		uint32_t end = scan_sector(p, i);
+		if (i == p->head) {
+			p->head_offset = end;
+			break;
+		}
+	}
+
+	return true;
+}
+
+static size_t write_internal(kvstore_t *self, const char *key,
+		const void *value, size_t size)
+{
+	struct flash_kvstore_s *p = (struct flash_kvstore_s *)self;
+	size_t key_len = strnlen(key, KEY_MAXLEN + 1);
+	size_t written = 0;
+
+	if (key_len == 0 || key_len > KEY_MAXLEN || size == 0
+			|| size > UINT16_MAX
+			|| record_size(key_len, size) > p->sector_size
+				- sizeof(struct sector_header)) {
+		return 0;
+	}
+
+	pthread_mutex_lock(&p->lock);
+	{
+		const struct index_entry *entry = find_entry(p, key, key_len);
+
+		if (entry != NULL && entry->value_len == size
+				&& compare_flash(p, entry->offset
+					+ (uint32_t)sizeof(struct record_header)
+					+ entry->key_len, value, size)) {
+			written = size; /* unchanged. spare the flash */
+		} else if (entry == NULL
+				&& p->nr_keys >= FLASH_KVSTORE_MAX_KEYS) {
+			/* no room in the index */
+		} else if (put(p, key, key_len, value, (uint16_t)size, false)) {
+			written = size;
+		}
+	}
+	pthread_mutex_unlock(&p->lock);
+
+	return written;
+}
+
+static size_t read_internal(const kvstore_t *self, const char *key,
+		void *buf, size_t bufsize)
+{
+	struct flash_kvstore_s *p = (struct flash_kvstore_s *)(uintptr_t)self;
+	size_t key_len = strnlen(key, KEY_MAXLEN + 1);
+	size_t len = 0;
+
+	pthread_mutex_lock(&p->lock);
+	{
+		const struct index_entry *entry = find_entry(p, key, key_len);
+
+		if (entry != NULL && entry->value_len <= bufsize
+				&& read_flash(p, buf, entry->offset
+					+ (uint32_t)sizeof(struct record_header)
+					+ entry->key_len, entry->value_len)) {
+			len = entry->value_len;
+		}
+	}
+	pthread_mutex_unlock(&p->lock);
+
+	return len;
+}
+
+bool flash_kvstore_remove(kvstore_t *kvstore, const char *key)
+{
+	struct flash_kvstore_s *p = (struct flash_kvstore_s *)kvstore;
+	size_t key_len = strnlen(key, KEY_MAXLEN + 1);
+	bool rc = true;
+
+	pthread_mutex_lock(&p->lock);
+	{
+		if (find_entry(p, key, key_len) != NULL) {
+			rc = put(p, key, key_len, NULL, 0, true);
+		}
+	}
+	pthread_mutex_unlock(&p->lock);
+
+	return rc;
+}
+
+size_t flash_kvstore_count(const kvstore_t *kvstore)
+{
+	const struct flash_kvstore_s *p = (const struct flash_kvstore_s *)kvstore;
+	return p->nr_keys;
+}
+
+kvstore_t *flash_kvstore_new(const dfu_io_t *io, uintptr_t base,
+		size_t sector_size, unsigned int nr_sectors)
+{
+	struct flash_kvstore_s *p;
+
+	if (io == NULL || nr_sectors < 2 || nr_sectors > UINT16_MAX
+			|| sector_size <= sizeof(struct sector_header)
+				+ record_size(KEY_MAXLEN, 0)) {
+		return NULL;
+	}
+
+	if ((p = (struct flash_kvstore_s *)calloc(1, sizeof(*p))) == NULL) {
+		return NULL;
+	}
+
+	p->io = io;
+	p->base = base;
+	p->sector_size = (uint32_t)sector_size;
+	p->nr_sectors = (uint16_t)nr_sectors;
+	p->ops = (kvstore_t) {
+		.write = write_internal,
+		.read = read_internal,
+	};
+
+	if (!mount(p)) {
+		free(p);
+		return NULL;
+	}
+
+	pthread_mutex_init(&p->lock, NULL);
+
+	return &p->ops;
+}
+
+void flash_kvstore_delete(kvstore_t *kvstore)
+{
+	struct flash_kvstore_s *p = (struct flash_kvstore_s *)kvstore;
+
+	pthread_mutex_destroy(&p->lock);
+	free(p);
+}
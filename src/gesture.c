@@ -0,0 +1,166 @@
+#include "gesture.h"
+
+#include <stddef.h>
+
+#if !defined(GESTURE_CLICK_GAP_MSEC)
+#define GESTURE_CLICK_GAP_MSEC			300
+#endif
+#if !defined(GESTURE_LONG_PRESS_MSEC)
+#define GESTURE_LONG_PRESS_MSEC			800
+#endif
+#if !defined(GESTURE_REPEAT_MSEC)
+#define GESTURE_REPEAT_MSEC			200
+#endif
+#if !defined(GESTURE_CHANNELS_MAX)
+#define GESTURE_CHANNELS_MAX			8
+#endif
+
+#define CLICKS_MAX				3
+
+typedef enum {
+	IDLE,
+	PRESSED,
+	HELD, /* long press recognized */
+	RELEASED, /* waiting for the next click */
+} state_t;
+
+struct channel {
+	uint32_t deadline;
+	uint8_t state;
+	uint8_t clicks;
+};
+
+static struct {
+	struct channel channels[GESTURE_CHANNELS_MAX];
+	unsigned int nr_channels;
+	uint32_t click_gap_usec;
+	uint32_t long_press_usec;
+	uint32_t repeat_usec;
+	void (*recognized)(unsigned int channel, gesture_t gesture);
+} m;
+
+static void press(unsigned int n, struct channel *ch, uint32_t usec)
+{
+	if (ch->state != RELEASED) {
+		ch->clicks = 0;
+	}
+
+	ch->state = PRESSED;
+	ch->deadline = usec + m.long_press_usec;
+
+	m.recognized(n, GESTURE_PRESS);
+}
+
+static void release(unsigned int n, struct channel *ch, uint32_t usec)
+{
+	if (ch->state != PRESSED) { /* the end of a long press */
+		ch->state = IDLE;
+		return;
+	}
+
+	if (++ch->clicks >= CLICKS_MAX) { /* no need to wait for more */
+		ch->state = IDLE;
+		m.recognized(n, GESTURE_TRIPLE_CLICK);
+		return;
+	}
+
+	ch->state = RELEASED;
+	ch->deadline = usec + m.click_gap_usec;
+}
+
+static void expire(unsigned int n, struct channel *ch)
+{
+	switch (ch->state) {
+	case PRESSED:
+		ch->state = HELD;
+		ch->deadline += m.repeat_usec;
+		m.recognized(n, GESTURE_LONG_PRESS);
+		break;
+	case HELD:
+		ch->deadline += m.repeat_usec;
+		m.recognized(n, GESTURE_HOLD_REPEAT);
+		break;
+	case RELEASED:
+		ch->state = IDLE;
+		m.recognized(n, ch->clicks == 1?
+				GESTURE_CLICK : GESTURE_DOUBLE_CLICK);
+		break;
+	default:
+		break;
+	}
+}
+
+void gesture_feed(unsigned int channel, bool pressed, uint32_t usec)
+{
+	if (channel >= m.nr_channels) {
+		return;
+	}
+
+	struct channel *ch = &m.channels[channel];
+
+	if (pressed) {
+		press(channel, ch, usec);
+	} else {
+		release(channel, ch, usec);
+	}
+}
+
+uint32_t gesture_poll(uint32_t now_usec)
+{
+	uint32_t next = 0;
+
+	for (unsigned int i = 0; i < m.nr_channels; i++) {
+		struct channel *ch = &m.channels[i];
+
+		if (ch->state == IDLE) {
+			continue;
+		}
+
+		int32_t left = (int32_t)(ch->deadline - now_usec);
+		if (left <= 0) {
+			expire(i, ch);
+			if (ch->state == IDLE) {
+				continue;
+			}
+			left = (int32_t)(ch->deadline - now_usec);
+			if (left <= 0) { /* polled late. keep the pace */
+				ch->deadline = now_usec + m.repeat_usec;
+				left = (int32_t)m.repeat_usec;
+			}
+		}
+
+		if (next == 0 || (uint32_t)left < next) {
+			next = (uint32_t)left;
+		}
+	}
+
+	return next;
+}
+
+void gesture_init(unsigned int nr_channels,
+		const struct gesture_timing *timing,
+		void (*recognized)(unsigned int channel, gesture_t gesture))
+{
+	const struct gesture_timing defaults = {
+		.click_gap_ms = GESTURE_CLICK_GAP_MSEC,
+		.long_press_ms = GESTURE_LONG_PRESS_MSEC,
+		.repeat_ms = GESTURE_REPEAT_MSEC,
+	};
+
+	if (timing == NULL) {
+		timing = &defaults;
+	}
+	if (nr_channels > GESTURE_CHANNELS_MAX) {
+		nr_channels = GESTURE_CHANNELS_MAX;
+	}
+
+	m.nr_channels = nr_channels;
+	m.recognized = recognized;
+	m.click_gap_usec = timing->click_gap_ms * 1000u;
+	m.long_press_usec = timing->long_press_ms * 1000u;
+	m.repeat_usec = timing->repeat_ms * 1000u;
+
+	for (unsigned int i = 0; i < nr_channels; i++) {
+		m.channels[i] = (struct channel) { .state = IDLE, };
+	}
+}
@@ -0,0 +1,134 @@
+#include "heartbeat.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define HEARTBEAT_VERSION			1
+
+struct writer {
+	uint8_t *buf;
+	size_t bufsize;
+	size_t len;
+	bool overflow;
+};
+
+static void put_u8(struct writer *w, uint8_t value)
+{
+	if (w->overflow || w->len >= w->bufsize) {
+		w->overflow = true;
+		return;
+	}
+
+	w->buf[w->len++] = value;
+}
+
+static void put_varint(struct writer *w, uint32_t value)
+{
+	do {
+		uint8_t byte = value & 0x7f;
+
+		if ((value >>= 7) != 0) {
+			byte |= 0x80;
+		}
+
+		put_u8(w, byte);
+	} while (value != 0);
+}
+
+static uint32_t zigzag(int32_t value)
+{
+	return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static void put_metrics(struct writer *w)
+{
+	int32_t values[HEARTBEAT_NR_METRICS];
+	unsigned int n = 0;
+	unsigned int prev = 0;
+
+	for (unsigned int i = 0; i < HEARTBEAT_NR_METRICS; i++) {
+		if ((values[i] = metrics_get((metric_key_t)i)) != 0) {
+			n++;
+		}
+	}
+
+	put_varint(w, n);
+
+	for (unsigned int i = 0; i < HEARTBEAT_NR_METRICS; i++) {
+		if (values[i] == 0) {
+			continue;
+		}
+
+		put_varint(w, i - prev);
+		put_varint(w, zigzag(values[i]));
+		prev = i;
+	}
+}
+
+static unsigned int count_nonzero(const uint16_t *counts)
+{
+	unsigned int n = 0;
+
+	for (unsigned int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		if (counts[i] != 0) {
+			n++;
+		}
+	}
+
+	return n;
+}
+
+static void put_histograms(struct writer *w)
+{
+	uint16_t counts[HISTOGRAM_MAX][HISTOGRAM_BUCKETS];
+	unsigned int n = 0;
+	unsigned int prev = 0;
+
+	for (unsigned int i = 0; i < HISTOGRAM_MAX; i++) {
+		histogram_get((histogram_key_t)i, counts[i]);
+		if (count_nonzero(counts[i]) != 0) {
+			n++;
+		}
+	}
+
+	put_varint(w, n);
+
+	for (unsigned int i = 0; i < HISTOGRAM_MAX; i++) {
+		unsigned int nr_buckets = count_nonzero(counts[i]);
+		unsigned int prev_bucket = 0;
+
+		if (nr_buckets == 0) {
+			continue;
+		}
+
+		put_varint(w, i - prev);
+		put_varint(w, nr_buckets);
+		prev = i;
+
+		for (unsigned int j = 0; j < HISTOGRAM_BUCKETS; j++) {
+			if (counts[i][j] == 0) {
+				continue;
+			}
+
+			put_varint(w, j - prev_bucket);
+			put_varint(w, counts[i][j]);
+			prev_bucket = j;
+		}
+	}
+}
+
+size_t heartbeat_encode(void *buf, size_t bufsize)
+{
+	struct writer w = {
+		.buf = (uint8_t *)buf,
+		.bufsize = bufsize,
+	};
+
+	put_u8(&w, 'H');
+	put_u8(&w, HEARTBEAT_VERSION);
+	put_metrics(&w);
+	put_histograms(&w);
+
+	return w.overflow? 0 : w.len;
+}
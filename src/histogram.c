@@ -0,0 +1,57 @@
+#include "histogram.h"
+
+#include <string.h>
+#include <pthread.h>
+
+static struct {
+	pthread_mutex_t lock;
+	uint16_t counts[HISTOGRAM_MAX][HISTOGRAM_BUCKETS];
+} m = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+unsigned int histogram_get_bucket(uint32_t value)
+{
+	unsigned int bucket = 0;
+
+	for (; value != 0 && bucket < HISTOGRAM_BUCKETS - 1; value >>= 1) {
+		bucket++;
+	}
+
+	return bucket;
+}
+
+void histogram_record(histogram_key_t key, uint32_t value)
+{
+	if ((unsigned int)key >= HISTOGRAM_MAX) {
+		return;
+	}
+
+	pthread_mutex_lock(&m.lock);
+	{
+		uint16_t *count = &m.counts[key][histogram_get_bucket(value)];
+
+		if (*count < UINT16_MAX) {
+			(*count)++;
+		}
+	}
+	pthread_mutex_unlock(&m.lock);
+}
+
+void histogram_get(histogram_key_t key, uint16_t counts[HISTOGRAM_BUCKETS])
+{
+	pthread_mutex_lock(&m.lock);
+	{
+		memcpy(counts, m.counts[key], sizeof(m.counts[key]));
+	}
+	pthread_mutex_unlock(&m.lock);
+}
+
+void histogram_reset(void)
+{
+	pthread_mutex_lock(&m.lock);
+	{
+		memset(m.counts, 0, sizeof(m.counts));
+	}
+	pthread_mutex_unlock(&m.lock);
+}
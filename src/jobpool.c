@@ -0,0 +1,358 @@
+#include "jobpool.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "libmcu/logging.h"
+#include "uptime.h"
+
+#if !defined(JOBPOOL_QUEUE_LEN)
+#define JOBPOOL_QUEUE_LEN			8 /* per lane */
+#endif
+#if !defined(JOBPOOL_HIGH_WORKERS)
+#define JOBPOOL_HIGH_WORKERS			1
+#endif
+#if !defined(JOBPOOL_NORMAL_WORKERS)
+#define JOBPOOL_NORMAL_WORKERS			1
+#endif
+#if !defined(JOBPOOL_LOW_WORKERS)
+#define JOBPOOL_LOW_WORKERS			1
+#endif
+#if !defined(JOBPOOL_BULK_WORKERS)
+#define JOBPOOL_BULK_WORKERS			1
+#endif
+#if !defined(JOBPOOL_STACK_SIZE)
+#define JOBPOOL_STACK_SIZE			4096
+#endif
+
+#define NR_WORKERS				(JOBPOOL_HIGH_WORKERS \
+		+ JOBPOOL_NORMAL_WORKERS + JOBPOOL_LOW_WORKERS \
+		+ JOBPOOL_BULK_WORKERS)
+
+struct job {
+	void (*run)(void *context);
+	void *context;
+	unsigned int deadline; /* uptime in ms */
+	unsigned int enqueued_at;
+	unsigned int seq; /* to keep the order among the same deadlines */
+	bool has_deadline;
+};
+
+struct lane {
+	struct job jobs[JOBPOOL_QUEUE_LEN];
+	unsigned int nr_jobs;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct lane lanes[JOBPOOL_PRIO_MAX];
+	struct jobpool_stats stats[JOBPOOL_STATS_MAX];
+	unsigned int max_depth[JOBPOOL_PRIO_MAX];
+	pthread_t workers[NR_WORKERS];
+	unsigned int nr_workers;
+	unsigned int seq;
+	bool running;
+} m = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+static unsigned int get_bucket(unsigned int ms)
+{
+	static const unsigned int bounds[JOBPOOL_HISTOGRAM_BUCKETS - 1] = {
+		10, 100, 1000,
+	};
+	unsigned int i;
+
+	for (i = 0; i < JOBPOOL_HISTOGRAM_BUCKETS - 1; i++) {
+		if (ms < bounds[i]) {
+			break;
+		}
+	}
+
+	return i;
+}
+
+/* a free entry is taken by the first job seen, the other one when full */
+static struct jobpool_stats *get_stats(void (*job)(void *context))
+{
+	for (int i = 0; i < JOBPOOL_STATS_JOBS; i++) {
+		struct jobpool_stats *stats = &m.stats[i];
+
+		if (stats->job == job) {
+			return stats;
+		}
+		if (stats->job == NULL) {
+			stats->job = job;
+			return stats;
+		}
+	}
+
+	return &m.stats[JOBPOOL_STATS_OTHER];
+}
+
+static void record_wait(struct jobpool_stats *stats, unsigned int ms)
+{
+	stats->wait[get_bucket(ms)]++;
+	if (ms > stats->max_wait_ms) {
+		stats->max_wait_ms = ms;
+	}
+}
+
+static void record_run(struct jobpool_stats *stats, unsigned int ms)
+{
+	stats->run[get_bucket(ms)]++;
+	if (ms > stats->max_run_ms) {
+		stats->max_run_ms = ms;
+	}
+}
+
+static bool is_expired(const struct job *job, unsigned int now)
+{
+	return job->has_deadline && (int)(now - job->deadline) > 0;
+}
+
+static bool is_earlier(const struct job *a, const struct job *b)
+{
+	if (a->has_deadline != b->has_deadline) {
+		return a->has_deadline;
+	}
+	if (a->has_deadline && a->deadline != b->deadline) {
+		return (int)(a->deadline - b->deadline) < 0;
+	}
+
+	return (int)(a->seq - b->seq) < 0;
+}
+
+static void remove_job(struct lane *lane, unsigned int index)
+{
+	lane->jobs[index] = lane->jobs[--lane->nr_jobs];
+}
+
+static void drop_expired(struct lane *lane, jobpool_prio_t prio,
+		unsigned int now)
+{
+	for (unsigned int i = lane->nr_jobs; i-- > 0; ) {
+		if (is_expired(&lane->jobs[i], now)) {
+			warn("a job of lane %d missed its deadline", prio);
+			get_stats(lane->jobs[i].run)->expired++;
+			remove_job(lane, i);
+		}
+	}
+}
+
+static bool take_job(jobpool_prio_t lowest, struct job *job,
+		jobpool_prio_t *taken_from)
+{
+	unsigned int now = uptime_get_ms();
+
+	for (int prio = JOBPOOL_PRIO_HIGH; prio <= (int)lowest; prio++) {
+		struct lane *lane = &m.lanes[prio];
+		unsigned int earliest = 0;
+
+		drop_expired(lane, (jobpool_prio_t)prio, now);
+
+		if (lane->nr_jobs == 0) {
+			continue;
+		}
+
+		for (unsigned int i = 1; i < lane->nr_jobs; i++) {
+			if (is_earlier(&lane->jobs[i], &lane->jobs[earliest])) {
+				earliest = i;
+			}
+		}
+
+		*job = lane->jobs[earliest];
+		*taken_from = (jobpool_prio_t)prio;
+		remove_job(lane, earliest);
+		record_wait(get_stats(job->run), now - job->enqueued_at);
+		return true;
+	}
+
+	return false;
+}
+
+static void *worker(void *arg)
+{
+	jobpool_prio_t lowest = (jobpool_prio_t)(uintptr_t)arg;
+	jobpool_prio_t prio;
+	struct job job;
+
+	pthread_mutex_lock(&m.lock);
+
+	while (m.running) {
+		if (!take_job(lowest, &job, &prio)) {
+			pthread_cond_wait(&m.cond, &m.lock);
+			continue;
+		}
+
+		pthread_mutex_unlock(&m.lock);
+		unsigned int started_at = uptime_get_ms();
+		job.run(job.context);
+		unsigned int elapsed = uptime_get_ms() - started_at;
+		pthread_mutex_lock(&m.lock);
+
+		record_run(get_stats(job.run), elapsed);
+	}
+
+	pthread_mutex_unlock(&m.lock);
+
+	return NULL;
+}
+
+bool jobpool_schedule_prio(jobpool_prio_t prio,
+		void (*job)(void *context), void *job_context,
+		unsigned int deadline_ms)
+{
+	bool rc = false;
+
+	if (job == NULL || prio < JOBPOOL_PRIO_HIGH
+			|| prio >= JOBPOOL_PRIO_MAX) {
+		return false;
+	}
+
+	pthread_mutex_lock(&m.lock);
+	{
+		struct lane *lane = &m.lanes[prio];
+		unsigned int now = uptime_get_ms();
+
+		if (lane->nr_jobs < JOBPOOL_QUEUE_LEN) {
+			lane->jobs[lane->nr_jobs++] = (struct job) {
+				.run = job,
+				.context = job_context,
+				.deadline = now + deadline_ms,
+				.enqueued_at = now,
+				.seq = m.seq++,
+				.has_deadline = deadline_ms != 0,
+			};
+			if (lane->nr_jobs > m.max_depth[prio]) {
+				m.max_depth[prio] = lane->nr_jobs;
+			}
+			/* every worker as only some of them serve the lane */
+			pthread_cond_broadcast(&m.cond);
+			rc = true;
+		} else {
+			get_stats(job)->rejected++;
+		}
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	return rc;
+}
+
+bool jobpool_schedule(void (*job)(void *context), void *job_context)
+{
+	return jobpool_schedule_prio(JOBPOOL_PRIO_NORMAL, job, job_context, 0);
+}
+
+unsigned int jobpool_count(void)
+{
+	unsigned int count = 0;
+
+	pthread_mutex_lock(&m.lock);
+	{
+		for (int i = 0; i < JOBPOOL_PRIO_MAX; i++) {
+			count += m.lanes[i].nr_jobs;
+		}
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	return count;
+}
+
+void jobpool_get_stats(struct jobpool_stats stats[JOBPOOL_STATS_MAX])
+{
+	pthread_mutex_lock(&m.lock);
+	{
+		memcpy(stats, m.stats, sizeof(m.stats));
+	}
+	pthread_mutex_unlock(&m.lock);
+}
+
+unsigned int jobpool_get_max_depth(jobpool_prio_t prio)
+{
+	unsigned int depth;
+
+	if (prio < JOBPOOL_PRIO_HIGH || prio >= JOBPOOL_PRIO_MAX) {
+		return 0;
+	}
+
+	pthread_mutex_lock(&m.lock);
+	{
+		depth = m.max_depth[prio];
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	return depth;
+}
+
+void jobpool_reset_stats(void)
+{
+	pthread_mutex_lock(&m.lock);
+	{
+		memset(m.stats, 0, sizeof(m.stats));
+		memset(m.max_depth, 0, sizeof(m.max_depth));
+	}
+	pthread_mutex_unlock(&m.lock);
+}
+
+void jobpool_deinit(void)
+{
+	pthread_mutex_lock(&m.lock);
+	{
+		m.running = false;
+		for (int i = 0; i < JOBPOOL_PRIO_MAX; i++) {
+			m.lanes[i].nr_jobs = 0;
+		}
+		pthread_cond_broadcast(&m.cond);
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	for (unsigned int i = 0; i < m.nr_workers; i++) {
+		pthread_join(m.workers[i], NULL);
+	}
+
+	m.nr_workers = 0;
+}
+
+bool jobpool_init(void)
+{
+	static const unsigned int nr_workers[JOBPOOL_PRIO_MAX] = {
+		[JOBPOOL_PRIO_HIGH] = JOBPOOL_HIGH_WORKERS,
+		[JOBPOOL_PRIO_NORMAL] = JOBPOOL_NORMAL_WORKERS,
+		[JOBPOOL_PRIO_LOW] = JOBPOOL_LOW_WORKERS,
+		[JOBPOOL_PRIO_BULK] = JOBPOOL_BULK_WORKERS,
+	};
+	pthread_attr_t attr;
+
+	if (m.running) {
+		return true;
+	}
+
+	m.running = true;
+
+	pthread_attr_init(&attr);
+	/* the default stays when too small for the host */
+	pthread_attr_setstacksize(&attr, JOBPOOL_STACK_SIZE);
+
+	for (int prio = JOBPOOL_PRIO_HIGH; prio < JOBPOOL_PRIO_MAX; prio++) {
+		for (unsigned int i = 0; i < nr_workers[prio]; i++) {
+			if (pthread_create(&m.workers[m.nr_workers], &attr,
+						worker, (void *)(uintptr_t)prio)) {
+				goto out_err;
+			}
+			m.nr_workers++;
+		}
+	}
+
+	pthread_attr_destroy(&attr);
+
+	return true;
+
+out_err:
+	pthread_attr_destroy(&attr);
+	jobpool_deinit();
+	return false;
+}
@@ -0,0 +1,85 @@
+#include "linkq.h"
+#include <string.h>
+
+/* weight of a new sample, 1/2^EWMA_SHIFT */
+#define EWMA_SHIFT			3
+/* fractional bits kept in the average */
+#define EWMA_FRAC_BITS			4
+
+static struct {
+	int32_t ewma;
+	int8_t window[LINKQ_WINDOW_SIZE];
+	unsigned int index;
+	unsigned int count;
+} m;
+
+static int8_t round_ewma(int32_t ewma)
+{
+	const int32_t unit = 1 << EWMA_FRAC_BITS;
+
+	if (ewma < 0) {
+		return (int8_t)-((-ewma + unit / 2) / unit);
+	}
+	return (int8_t)((ewma + unit / 2) / unit);
+}
+
+void linkq_update(int8_t rssi)
+{
+	int32_t sample = (int32_t)rssi * (1 << EWMA_FRAC_BITS);
+
+	if (m.count == 0) {
+		m.ewma = sample;
+	} else {
+		m.ewma += (sample - m.ewma) / (1 << EWMA_SHIFT);
+	}
+
+	m.window[m.index] = rssi;
+	m.index = (m.index + 1) % LINKQ_WINDOW_SIZE;
+	if (m.count < LINKQ_WINDOW_SIZE) {
+		m.count++;
+	}
+}
+
+int8_t linkq_get_rssi(void)
+{
+	if (m.count == 0) {
+		return 0;
+	}
+	return round_ewma(m.ewma);
+}
+
+int8_t linkq_get_rssi_min(void)
+{
+	int8_t min = 0;
+
+	for (unsigned int i = 0; i < m.count; i++) {
+		if (i == 0 || m.window[i] < min) {
+			min = m.window[i];
+		}
+	}
+
+	return min;
+}
+
+int8_t linkq_get_rssi_max(void)
+{
+	int8_t max = 0;
+
+	for (unsigned int i = 0; i < m.count; i++) {
+		if (i == 0 || m.window[i] > max) {
+			max = m.window[i];
+		}
+	}
+
+	return max;
+}
+
+unsigned int linkq_count(void)
+{
+	return m.count;
+}
+
+void linkq_reset(void)
+{
+	memset(&m, 0, sizeof(m));
+}
@@ -0,0 +1,451 @@
+#include "logbin.h"
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "uptime.h"
+
+#define LOGBIN_VERSION				1
+
+struct writer {
+	uint8_t *buf;
+	size_t bufsize;
+	size_t len;
+	bool overflow;
+};
+
+typedef enum {
+	LEN_DEFAULT,
+	LEN_CHAR,
+	LEN_SHORT,
+	LEN_LONG,
+	LEN_LONG_LONG,
+	LEN_INTMAX,
+	LEN_SIZE,
+	LEN_PTRDIFF,
+	LEN_LONG_DOUBLE,
+} length_t;
+
+static struct {
+	pthread_mutex_t lock;
+	uint8_t *buf;
+	size_t bufsize;
+	size_t head; /* the oldest record */
+	size_t used;
+	size_t count;
+	logging_t max_type;
+	logging_t min_type;
+} m = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.min_type = LOGGING_TYPE_VERBOSE,
+};
+
+static void put_bytes(struct writer *w, const void *data, size_t size)
+{
+	if (w->overflow || size > w->bufsize - w->len) {
+		w->overflow = true;
+		return;
+	}
+
+	memcpy(&w->buf[w->len], data, size);
+	w->len += size;
+}
+
+static void put_u8(struct writer *w, uint8_t value)
+{
+	put_bytes(w, &value, sizeof(value));
+}
+
+static void put_varint(struct writer *w, uint64_t value)
+{
+	do {
+		uint8_t byte = value & 0x7f;
+
+		if ((value >>= 7) != 0) {
+			byte |= 0x80;
+		}
+
+		put_u8(w, byte);
+	} while (value != 0);
+}
+
+static void put_signed(struct writer *w, int64_t value)
+{
+	put_varint(w, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static void put_double(struct writer *w, double value)
+{
+	uint64_t bits;
+	uint8_t bytes[sizeof(bits)];
+
+	memcpy(&bits, &value, sizeof(bits));
+	for (unsigned int i = 0; i < sizeof(bytes); i++) {
+		bytes[i] = (uint8_t)(bits >> (i * 8));
+	}
+
+	put_bytes(w, bytes, sizeof(bytes));
+}
+
+static void put_string(struct writer *w, const char *str, size_t maxlen)
+{
+	size_t len;
+
+	if (str == NULL) {
+		str = "(null)";
+	}
+	if (maxlen > LOGBIN_STRING_MAXLEN) {
+		maxlen = LOGBIN_STRING_MAXLEN;
+	}
+
+	len = strnlen(str, maxlen);
+	put_u8(w, (uint8_t)len);
+	put_bytes(w, str, len);
+}
+
+static const char *skip_digits(const char *p)
+{
+	while (*p >= '0' && *p <= '9') {
+		p++;
+	}
+	return p;
+}
+
+static const char *get_length(const char *p, length_t *length)
+{
+	switch (*p) {
+	case 'h':
+		*length = p[1] == 'h'? LEN_CHAR : LEN_SHORT;
+		return p[1] == 'h'? p + 2 : p + 1;
+	case 'l':
+		*length = p[1] == 'l'? LEN_LONG_LONG : LEN_LONG;
+		return p[1] == 'l'? p + 2 : p + 1;
+	case 'j':
+		*length = LEN_INTMAX;
+		return p + 1;
+	case 'z':
+		*length = LEN_SIZE;
+		return p + 1;
+	case 't':
+		*length = LEN_PTRDIFF;
+		return p + 1;
+	case 'L':
+		*length = LEN_LONG_DOUBLE;
+		return p + 1;
+	default:
+		*length = LEN_DEFAULT;
+		return p;
+	}
+}
+
+static int64_t get_signed(va_list *ap, length_t length)
+{
+	switch (length) {
+	case LEN_LONG:
+		return va_arg(*ap, long);
+	case LEN_LONG_LONG:
+		return va_arg(*ap, long long);
+	case LEN_INTMAX:
+		return va_arg(*ap, intmax_t);
+	case LEN_SIZE: /* fall through */
+	case LEN_PTRDIFF:
+		return va_arg(*ap, ptrdiff_t);
+	case LEN_DEFAULT: /* fall through */
+	case LEN_CHAR: /* char and short get promoted */
+	case LEN_SHORT:
+	case LEN_LONG_DOUBLE: /* not for integers */
+	default:
+		return va_arg(*ap, int);
+	}
+}
+
+static uint64_t get_unsigned(va_list *ap, length_t length)
+{
+	switch (length) {
+	case LEN_CHAR:
+		return (unsigned char)va_arg(*ap, unsigned int);
+	case LEN_SHORT:
+		return (unsigned short)va_arg(*ap, unsigned int);
+	case LEN_LONG:
+		return va_arg(*ap, unsigned long);
+	case LEN_LONG_LONG:
+		return va_arg(*ap, unsigned long long);
+	case LEN_INTMAX:
+		return va_arg(*ap, uintmax_t);
+	case LEN_SIZE: /* fall through */
+	case LEN_PTRDIFF:
+		return va_arg(*ap, size_t);
+	case LEN_DEFAULT: /* fall through */
+	case LEN_LONG_DOUBLE: /* not for integers */
+	default:
+		return va_arg(*ap, unsigned int);
+	}
+}
+
+/* puts one conversion returning the next of the format. It must read the
+ * format the same way tools/logdecode.py does */
+static const char *put_arg(struct writer *w, const char *p, va_list *ap)
+{
+	size_t precision = LOGBIN_STRING_MAXLEN;
+	length_t length;
+
+	p += strspn(p, "-+ #0");
+
+	if (*p == '*') {
+		put_signed(w, va_arg(*ap, int));
+		p++;
+	} else {
+		p = skip_digits(p);
+	}
+
+	if (*p == '.') {
+		p++;
+		if (*p == '*') {
+			int n = va_arg(*ap, int);
+			put_signed(w, n);
+			precision = n < 0? LOGBIN_STRING_MAXLEN : (size_t)n;
+			p++;
+		} else {
+			const char *digits = p;
+			p = skip_digits(p);
+			precision = 0;
+			for (; digits < p; digits++) {
+				if (precision < LOGBIN_STRING_MAXLEN) {
+					precision = precision * 10
+						+ (size_t)(*digits - '0');
+				}
+			}
+		}
+	}
+
+	p = get_length(p, &length);
+
+	switch (*p) {
+	case 'd': /* fall through */
+	case 'i':
+		put_signed(w, get_signed(ap, length));
+		break;
+	case 'u': /* fall through */
+	case 'o':
+	case 'x':
+	case 'X':
+		put_varint(w, get_unsigned(ap, length));
+		break;
+	case 'c':
+		put_varint(w, (unsigned char)va_arg(*ap, int));
+		break;
+	case 'p':
+		put_varint(w, (uintptr_t)va_arg(*ap, void *));
+		break;
+	case 's':
+		put_string(w, va_arg(*ap, const char *), precision);
+		break;
+	case 'e': /* fall through */
+	case 'E':
+	case 'f':
+	case 'F':
+	case 'g':
+	case 'G':
+	case 'a':
+	case 'A':
+		put_double(w, length == LEN_LONG_DOUBLE?
+				(double)va_arg(*ap, long double) :
+				va_arg(*ap, double));
+		break;
+	case 'n':
+		(void)va_arg(*ap, void *);
+		break;
+	case '\0':
+		return p;
+	default: /* '%' and the unknown */
+		break;
+	}
+
+	return p + 1;
+}
+
+static void encode(struct writer *w, logging_t type, const char *format,
+		va_list *ap)
+{
+	put_u8(w, 0); /* len filled in the end */
+	put_u8(w, (uint8_t)type);
+	put_varint(w, uptime_get_ms());
+	put_varint(w, (uintptr_t)format);
+
+	for (const char *p = format; (p = strchr(p, '%')) != NULL;) {
+		size_t committed = w->len;
+
+		p = put_arg(w, p + 1, ap);
+
+		if (w->overflow) {
+			w->len = committed;
+			w->overflow = false;
+			break;
+		}
+	}
+
+	w->buf[0] = (uint8_t)(w->len - 1);
+}
+
+static void copy_in(const uint8_t *data, size_t size)
+{
+	size_t tail = (m.head + m.used) % m.bufsize;
+	size_t n = size < m.bufsize - tail? size : m.bufsize - tail;
+
+	memcpy(&m.buf[tail], data, n);
+	memcpy(m.buf, &data[n], size - n);
+	m.used += size;
+	m.count++;
+}
+
+static void copy_out(uint8_t *buf, size_t size)
+{
+	size_t n = size < m.bufsize - m.head? size : m.bufsize - m.head;
+
+	if (buf != NULL) {
+		memcpy(buf, &m.buf[m.head], n);
+		memcpy(&buf[n], m.buf, size - n);
+	}
+
+	m.head = (m.head + size) % m.bufsize;
+	m.used -= size;
+	m.count--;
+}
+
+static size_t get_oldest_len(void)
+{
+	return (size_t)m.buf[m.head] + 1;
+}
+
+size_t logbin_save(logging_t type, const char *format, ...)
+{
+	uint8_t record[LOGBIN_RECORD_MAXLEN];
+	struct writer w = {
+		.buf = record,
+		.bufsize = sizeof(record),
+	};
+	va_list ap;
+
+	if (type < m.min_type) {
+		return 0;
+	}
+
+	va_start(ap, format);
+	encode(&w, type, format, &ap);
+	va_end(ap);
+
+	pthread_mutex_lock(&m.lock);
+	{
+		if (w.len > m.bufsize) {
+			w.len = 0;
+		} else {
+			while (m.bufsize - m.used < w.len) {
+				copy_out(NULL, get_oldest_len());
+			}
+
+			copy_in(record, w.len);
+
+			if (type > m.max_type) {
+				m.max_type = type;
+			}
+		}
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	return w.len;
+}
+
+size_t logbin_read(void *buf, size_t bufsize)
+{
+	struct writer w = {
+		.buf = (uint8_t *)buf,
+		.bufsize = bufsize,
+	};
+	size_t nr_records = 0;
+
+	put_u8(&w, 'L');
+	put_u8(&w, LOGBIN_VERSION);
+
+	if (w.overflow) {
+		return 0;
+	}
+
+	pthread_mutex_lock(&m.lock);
+	{
+		while (m.count > 0 && get_oldest_len() <= w.bufsize - w.len) {
+			size_t len = get_oldest_len();
+			copy_out(&w.buf[w.len], len);
+			w.len += len;
+			nr_records++;
+		}
+
+		if (m.count == 0) {
+			m.max_type = LOGGING_TYPE_VERBOSE;
+		}
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	return nr_records? w.len : 0;
+}
+
+size_t logbin_count(void)
+{
+	return m.count;
+}
+
+/* the timestamp follows the len and type of the oldest */
+static unsigned int get_oldest_timestamp(void)
+{
+	unsigned int timestamp = 0;
+
+	for (unsigned int i = 0, shift = 0; i < 5; i++, shift += 7) {
+		uint8_t byte = m.buf[(m.head + 2 + i) % m.bufsize];
+
+		timestamp |= (unsigned int)(byte & 0x7f) << shift;
+
+		if (!(byte & 0x80)) {
+			break;
+		}
+	}
+
+	return timestamp;
+}
+
+void logbin_get_status(struct logbin_status *status)
+{
+	pthread_mutex_lock(&m.lock);
+	{
+		status->count = m.count;
+		status->bytes = m.used;
+		status->oldest_ms = m.count? get_oldest_timestamp() : 0;
+		status->max_type = m.max_type;
+	}
+	pthread_mutex_unlock(&m.lock);
+}
+
+void logbin_set_level(logging_t min_type)
+{
+	m.min_type = min_type;
+}
+
+logging_t logbin_get_level(void)
+{
+	return m.min_type;
+}
+
+void logbin_init(void *buf, size_t bufsize)
+{
+	pthread_mutex_lock(&m.lock);
+	{
+		m.buf = (uint8_t *)buf;
+		m.bufsize = bufsize;
+		m.head = 0;
+		m.used = 0;
+		m.count = 0;
+		m.max_type = LOGGING_TYPE_VERBOSE;
+	}
+	pthread_mutex_unlock(&m.lock);
+}
@@ -0,0 +1,113 @@
+#include "logship.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "lz.h"
+
+#define LOGSHIP_VERSION				1
+#define HEADER_MAXLEN				(2 + 3) /* 'Z' version len */
+
+#if LOGSHIP_BATCH_MAXLEN < LOGBIN_BATCH_MINLEN
+#error "LOGSHIP_BATCH_MAXLEN must take any record"
+#endif
+
+static struct {
+	pthread_mutex_t lock;
+	bool (*send)(const void *data, size_t datasize);
+	uint8_t batch[LOGSHIP_BATCH_MAXLEN];
+	uint8_t outgoing[HEADER_MAXLEN + LOGSHIP_BATCH_MAXLEN];
+	size_t outgoing_len; /* not sent yet when nonzero */
+} m = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static size_t put_varint(uint8_t *buf, uint32_t value)
+{
+	size_t len = 0;
+
+	do {
+		uint8_t byte = value & 0x7f;
+
+		if ((value >>= 7) != 0) {
+			byte |= 0x80;
+		}
+
+		buf[len++] = byte;
+	} while (value != 0);
+
+	return len;
+}
+
+static bool is_time_to_flush(unsigned int now_ms)
+{
+	struct logbin_status status;
+
+	logbin_get_status(&status);
+
+	if (status.count == 0) {
+		return false;
+	}
+
+	return status.bytes >= LOGSHIP_FLUSH_BYTES
+		|| status.max_type >= LOGSHIP_FLUSH_TYPE
+		|| now_ms - status.oldest_ms >= LOGSHIP_FLUSH_AGE_MSEC;
+}
+
+/* the batch as it is when compression doesn't pay */
+static size_t pack(void)
+{
+	size_t len = logbin_read(m.batch, sizeof(m.batch));
+	size_t header_len;
+	size_t compressed;
+
+	if (len == 0) {
+		return 0;
+	}
+
+	m.outgoing[0] = 'Z';
+	m.outgoing[1] = LOGSHIP_VERSION;
+	header_len = 2 + put_varint(&m.outgoing[2], (uint32_t)len);
+
+	compressed = lz_compress(m.batch, len, &m.outgoing[header_len],
+			len - header_len);
+
+	if (compressed == 0) {
+		memcpy(m.outgoing, m.batch, len);
+		return len;
+	}
+
+	return header_len + compressed;
+}
+
+bool logship_poll(unsigned int now_ms)
+{
+	bool sent = false;
+
+	pthread_mutex_lock(&m.lock);
+	{
+		if (m.outgoing_len == 0 && is_time_to_flush(now_ms)) {
+			m.outgoing_len = pack();
+		}
+
+		if (m.outgoing_len != 0
+				&& m.send(m.outgoing, m.outgoing_len)) {
+			m.outgoing_len = 0;
+			sent = true;
+		}
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	return sent;
+}
+
+void logship_init(bool (*send)(const void *data, size_t datasize))
+{
+	pthread_mutex_lock(&m.lock);
+	{
+		m.send = send;
+		m.outgoing_len = 0;
+	}
+	pthread_mutex_unlock(&m.lock);
+}
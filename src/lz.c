@@ -0,0 +1,153 @@
+#include "lz.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if !defined(LZ_HASH_BITS)
+#define LZ_HASH_BITS				8
+#endif
+
+#define LZ_WINDOW				4096
+#define LZ_MIN_MATCH				3
+#define LZ_MAX_MATCH				(LZ_MIN_MATCH + 15)
+
+static unsigned int hash(const uint8_t *p)
+{
+	uint32_t v = (uint32_t)p[0] << 16 | (uint32_t)p[1] << 8 | p[2];
+	return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* the table keeps the last position + 1 of each hash, 0 for none */
+static size_t find_match(const uint8_t *in, size_t pos, size_t len,
+		uint16_t *table, size_t *distance)
+{
+	size_t max = len - pos < LZ_MAX_MATCH? len - pos : LZ_MAX_MATCH;
+	size_t matched = 0;
+
+	if (max < LZ_MIN_MATCH) {
+		return 0;
+	}
+
+	unsigned int h = hash(&in[pos]);
+	size_t candidate = table[h];
+	table[h] = (uint16_t)(pos + 1);
+
+	if (candidate-- == 0 || pos - candidate > LZ_WINDOW) {
+		return 0;
+	}
+
+	while (matched < max && in[candidate + matched] == in[pos + matched]) {
+		matched++;
+	}
+
+	*distance = pos - candidate;
+	return matched;
+}
+
+size_t lz_compress(const void *src, size_t srclen, void *dst, size_t dstsize)
+{
+	const uint8_t *in = (const uint8_t *)src;
+	uint8_t *out = (uint8_t *)dst;
+	uint16_t table[1u << LZ_HASH_BITS];
+	size_t ipos = 0;
+	size_t opos = 0;
+	size_t flags = 0;
+	unsigned int bit = 8;
+
+	if (srclen > LZ_SRC_MAXLEN) {
+		return 0;
+	}
+
+	memset(table, 0, sizeof(table));
+
+	while (ipos < srclen) {
+		size_t distance = 0;
+		size_t len;
+
+		if (bit == 8) {
+			if (opos >= dstsize) {
+				return 0;
+			}
+			flags = opos++;
+			out[flags] = 0;
+			bit = 0;
+		}
+
+		len = find_match(in, ipos, srclen, table, &distance);
+
+		if (len >= LZ_MIN_MATCH) {
+			if (dstsize - opos < 2) {
+				return 0;
+			}
+
+			out[opos++] = (uint8_t)(distance - 1);
+			out[opos++] = (uint8_t)(((distance - 1) >> 8) << 4
+					| (len - LZ_MIN_MATCH));
+			out[flags] |= (uint8_t)(1u << bit);
+
+			/* the ones skipped are still good to match later */
+			for (size_t i = 1; i < len
+					&& ipos + i + LZ_MIN_MATCH <= srclen;
+					i++) {
+				table[hash(&in[ipos + i])] =
+					(uint16_t)(ipos + i + 1);
+			}
+
+			ipos += len;
+		} else {
+			if (opos >= dstsize) {
+				return 0;
+			}
+
+			out[opos++] = in[ipos++];
+		}
+
+		bit++;
+	}
+
+	return opos;
+}
+
+size_t lz_decompress(const void *src, size_t srclen,
+		void *dst, size_t dstsize)
+{
+	const uint8_t *in = (const uint8_t *)src;
+	uint8_t *out = (uint8_t *)dst;
+	size_t ipos = 0;
+	size_t opos = 0;
+
+	while (ipos < srclen) {
+		uint8_t flags = in[ipos++];
+
+		for (unsigned int bit = 0; bit < 8 && ipos < srclen; bit++) {
+			if (!(flags & (1u << bit))) {
+				if (opos >= dstsize) {
+					return 0;
+				}
+				out[opos++] = in[ipos++];
+				continue;
+			}
+
+			if (srclen - ipos < 2) {
+				return 0;
+			}
+
+			size_t distance = ((size_t)in[ipos]
+					| (size_t)(in[ipos + 1] >> 4) << 8) + 1;
+			size_t len = (size_t)(in[ipos + 1] & 0xf)
+				+ LZ_MIN_MATCH;
+			ipos += 2;
+
+			if (distance > opos || len > dstsize - opos) {
+				return 0;
+			}
+
+			/* overlapping on purpose for runs */
+			for (size_t i = 0; i < len; i++, opos++) {
+				out[opos] = out[opos - distance];
+			}
+		}
+	}
+
+	return opos;
+}
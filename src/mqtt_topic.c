@@ -0,0 +1,42 @@
+#include "mqtt.h"
+
+static void get_next_topic_word(const char **s)
+{
+	while (**s != '/' && **s != '\0') {
+		(*s)++;
+	}
+}
+
+bool mqtt_is_topic_matched(const char *filter, const char *topic)
+{
+	if (filter == NULL || topic == NULL) {
+		return false;
+	}
+
+	while (*filter != '\0' && *topic != '\0') {
+		if (*filter == '#') {
+			return true;
+		}
+		if (*filter == '+') {
+			get_next_topic_word(&filter);
+			get_next_topic_word(&topic);
+			continue;
+		}
+
+		if (*filter != *topic) {
+			return false;
+		}
+
+		filter++;
+		topic++;
+	}
+
+	if (*filter != '\0') {
+		return false;
+	}
+	if (*topic == '\0') {
+		return true;
+	}
+
+	return false;
+}
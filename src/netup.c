@@ -0,0 +1,133 @@
+#include "netup.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "libmcu/logging.h"
+#include "libmcu/compiler.h"
+
+#include "jobpool.h"
+#include "wifi.h"
+
+/* an association not getting an IP in this long moves on to the next */
+#if !defined(NETUP_CONNECT_TIMEOUT_MSEC)
+#define NETUP_CONNECT_TIMEOUT_MSEC		15000
+#endif
+
+static struct {
+	pthread_mutex_t lock;
+	netup_cb_t done;
+	void *context;
+	uint8_t next; /* the saved network to try next */
+	bool busy;
+} m = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static void finish(bool connected)
+{
+	netup_cb_t done;
+	void *context;
+
+	pthread_mutex_lock(&m.lock);
+	{
+		done = m.done;
+		context = m.context;
+		m.busy = false;
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	done(connected, context);
+}
+
+static void try_next(void *context);
+
+static void connected(wifiman_error_t rc, void *context)
+{
+	if (rc == WIFIMAN_SUCCESS) {
+		finish(true);
+		return;
+	}
+
+	/* the event context must not block on the next association */
+	if (!jobpool_schedule_prio(JOBPOOL_PRIO_LOW, try_next, NULL, 0)) {
+		finish(false);
+	}
+
+	unused(context);
+}
+
+/* hidden networks don't show up in a scan */
+static void try_next(void LIBMCU_UNUSED *context)
+{
+	for (uint8_t i = m.next; i < WIFIMAN_MAX_NETWORK_PROFILES; i++) {
+		uint8_t buf[sizeof(wifiman_network_profile_t)
+			+ WIFIMAN_PASS_MAXLEN] = { 0, };
+		wifiman_network_profile_t *profile = (void *)buf;
+
+		if (!wifiman_get_network(profile, i)) {
+			continue;
+		}
+
+		info("connecting to %s", profile->ssid);
+
+		/* before connecting as the completion may come first */
+		m.next = (uint8_t)(i + 1);
+
+		if (wifiman_connect_async(profile, connected, NULL,
+					NETUP_CONNECT_TIMEOUT_MSEC)
+				== WIFIMAN_SUCCESS) {
+			return;
+		}
+	}
+
+	finish(false);
+}
+
+static void try_known(void *context)
+{
+	if (wifiman_connect_last() == WIFIMAN_SUCCESS
+			|| wifiman_connect_best() == WIFIMAN_SUCCESS) {
+		finish(true);
+		return;
+	}
+
+	try_next(context);
+}
+
+bool netup_start(netup_cb_t done, void *context)
+{
+	if (done == NULL) {
+		return false;
+	}
+
+	bool idle;
+
+	pthread_mutex_lock(&m.lock);
+	{
+		idle = !m.busy;
+		if (idle) {
+			m.busy = true;
+			m.done = done;
+			m.context = context;
+			m.next = 0;
+		}
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	if (!idle) {
+		return false;
+	}
+
+	if (!jobpool_schedule_prio(JOBPOOL_PRIO_LOW, try_known, NULL, 0)) {
+		pthread_mutex_lock(&m.lock);
+		{
+			m.busy = false;
+		}
+		pthread_mutex_unlock(&m.lock);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,147 @@
+#include "profile.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+
+#define PROFILE_VERSION				1
+
+struct writer {
+	uint8_t *buf;
+	size_t bufsize;
+	size_t len;
+	bool overflow;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	struct profile_sample sample;
+	struct {
+		uint32_t id;
+		uint32_t runtime;
+	} prev[PROFILE_TASKS_MAX];
+	unsigned int nr_prev;
+	uint32_t prev_total;
+} m = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static void put_bytes(struct writer *w, const void *data, size_t size)
+{
+	if (w->overflow || size > w->bufsize - w->len) {
+		w->overflow = true;
+		return;
+	}
+
+	memcpy(&w->buf[w->len], data, size);
+	w->len += size;
+}
+
+static void put_u8(struct writer *w, uint8_t value)
+{
+	put_bytes(w, &value, sizeof(value));
+}
+
+static void put_varint(struct writer *w, uint32_t value)
+{
+	do {
+		uint8_t byte = value & 0x7f;
+
+		if ((value >>= 7) != 0) {
+			byte |= 0x80;
+		}
+
+		put_u8(w, byte);
+	} while (value != 0);
+}
+
+static uint32_t get_prev_runtime(uint32_t id)
+{
+	for (unsigned int i = 0; i < m.nr_prev; i++) {
+		if (m.prev[i].id == id) {
+			return m.prev[i].runtime;
+		}
+	}
+
+	return 0; /* a new task */
+}
+
+static uint32_t get_cpu_permille(const struct profile_task *task,
+		uint32_t elapsed)
+{
+	uint32_t ran = task->runtime - get_prev_runtime(task->id);
+
+	if (elapsed == 0) {
+		return 0;
+	}
+
+	return (uint32_t)((uint64_t)ran * 1000 / elapsed);
+}
+
+static void keep_runtimes(const struct profile_sample *sample)
+{
+	for (unsigned int i = 0; i < sample->nr_tasks; i++) {
+		m.prev[i].id = sample->tasks[i].id;
+		m.prev[i].runtime = sample->tasks[i].runtime;
+	}
+
+	m.nr_prev = sample->nr_tasks;
+	m.prev_total = sample->total_runtime;
+}
+
+void profile_init(void)
+{
+	pthread_mutex_lock(&m.lock);
+	{
+		m.nr_prev = 0;
+		m.prev_total = 0;
+	}
+	pthread_mutex_unlock(&m.lock);
+}
+
+size_t profile_encode(void *buf, size_t bufsize)
+{
+	struct writer w = {
+		.buf = (uint8_t *)buf,
+		.bufsize = bufsize,
+	};
+	struct profile_sample *sample = &m.sample;
+
+	pthread_mutex_lock(&m.lock);
+	{
+		memset(sample, 0, sizeof(*sample));
+		profile_hw_sample(sample);
+
+		if (sample->nr_tasks > PROFILE_TASKS_MAX) {
+			sample->nr_tasks = PROFILE_TASKS_MAX;
+		}
+
+		uint32_t elapsed = sample->total_runtime - m.prev_total;
+
+		put_u8(&w, 'P');
+		put_u8(&w, PROFILE_VERSION);
+		put_varint(&w, sample->free_heap);
+		put_varint(&w, sample->min_free_heap);
+		put_u8(&w, (uint8_t)sample->nr_tasks);
+
+		for (unsigned int i = 0; i < sample->nr_tasks; i++) {
+			const struct profile_task *task = &sample->tasks[i];
+			size_t name_len = strnlen(task->name,
+					PROFILE_TASK_NAME_MAXLEN);
+
+			put_u8(&w, (uint8_t)name_len);
+			put_bytes(&w, task->name, name_len);
+			put_u8(&w, task->prio);
+			put_varint(&w, get_cpu_permille(task, elapsed));
+			put_varint(&w, task->stack_free);
+		}
+
+		/* not to lose the interval to a short buffer */
+		if (!w.overflow) {
+			keep_runtimes(sample);
+		}
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	return w.overflow? 0 : w.len;
+}
@@ -1,6 +1,5 @@
 #include "reporter.h"
 
-#include <assert.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -9,10 +8,16 @@
 #include "libmcu/retry.h"
 #include "libmcu/compiler.h"
 
-#include "sleep.h"
 #include "jobpool.h"
+#include "apptimer.h"
 #include "ota/ota.h"
 #include "topic.h"
+#include "roaming.h"
+#include "netup.h"
+#include "profile.h"
+#include "histogram.h"
+#include "logbin.h"
+#include "uptime.h"
 
 #include "wifi.h"
 #include "mqtt.h"
@@ -20,6 +25,7 @@
 #define MAX(a, b)				((a) < (b)? (b) : (a))
 
 #define DEFAULT_MQTT_BROKER_ENDPOINT		""
+#define PROFILE_BUFSIZE				384
 
 #if !defined(DEFAULT_HOSTNAME)
 #define DEFAULT_HOSTNAME			"smartswitch"
@@ -34,48 +40,72 @@ const char *TOPICS[TOPIC_MAX];
 static struct {
 	volatile bool reconnecting;
 	mqtt_t *mqtt;
+	retry_t retry;
+	apptimer_t reconnect_timer;
+	unsigned int disconnected_at; /* uptime in ms */
+	const char *client_id;
+	volatile bool session_opened;
 } m;
 
-static bool connect_to_network(void)
-{
-	uint8_t n = WIFIMAN_MAX_NETWORK_PROFILES;
-
-	for (uint8_t i = 0; i < n; i++) {
-		uint8_t buf[sizeof(wifiman_network_profile_t)
-			+ WIFIMAN_PASS_MAXLEN] = { 0, };
-		wifiman_network_profile_t *profile = (void *)buf;
-
-		if (!wifiman_get_network(profile, i)) {
-			continue;
-		}
+static void network_up(bool connected, void *context);
 
-		info("connecting to %s", profile->ssid);
-
-		if (wifiman_connect(profile) == WIFIMAN_SUCCESS) {
-			return true;
-		}
+static void request_reconnect(void LIBMCU_UNUSED *context)
+{
+	/* netup connects in the background, not in the timer context */
+	if (!netup_start(network_up, NULL)) {
+		apptimer_start(&m.reconnect_timer, m.retry.min_backoff_ms,
+				request_reconnect, NULL);
 	}
+}
 
-	return false;
+/* retry_backoff() calls it in place of sleeping so that no worker is held
+ * during the backoff */
+static void reconnect_later(unsigned int msec)
+{
+	apptimer_start(&m.reconnect_timer, msec, request_reconnect, NULL);
 }
 
-static void wifi_reconnect(void LIBMCU_UNUSED *context)
+static void start_reconnecting(void)
 {
-	retry_t retry = {
+	m.reconnecting = true;
+	m.disconnected_at = uptime_get_ms();
+	m.retry = (retry_t) {
 		.max_attempts = 10,
 		.max_backoff_ms = 3600000,
 		.min_backoff_ms = 5000,
 		.max_jitter_ms = 5000,
-		.sleep = sleep_ms,
+		.sleep = reconnect_later,
 	};
-	do {
-		if (connect_to_network()) {
-			m.reconnecting = false;
-			return;
+	request_reconnect(NULL);
+}
+
+static void open_session(void *context);
+
+static void network_up(bool connected, void LIBMCU_UNUSED *context)
+{
+	if (!connected) {
+		if (retry_backoff(&m.retry) == RETRY_EXHAUSTED) {
+			error("gave up reconnecting");
+			// TODO: wifi_reset();
 		}
-	} while (retry_backoff(&retry) != RETRY_EXHAUSTED);
+		return;
+	}
 
-	// TODO: wifi_reset();
+	m.reconnecting = false;
+
+	if (m.session_opened) {
+		histogram_record(WifiReconnectTime,
+				uptime_get_ms() - m.disconnected_at);
+		return;
+	}
+
+	/* the broker session is opened once, on the first link up. The mqtt
+	 * client takes care of it on the later reconnections */
+	m.session_opened = true;
+	if (!jobpool_schedule(open_session, m.mqtt)) {
+		m.session_opened = false;
+		error("session not opened");
+	}
 }
 
 static void wifi_state_change_event(wifiman_event_t event,
@@ -86,9 +116,7 @@ static void wifi_state_change_event(wifiman_event_t event,
 			"connected" : "disconnected");
 	if (event == WIFIMAN_EVENT_DISCONNECTED
 			&& m.reconnecting == false) {
-		m.reconnecting = true;
-		bool scheduled = jobpool_schedule(wifi_reconnect, NULL);
-		assert(scheduled == true);
+		start_reconnecting();
 		info("Try to reconnect");
 	}
 }
@@ -112,9 +140,6 @@ static bool network_interface_init(void)
 				wifi_state_change_event) != WIFIMAN_SUCCESS) {
 		goto out_err_wifi_station;
 	}
-	if (!connect_to_network()) {
-		goto out_err_wifi_station;
-	}
 
 	return true;
 
@@ -157,9 +182,11 @@ static const char *get_topic_path_allocated(bool subscribe,
 	return topic;
 }
 
-static bool open_mqtt_connection(const char *client_id)
+static bool create_mqtt_client(void)
 {
-	m.mqtt = mqtt_new();
+	if ((m.mqtt = mqtt_new()) == NULL) {
+		return false;
+	}
 
 	if (mqtt_set_lwt(m.mqtt, &(mqtt_message_t) {
 				.qos = MQTT_QOS_1,
@@ -169,6 +196,12 @@ static bool open_mqtt_connection(const char *client_id)
 			!= MQTT_SUCCESS) {
 		return false;
 	}
+
+	return true;
+}
+
+static bool open_mqtt_connection(const char *client_id)
+{
 	if (mqtt_connect(m.mqtt, &(mqtt_connect_t) {
 				.credential = {
 					.ca_cert = x509_ca_cert,
@@ -185,11 +218,38 @@ static bool open_mqtt_connection(const char *client_id)
 	return true;
 }
 
-static void message_received(void * const context,
+/* the least level to log by name like "info", from "verbose" to "alert" */
+static void logging_received(void * const context,
 		const mqtt_message_t * const msg)
 {
-	debug("App received message %.*s", msg->payload_size, msg->payload);
 	unused(context);
+
+#if defined(LOGGING_BINARY)
+	static const char *levels[LOGGING_TYPE_MAX] = {
+		[LOGGING_TYPE_VERBOSE] = "verbose",
+		[LOGGING_TYPE_DEBUG] = "debug",
+		[LOGGING_TYPE_INFO] = "info",
+		[LOGGING_TYPE_NOTICE] = "notice",
+		[LOGGING_TYPE_WARN] = "warn",
+		[LOGGING_TYPE_ERROR] = "error",
+		[LOGGING_TYPE_ALERT] = "alert",
+	};
+
+	for (int i = 0; i < LOGGING_TYPE_MAX; i++) {
+		if (strlen(levels[i]) == msg->payload_size
+				&& memcmp(levels[i], msg->payload,
+					msg->payload_size) == 0) {
+			logbin_set_level((logging_t)i);
+			notice("log level set to %s", levels[i]);
+			return;
+		}
+	}
+
+	warn("unknown log level %.*s", (int)msg->payload_size, msg->payload);
+#else /* the level applies to the binary logs only */
+	warn("log level %.*s ignored in text logging",
+			(int)msg->payload_size, msg->payload);
+#endif
 }
 
 static void version_received(void * const context,
@@ -200,6 +260,7 @@ static void version_received(void * const context,
 
 // TODO: Remove dependency
 #include "switch.h"
+#include "rules.h"
 static void room_received(void * const context,
 		const mqtt_message_t * const msg)
 {
@@ -207,16 +268,75 @@ static void room_received(void * const context,
 	debug("room message %.*s", msg->payload_size, msg->payload);
 	unused(context);
 
-	switch (msg->payload[0]) {
-	case '1':
-		switch_set(1, true);
-		break;
-	case '0':
-		switch_set(1, false);
-		break;
-	default:
-		break;
+	if (rules_trigger(RULE_TRIGGER_TOPIC, TOPIC_SUB_ROOM, 0,
+				msg->payload, msg->payload_size) > 0) {
+		return;
 	}
+
+	/* a character per channel from channel 1. Anything other than '0'
+	 * and '1' leaves the channel as it is */
+	uint32_t mask = 0;
+	uint32_t states = 0;
+
+	for (size_t i = 0; i < msg->payload_size && i < 32; i++) {
+		switch (msg->payload[i]) {
+		case '1':
+			states |= 1u << i;
+			/* fall through */
+		case '0':
+			mask |= 1u << i;
+			break;
+		default:
+			break;
+		}
+	}
+
+	switch_set_mask(mask, states);
+}
+
+static void rules_received(void * const context,
+		const mqtt_message_t * const msg)
+{
+	if (!rules_update(msg->payload, msg->payload_size)) {
+		error("rule table rejected");
+	}
+
+	unused(context);
+}
+
+static void send_profile(void LIBMCU_UNUSED *context)
+{
+	uint8_t buf[PROFILE_BUFSIZE];
+	size_t len = profile_encode(buf, sizeof(buf));
+
+	if (len == 0 || !reporter_send(REPORT_PROFILE, buf, len)) {
+		error("profile not sent");
+	}
+}
+
+/* any message is a request. Sampling goes to the jobpool not to hold the
+ * mqtt task */
+static void profile_received(void * const context,
+		const mqtt_message_t * const msg)
+{
+	if (!jobpool_schedule(send_profile, NULL)) {
+		error("profile request dropped");
+	}
+
+	unused(context);
+	unused(msg);
+}
+
+/* a round trip right after the handover recovers the session at once
+ * instead of on the next keepalive. The will topic is left for the broker
+ * to tell the device is gone */
+static void refresh_session(void *context)
+{
+	mqtt_publish((mqtt_t *)context, &(mqtt_message_t) {
+			.qos = MQTT_QOS_1,
+			.topic = TOPICS[TOPIC_PUB_ROAMED],
+			.payload = (const uint8_t *)"roamed",
+			.payload_size = 6, });
 }
 
 static bool subscribe_topics(void *context)
@@ -233,7 +353,7 @@ static bool subscribe_topics(void *context)
 		.topic_filter = TOPICS[TOPIC_SUB_LOGGING],
 		.qos = MQTT_QOS_1,
 		.callback = {
-			.run = message_received,
+			.run = logging_received,
 			.context = context,
 		},
 	};
@@ -245,10 +365,28 @@ static bool subscribe_topics(void *context)
 			.context = context,
 		},
 	};
+	mqtt_subscribe_t rules = {
+		.topic_filter = TOPICS[TOPIC_SUB_RULES],
+		.qos = MQTT_QOS_1,
+		.callback = {
+			.run = rules_received,
+			.context = context,
+		},
+	};
+	mqtt_subscribe_t profile = {
+		.topic_filter = TOPICS[TOPIC_SUB_PROFILE],
+		.qos = MQTT_QOS_1,
+		.callback = {
+			.run = profile_received,
+			.context = context,
+		},
+	};
 
 	if (mqtt_subscribe(m.mqtt, &version) != MQTT_SUCCESS
 			|| mqtt_subscribe(m.mqtt, &logging) != MQTT_SUCCESS
-			|| mqtt_subscribe(m.mqtt, &room) != MQTT_SUCCESS) {
+			|| mqtt_subscribe(m.mqtt, &room) != MQTT_SUCCESS
+			|| mqtt_subscribe(m.mqtt, &rules) != MQTT_SUCCESS
+			|| mqtt_subscribe(m.mqtt, &profile) != MQTT_SUCCESS) {
 		return false;
 	}
 
@@ -265,8 +403,16 @@ static bool module_topic_init(const char *reporter_name)
 		= get_topic_path_allocated(1, reporter_name, "logging");
 	TOPICS[TOPIC_SUB_ROOM]
 		= get_topic_path_allocated(1, reporter_name, "room");
+	TOPICS[TOPIC_SUB_RULES]
+		= get_topic_path_allocated(1, reporter_name, "rules");
+	TOPICS[TOPIC_SUB_PROFILE]
+		= get_topic_path_allocated(1, reporter_name, "profile");
 	TOPICS[TOPIC_PUB_HEARTBEAT]
 		= get_topic_path_allocated(0, reporter_name, "heartbeat");
+	TOPICS[TOPIC_PUB_SCENE]
+		= get_topic_path_allocated(0, reporter_name, "scene");
+	TOPICS[TOPIC_PUB_ROAMED]
+		= get_topic_path_allocated(0, reporter_name, "roamed");
 	TOPICS[TOPIC_PUB_WILL]
 		= get_topic_path_allocated(0, reporter_name, "will");
 
@@ -288,6 +434,10 @@ static const char *get_report_topic_from_type(report_t type)
 		return TOPIC_SUB2PUB(TOPIC_SUB_LOGGING);
 	case REPORT_ROOM:
 		return TOPIC_SUB2PUB(TOPIC_SUB_ROOM);
+	case REPORT_SCENE:
+		return TOPICS[TOPIC_PUB_SCENE];
+	case REPORT_PROFILE:
+		return TOPIC_SUB2PUB(TOPIC_SUB_PROFILE);
 	case REPORT_EVENT: /* fall through */
 	case REPORT_DATA: /* fall through */
 	default:
@@ -295,6 +445,17 @@ static const char *get_report_topic_from_type(report_t type)
 	}
 }
 
+/* how long a publish holds the caller, mostly writing it out */
+static bool publish(const mqtt_message_t *message)
+{
+	unsigned int started = uptime_get_ms();
+	mqtt_error_t err = mqtt_publish(m.mqtt, message);
+
+	histogram_record(MqttPublishLatency, uptime_get_ms() - started);
+
+	return err == MQTT_SUCCESS;
+}
+
 bool reporter_send(report_t type, const void *data, size_t data_size)
 {
 	const char *topic = get_report_topic_from_type(type);
@@ -303,12 +464,11 @@ bool reporter_send(report_t type, const void *data, size_t data_size)
 		return false;
 	}
 
-	return mqtt_publish(m.mqtt, &(mqtt_message_t) {
+	return publish(&(mqtt_message_t) {
 			.qos = MQTT_QOS_1,
 			.topic = topic,
 			.payload = (const uint8_t *)data,
-			.payload_size = data_size, })
-		== MQTT_SUCCESS;
+			.payload_size = data_size, });
 }
 
 bool reporter_send_event(report_t type, const void *data, size_t data_size)
@@ -319,13 +479,12 @@ bool reporter_send_event(report_t type, const void *data, size_t data_size)
 		return false;
 	}
 
-	return mqtt_publish(m.mqtt, &(mqtt_message_t) {
+	return publish(&(mqtt_message_t) {
 			.qos = MQTT_QOS_1,
 			.retain = true,
 			.topic = topic,
 			.payload = (const uint8_t *)data,
-			.payload_size = data_size, })
-		== MQTT_SUCCESS;
+			.payload_size = data_size, });
 }
 
 bool reporter_collect(const void *data, size_t data_size)
@@ -345,19 +504,14 @@ bool reporter_is_enabled(void)
 	return wifiman_count_networks() != 0;
 }
 
-reporter_t *reporter_new(const char *reporter_name)
+static void open_session(void *context)
 {
-	if (!module_topic_init(reporter_name)) {
-		return NULL;
+	if (!open_mqtt_connection(m.client_id)) {
+		error("broker connection failed");
+		return;
 	}
-	if (!network_interface_init()) {
-		return NULL;
-	}
-	if (!open_mqtt_connection(reporter_name)) {
-		return NULL;
-	}
-	if (!subscribe_topics(m.mqtt)) {
-		return NULL;
+	if (!subscribe_topics(context)) {
+		error("subscription failed");
 	}
 
 #if 1
@@ -377,6 +531,28 @@ reporter_t *reporter_new(const char *reporter_name)
 		info("%d: %s %d", i+1, scanlist[i].ssid, scanlist[i].rssi);
 	}
 #endif
+}
+
+/* returns once the network starts coming up, not waiting for a link. The
+ * broker session opens in the background as soon as an IP is allocated */
+reporter_t *reporter_new(const char *reporter_name)
+{
+	if (!module_topic_init(reporter_name)) {
+		return NULL;
+	}
+	if (!network_interface_init()) {
+		return NULL;
+	}
+	if (!create_mqtt_client()) {
+		return NULL;
+	}
+
+	m.client_id = reporter_name;
+	roaming_init(refresh_session, m.mqtt);
+
+	/* brought up like a reconnection, not to start another on a failed
+	 * attempt on the way */
+	start_reconnecting();
 
 	return (reporter_t *)m.mqtt;
 }
@@ -0,0 +1,88 @@
+#include "roaming.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "libmcu/logging.h"
+#include "libmcu/compiler.h"
+
+#include "jobpool.h"
+#include "uptime.h"
+#include "wifi.h"
+
+#if !defined(MIN)
+#define MIN(a, b)				(((a) > (b))? (b) : (a))
+#endif
+
+#if !defined(ROAMING_RSSI_THRESHOLD)
+#define ROAMING_RSSI_THRESHOLD			-72
+#endif
+/* a new AP must beat the current link by this much, not to ping-pong */
+#if !defined(ROAMING_MIN_GAIN_DB)
+#define ROAMING_MIN_GAIN_DB			8
+#endif
+#if !defined(ROAMING_SCAN_INTERVAL_MSEC)
+#define ROAMING_SCAN_INTERVAL_MSEC		30000
+#endif
+/* scans finding nothing better back off up to this */
+#if !defined(ROAMING_SCAN_INTERVAL_MAX_MSEC)
+#define ROAMING_SCAN_INTERVAL_MAX_MSEC		600000
+#endif
+
+static struct {
+	void (*on_roamed)(void *context);
+	void *context;
+	unsigned int scanned_at;
+	unsigned int interval;
+	volatile bool scanning;
+} m;
+
+static void roam(void *context)
+{
+	int8_t rssi = wifiman_get_rssi();
+
+	if (wifiman_roam(ROAMING_MIN_GAIN_DB) == WIFIMAN_SUCCESS) {
+		info("roamed from %d dBm to %d dBm", rssi, wifiman_get_rssi());
+		m.interval = ROAMING_SCAN_INTERVAL_MSEC;
+		if (m.on_roamed != NULL) {
+			m.on_roamed(m.context);
+		}
+	} else {
+		m.interval = MIN(m.interval * 2, ROAMING_SCAN_INTERVAL_MAX_MSEC);
+	}
+
+	m.scanned_at = uptime_get_ms();
+	m.scanning = false;
+
+	unused(context);
+}
+
+void roaming_poll(void)
+{
+	if (m.scanning || !wifiman_is_connected()) {
+		return;
+	}
+
+	if (wifiman_get_rssi() >= ROAMING_RSSI_THRESHOLD) {
+		m.interval = ROAMING_SCAN_INTERVAL_MSEC;
+		return;
+	}
+
+	if (uptime_get_ms() - m.scanned_at < m.interval) {
+		return;
+	}
+
+	m.scanning = true;
+	if (!jobpool_schedule_prio(JOBPOOL_PRIO_LOW, roam, NULL, 0)) {
+		m.scanning = false;
+	}
+}
+
+void roaming_init(void (*on_roamed)(void *context), void *context)
+{
+	m.on_roamed = on_roamed;
+	m.context = context;
+	m.scanned_at = uptime_get_ms();
+	m.interval = ROAMING_SCAN_INTERVAL_MSEC;
+	m.scanning = false;
+}
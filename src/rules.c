@@ -0,0 +1,328 @@
+#include "rules.h"
+
+#include <string.h>
+#include <pthread.h>
+
+#include "libmcu/logging.h"
+
+#if !defined(RULES_TABLE_MAXLEN)
+#define RULES_TABLE_MAXLEN			512
+#endif
+#if !defined(RULES_MAX)
+#define RULES_MAX				32 /* up to 255 */
+#endif
+#if !defined(RULES_BUCKETS)
+#define RULES_BUCKETS				16 /* must be a power of 2 */
+#endif
+
+#define RULES_KVSTORE_KEY			"table"
+#define TABLE_VERSION				1
+#define TABLE_HEADER_SIZE			4
+#define RULE_HEADER_SIZE			4
+#define NONE					0xff
+
+struct rule {
+	uint16_t key;
+	uint16_t code; /* offset in the table */
+	uint8_t code_len;
+	uint8_t trigger;
+	uint8_t next; /* in the same bucket */
+};
+
+struct index {
+	struct rule rules[RULES_MAX];
+	uint8_t buckets[RULES_BUCKETS];
+	uint8_t nr_rules;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	const struct rules_ops *ops;
+	kvstore_t *kvstore;
+	uint8_t table[RULES_TABLE_MAXLEN];
+	struct index index;
+	int minute;
+} m = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.minute = -1,
+};
+
+static uint16_t get_u16(const uint8_t *p)
+{
+	return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static unsigned int get_bucket(uint8_t trigger, uint16_t key)
+{
+	return (key * 31u + trigger) & (RULES_BUCKETS - 1);
+}
+
+/* returns 0 for an unknown or truncated op */
+static size_t get_op_size(const uint8_t *pc, size_t left)
+{
+	size_t len;
+
+	switch (pc[0]) {
+	case RULE_OP_TOGGLE:
+		len = 2;
+		break;
+	case RULE_OP_IF_SWITCH: /* fall through */
+	case RULE_OP_IF_VALUE_EQ: /* fall through */
+	case RULE_OP_IF_VALUE_GT: /* fall through */
+	case RULE_OP_IF_VALUE_LT: /* fall through */
+	case RULE_OP_SET:
+		len = 3;
+		break;
+	case RULE_OP_IF_TIME:
+		len = 5;
+		break;
+	case RULE_OP_IF_PAYLOAD: /* fall through */
+	case RULE_OP_PUBLISH:
+		len = left >= 2? 2 + (size_t)pc[1] : 0;
+		break;
+	default:
+		return 0;
+	}
+
+	return len <= left? len : 0;
+}
+
+static bool is_code_valid(const uint8_t *code, size_t code_len)
+{
+	for (size_t i = 0, len; i < code_len; i += len) {
+		if ((len = get_op_size(&code[i], code_len - i)) == 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static bool build_index(struct index *index,
+		const uint8_t *table, size_t table_size)
+{
+	size_t offset = TABLE_HEADER_SIZE;
+
+	memset(index->buckets, NONE, sizeof(index->buckets));
+	index->nr_rules = 0;
+
+	if (table_size < TABLE_HEADER_SIZE || table[0] != 'R'
+			|| table[1] != 'L' || table[2] != TABLE_VERSION
+			|| table[3] > RULES_MAX) {
+		return false;
+	}
+
+	for (uint8_t i = 0; i < table[3]; i++) {
+		if (offset + RULE_HEADER_SIZE > table_size) {
+			return false;
+		}
+
+		const uint8_t *p = &table[offset];
+		struct rule *rule = &index->rules[i];
+
+		*rule = (struct rule) {
+			.trigger = p[0],
+			.key = get_u16(&p[1]),
+			.code_len = p[3],
+			.code = (uint16_t)(offset + RULE_HEADER_SIZE),
+			.next = NONE,
+		};
+
+		offset += RULE_HEADER_SIZE + rule->code_len;
+		if (offset > table_size
+				|| !is_code_valid(&table[rule->code],
+					rule->code_len)) {
+			return false;
+		}
+	}
+
+	/* backward for each bucket to keep the order in the table */
+	for (uint8_t i = table[3]; i-- > 0; ) {
+		struct rule *rule = &index->rules[i];
+		unsigned int bucket = get_bucket(rule->trigger, rule->key);
+
+		rule->next = index->buckets[bucket];
+		index->buckets[bucket] = i;
+	}
+
+	index->nr_rules = table[3];
+
+	return true;
+}
+
+static bool is_within(int minute, uint16_t from, uint16_t to)
+{
+	if (from <= to) {
+		return minute >= from && minute < to;
+	}
+
+	return minute >= from || minute < to; /* past midnight */
+}
+
+static bool run(const struct rule *rule, int32_t value,
+		const void *payload, size_t payload_size)
+{
+	const uint8_t *pc = &m.table[rule->code];
+	const uint8_t *end = pc + rule->code_len;
+	int minute;
+
+	for (size_t len; pc < end; pc += len) {
+		len = get_op_size(pc, (size_t)(end - pc));
+
+		switch (pc[0]) {
+		case RULE_OP_IF_SWITCH:
+			if ((m.ops->get_switches() & pc[1]) != pc[2]) {
+				return false;
+			}
+			break;
+		case RULE_OP_IF_VALUE_EQ:
+			if (value != (int16_t)get_u16(&pc[1])) {
+				return false;
+			}
+			break;
+		case RULE_OP_IF_VALUE_GT:
+			if (value <= (int16_t)get_u16(&pc[1])) {
+				return false;
+			}
+			break;
+		case RULE_OP_IF_VALUE_LT:
+			if (value >= (int16_t)get_u16(&pc[1])) {
+				return false;
+			}
+			break;
+		case RULE_OP_IF_PAYLOAD:
+			if (payload_size != pc[1]
+					|| memcmp(payload, &pc[2], pc[1]) != 0) {
+				return false;
+			}
+			break;
+		case RULE_OP_IF_TIME:
+			minute = m.ops->get_minute_of_day();
+			if (minute < 0 || !is_within(minute,
+						get_u16(&pc[1]),
+						get_u16(&pc[3]))) {
+				return false;
+			}
+			break;
+		case RULE_OP_SET:
+			m.ops->set_switches(pc[1], pc[2]);
+			break;
+		case RULE_OP_TOGGLE:
+			m.ops->set_switches(pc[1], ~m.ops->get_switches());
+			break;
+		case RULE_OP_PUBLISH:
+			m.ops->publish(&pc[2], pc[1]);
+			break;
+		default:
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int rules_trigger(rule_trigger_t trigger, uint16_t key, int32_t value,
+		const void *payload, size_t payload_size)
+{
+	int fired = 0;
+
+	if (m.ops == NULL) {
+		return 0;
+	}
+
+	pthread_mutex_lock(&m.lock);
+	{
+		uint8_t i = m.index.buckets[get_bucket((uint8_t)trigger, key)];
+
+		for (; i != NONE; i = m.index.rules[i].next) {
+			const struct rule *rule = &m.index.rules[i];
+
+			if (rule->trigger == trigger && rule->key == key
+					&& run(rule, value,
+						payload, payload_size)) {
+				fired++;
+			}
+		}
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	return fired;
+}
+
+void rules_poll(void)
+{
+	int minute;
+
+	if (m.ops == NULL || (minute = m.ops->get_minute_of_day()) < 0
+			|| minute == m.minute) {
+		return;
+	}
+
+	m.minute = minute;
+	rules_trigger(RULE_TRIGGER_TIME, (uint16_t)minute, 0, NULL, 0);
+}
+
+bool rules_update(const void *table, size_t table_size)
+{
+	static const uint8_t empty[TABLE_HEADER_SIZE] = {
+		'R', 'L', TABLE_VERSION, 0,
+	};
+	struct index index;
+	bool rc = false;
+
+	if (table == NULL || table_size == 0) {
+		table = empty;
+		table_size = sizeof(empty);
+	}
+
+	if (table_size > sizeof(m.table)
+			|| !build_index(&index, (const uint8_t *)table,
+				table_size)) {
+		error("invalid rule table");
+		return false;
+	}
+
+	pthread_mutex_lock(&m.lock);
+	{
+		if (m.kvstore == NULL || kvstore_write(m.kvstore,
+					RULES_KVSTORE_KEY, table, table_size)
+				== table_size) {
+			memcpy(m.table, table, table_size);
+			m.index = index;
+			rc = true;
+		}
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	if (rc) {
+		info("%u rules loaded", index.nr_rules);
+	}
+
+	return rc;
+}
+
+unsigned int rules_count(void)
+{
+	return m.index.nr_rules;
+}
+
+void rules_init(const struct rules_ops *ops, kvstore_t *kvstore)
+{
+	size_t len = 0;
+
+	pthread_mutex_lock(&m.lock);
+	{
+		m.ops = ops;
+		m.kvstore = kvstore;
+		m.minute = -1;
+
+		if (kvstore != NULL) {
+			len = kvstore_read(kvstore, RULES_KVSTORE_KEY,
+					m.table, sizeof(m.table));
+		}
+		if (!build_index(&m.index, m.table, len) && len != 0) {
+			error("rule table corrupted");
+		}
+	}
+	pthread_mutex_unlock(&m.lock);
+}
@@ -1,118 +1,196 @@
 #include "switch.h"
 
-#include <time.h>
+#include <pthread.h>
 
-#include "libmcu/button.h"
 #include "libmcu/logging.h"
+#include "libmcu/compiler.h"
 
-#include "light.h"
 #include "relay.h"
 #include "led.h"
-#include "sleep.h"
-
-static void button1_pressed(const struct button_data *btn, void *context);
-static void button1_released(const struct button_data *btn, void *context);
-static void button2_pressed(const struct button_data *btn, void *context);
-static void button2_released(const struct button_data *btn, void *context);
+#include "jobpool.h"
+#include "switch_store.h"
+#include "rules.h"
+#include "gesture.h"
+#include "histogram.h"
+#include "uptime.h"
+#include "nvs_kvstore.h"
+
+#define SWITCH_KVSTORE_NAMESPACE		"switch"
+#define SWITCH_CHANNELS_MAX			8
+
+#if SWITCH_CHANNELS > SWITCH_CHANNELS_MAX
+#error "up to 8 channels supported"
+#endif
+
+#define CHANNELS_MASK				((1u << SWITCH_CHANNELS) - 1)
+
+typedef enum {
+	ACTION_NONE,
+	ACTION_TOGGLE,
+	ACTION_ALL_ON,
+	ACTION_ALL_OFF,
+} action_t;
+
+/* The relay toggles on the press itself, not waiting to tell a click from
+ * a double click. Rules of the button take over these. */
+static const uint8_t actions[GESTURE_MAX] = {
+	[GESTURE_PRESS] = ACTION_TOGGLE,
+	[GESTURE_LONG_PRESS] = ACTION_ALL_OFF,
+};
 
 static struct {
-	struct light light1;
-	struct light light2;
-
-	button_handlers_t button1;
-	button_handlers_t button2;
-
-	void (*callback)(int n, const struct light *light);
+	pthread_mutex_t lock;
+	uint32_t states; /* bit n for channel n + 1 */
+	bool reporting;
+	void (*callback)(uint32_t states);
 } m = {
-	.button1.pressed = button1_pressed,
-	.button1.released = button1_released,
-	.button2.pressed = button2_pressed,
-	.button2.released = button2_released,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
 };
 
-static void set_switch(int n, bool state)
+/* saving and reporting can block. They run on the jobpool not to hold the
+ * button path, which gets to the relay right away. */
+static void report_states(void *context)
 {
-	struct light *light;
+	uint32_t states;
 
-	switch (n) {
-	case 1:
-		light = &m.light1;
-		relay_1_set(state);
-		break;
-	case 2:
-		light = &m.light2;
-		relay_2_set(state);
-		break;
-	default:
-		return;
+	pthread_mutex_lock(&m.lock);
+	{
+		states = m.states;
+		m.reporting = false;
 	}
+	pthread_mutex_unlock(&m.lock);
+
+	switch_store_save(states);
+	m.callback(states);
 
-	light->state = state;
-	m.callback(n, light);
+	unused(context);
 }
 
-static void button1_pressed(const struct button_data *btn, void *context)
+static void set_switches(uint32_t mask, uint32_t states, bool toggle)
 {
-	(void)context;
-	debug("button#1 pressed %d, %x", btn->time_pressed, btn->history);
+	bool reporting;
+
+	if ((mask &= CHANNELS_MASK) == 0) {
+		return;
+	}
+
+	pthread_mutex_lock(&m.lock);
+	{
+		uint32_t changed = toggle? mask : (m.states ^ states) & mask;
+		m.states ^= changed;
+
+		for (unsigned int i = 0; changed; i++, changed >>= 1) {
+			if (changed & 1u) {
+				relay_set(i, (m.states >> i) & 1u);
+			}
+		}
+
+		reporting = m.reporting;
+		m.reporting = true;
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	if (!reporting && !jobpool_schedule(report_states, NULL)) {
+		pthread_mutex_lock(&m.lock);
+		{
+			m.reporting = false;
+		}
+		pthread_mutex_unlock(&m.lock);
+		error("cannot report switch states");
+	}
 }
 
-static void button1_released(const struct button_data *btn, void *context)
+static void gesture_recognized(unsigned int n, gesture_t gesture)
 {
-	set_switch(1, !m.light1.state);
+	debug("button#%u gesture %d", n + 1, gesture);
 
-	(void)context;
-	debug("button#1 released %d, %x", btn->time_released, btn->history);
+	/* a button with rules of its own does not take the default action */
+	if (rules_trigger(RULE_TRIGGER_BUTTON, (uint16_t)n, gesture,
+				NULL, 0) > 0) {
+		return;
+	}
+
+	switch (actions[gesture]) {
+	case ACTION_TOGGLE:
+		set_switches(1u << n, 0, true);
+		break;
+	case ACTION_ALL_ON:
+		set_switches(CHANNELS_MASK, ~0u, false);
+		break;
+	case ACTION_ALL_OFF:
+		set_switches(CHANNELS_MASK, 0, false);
+		break;
+	case ACTION_NONE: /* fall through */
+	default:
+		break;
+	}
 }
 
-static void button2_pressed(const struct button_data *btn, void *context)
+static void button_changed(unsigned int n, bool pressed, uint32_t usec)
 {
-	(void)context;
-	debug("button#2 pressed %d, %x", btn->time_pressed, btn->history);
+	gesture_feed(n, pressed, usec);
+
+	/* the relay got switched in place on the press */
+	if (pressed) {
+		histogram_record(ButtonToRelayLatency, uptime_get_us() - usec);
+	}
 }
 
-static void button2_released(const struct button_data *btn, void *context)
+/* the state saved before the power went off wins over the switch levels */
+static void set_initial_state(void)
 {
-	set_switch(1, !m.light2.state);
+	uint32_t states = 0;
+
+	if (!switch_store_load(&states)) {
+		for (unsigned int i = 0; i < SWITCH_CHANNELS; i++) {
+			if (switch_get_state(i)) {
+				states |= 1u << i;
+			}
+		}
+	}
+
+	m.states = states & CHANNELS_MASK;
 
-	(void)context;
-	debug("button#2 released %d, %x", btn->time_released, btn->history);
+	for (unsigned int i = 0; i < SWITCH_CHANNELS; i++) {
+		relay_set(i, (m.states >> i) & 1u);
+	}
 }
 
-static unsigned int get_time_ms(void)
+void switch_set(int n, bool state)
 {
-	time_t t = time(NULL);
-	return (unsigned int)t;
+	if (n < 1 || n > SWITCH_CHANNELS) {
+		return;
+	}
+
+	set_switches(1u << (n - 1), state? ~0u : 0, false);
 }
 
-static void set_initial_state(void)
+void switch_set_mask(uint32_t mask, uint32_t states)
 {
-	if (switch1_get_state()) {
-		m.light1.state = true;
-	}
-	if (switch2_get_state()) {
-		m.light2.state = true;
-	}
+	set_switches(mask, states, false);
+}
 
-	relay_1_set(m.light1.state);
-	relay_2_set(m.light2.state);
+uint32_t switch_get_mask(void)
+{
+	return m.states;
 }
 
-void switch_set(int n, bool state)
+void switch_poll(void)
 {
-	set_switch(n, state);
+	switch_store_poll();
 }
 
-void switch_init(void (*callback)(int n, const struct light *light))
+void switch_init(void (*callback)(uint32_t states))
 {
 	m.callback = callback;
 
+	switch_store_init(nvs_kvstore_open(SWITCH_KVSTORE_NAMESPACE));
+
 	led_init();
 	relay_init();
-	button_init(get_time_ms, sleep_ms);
-
-	button_register(&m.button1, switch1_get_state);
-	button_register(&m.button2, switch2_get_state);
 
 	set_initial_state();
+
+	gesture_init(SWITCH_CHANNELS, NULL, gesture_recognized);
+	switch_hw_init(button_changed, gesture_poll);
 }
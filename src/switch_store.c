@@ -0,0 +1,173 @@
+#include "switch_store.h"
+
+#include <stdio.h>
+#include <pthread.h>
+
+#include "libmcu/logging.h"
+
+#include "uptime.h"
+
+#if !defined(SWITCH_STORE_SLOTS)
+#define SWITCH_STORE_SLOTS			8
+#endif
+#if !defined(SWITCH_STORE_INTERVAL_MSEC)
+#define SWITCH_STORE_INTERVAL_MSEC		5000
+#endif
+#define KEY_PREFIX				"state"
+#define KEY_MAXLEN				15
+
+struct slot {
+	uint32_t seq;
+	uint32_t state;
+};
+
+/* saving comes from a jobpool worker while polling comes from the main loop */
+static struct {
+	pthread_mutex_t lock;
+	kvstore_t *kvstore;
+	uint32_t seq; /* of the latest slot */
+	uint8_t slot;
+	bool loaded;
+
+	uint32_t saved;
+	uint32_t pending;
+	bool dirty;
+	unsigned int saved_at;
+} m = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static void get_key(char *key, uint8_t slot)
+{
+	snprintf(key, KEY_MAXLEN + 1, KEY_PREFIX "%u", slot);
+}
+
+static bool write_slot(uint32_t state)
+{
+	uint8_t next = (uint8_t)((m.slot + 1) % SWITCH_STORE_SLOTS);
+	struct slot slot = {
+		.seq = m.seq + 1,
+		.state = state,
+	};
+	char key[KEY_MAXLEN + 1];
+
+	get_key(key, next);
+
+	if (kvstore_write(m.kvstore, key, &slot, sizeof(slot))
+			!= sizeof(slot)) {
+		error("cannot save switch state");
+		return false;
+	}
+
+	m.slot = next;
+	m.seq = slot.seq;
+	m.saved = state;
+	m.saved_at = uptime_get_ms();
+	m.loaded = true;
+
+	return true;
+}
+
+static bool flush_internal(void)
+{
+	if (!m.dirty || m.kvstore == NULL) {
+		return true;
+	}
+
+	uint32_t state = m.pending;
+
+	if (!write_slot(state)) {
+		return false;
+	}
+
+	m.dirty = m.pending != state;
+
+	return true;
+}
+
+static void poll_internal(void)
+{
+	if (m.dirty && uptime_get_ms() - m.saved_at
+			>= SWITCH_STORE_INTERVAL_MSEC) {
+		flush_internal();
+	}
+}
+
+bool switch_store_flush(void)
+{
+	bool rc;
+
+	pthread_mutex_lock(&m.lock);
+	{
+		rc = flush_internal();
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	return rc;
+}
+
+void switch_store_poll(void)
+{
+	pthread_mutex_lock(&m.lock);
+	{
+		poll_internal();
+	}
+	pthread_mutex_unlock(&m.lock);
+}
+
+void switch_store_save(uint32_t state)
+{
+	pthread_mutex_lock(&m.lock);
+	{
+		m.pending = state;
+		m.dirty = !m.loaded || state != m.saved;
+
+		poll_internal();
+	}
+	pthread_mutex_unlock(&m.lock);
+}
+
+bool switch_store_load(uint32_t *state)
+{
+	bool loaded;
+
+	pthread_mutex_lock(&m.lock);
+	{
+		loaded = m.loaded;
+		if (loaded) {
+			*state = m.saved;
+		}
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	return loaded;
+}
+
+void switch_store_init(kvstore_t *kvstore)
+{
+	m.kvstore = kvstore;
+	m.seq = 0;
+	m.slot = SWITCH_STORE_SLOTS - 1;
+	m.loaded = false;
+	m.dirty = false;
+	/* the first change goes out at once */
+	m.saved_at = uptime_get_ms() - SWITCH_STORE_INTERVAL_MSEC;
+
+	for (uint8_t i = 0; kvstore != NULL && i < SWITCH_STORE_SLOTS; i++) {
+		struct slot slot;
+		char key[KEY_MAXLEN + 1];
+
+		get_key(key, i);
+
+		if (kvstore_read(kvstore, key, &slot, sizeof(slot))
+					!= sizeof(slot)
+				|| (m.loaded && (int32_t)(slot.seq - m.seq) <= 0)) {
+			continue;
+		}
+
+		m.seq = slot.seq;
+		m.slot = i;
+		m.saved = slot.state;
+		m.loaded = true;
+	}
+}
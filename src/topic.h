@@ -11,7 +11,11 @@ enum {
 	TOPIC_SUB_VERSION_DATA,
 	TOPIC_SUB_LOGGING,
 	TOPIC_SUB_ROOM,
+	TOPIC_SUB_RULES,
+	TOPIC_SUB_PROFILE,
 	TOPIC_PUB_HEARTBEAT,
+	TOPIC_PUB_SCENE,
+	TOPIC_PUB_ROAMED,
 	TOPIC_PUB_WILL,
 	TOPIC_MAX,
 };
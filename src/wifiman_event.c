@@ -0,0 +1,126 @@
+#include "wifiman_event.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#include "libmcu/pubsub.h"
+#include "libmcu/logging.h"
+
+#if !defined(WIFIMAN_EVENT_LISTENERS_MAX)
+#define WIFIMAN_EVENT_LISTENERS_MAX		8
+#endif
+
+struct listener {
+	wifiman_event_t event;
+	wifiman_event_handler_t handler;
+	pubsub_subscribe_t subscription;
+};
+
+static const char *topics[WIFIMAN_EVENT_MAX] = {
+	[WIFIMAN_EVENT_READY] = "wifi/event/ready",
+	[WIFIMAN_EVENT_CONNECTED] = "wifi/event/connected",
+	[WIFIMAN_EVENT_DISCONNECTED] = "wifi/event/disconnected",
+	[WIFIMAN_EVENT_IP_ALLOCATED] = "wifi/event/ip",
+	[WIFIMAN_EVENT_SCAN_COMPLETED] = "wifi/event/scan",
+	[WIFIMAN_EVENT_AP_STATE_CHANGED] = "wifi/event/ap",
+	[WIFIMAN_EVENT_AP_STATION_CONNECTED] = "wifi/event/ap/connected",
+	[WIFIMAN_EVENT_AP_STATION_DISCONNECTED] = "wifi/event/ap/disconnected",
+};
+
+static struct {
+	pthread_mutex_t lock;
+	struct listener listeners[WIFIMAN_EVENT_LISTENERS_MAX];
+} m = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static void dispatch(void *context, const void *msg, size_t msglen)
+{
+	const struct listener *listener = (const struct listener *)context;
+	wifiman_event_t event;
+
+	if (msglen != sizeof(event)) {
+		return;
+	}
+
+	memcpy(&event, msg, sizeof(event));
+	listener->handler(event, NULL);
+}
+
+static struct listener *find_listener(wifiman_event_t event,
+		wifiman_event_handler_t handler)
+{
+	for (int i = 0; i < WIFIMAN_EVENT_LISTENERS_MAX; i++) {
+		struct listener *p = &m.listeners[i];
+
+		if (p->handler == handler && p->event == event) {
+			return p;
+		}
+	}
+
+	return NULL;
+}
+
+void wifiman_event_publish(wifiman_event_t event)
+{
+	if (event <= WIFIMAN_EVENT_UNKNOWN || event >= WIFIMAN_EVENT_MAX) {
+		return;
+	}
+
+	pubsub_publish(topics[event], &event, sizeof(event));
+}
+
+wifiman_error_t wifiman_register_event_handler(wifiman_event_t event,
+		wifiman_event_handler_t handler)
+{
+	wifiman_error_t rc = WIFIMAN_ERROR;
+
+	if (event <= WIFIMAN_EVENT_UNKNOWN || event >= WIFIMAN_EVENT_MAX
+			|| handler == NULL) {
+		return WIFIMAN_INVALID_PARAM;
+	}
+
+	pthread_mutex_lock(&m.lock);
+	{
+		struct listener *p = find_listener(event, handler);
+
+		if (p != NULL) { /* already registered */
+			rc = WIFIMAN_SUCCESS;
+		} else if ((p = find_listener(WIFIMAN_EVENT_UNKNOWN, NULL))
+				== NULL) {
+			warn("no room for event handler");
+		} else if (pubsub_subscribe_static(&p->subscription,
+					topics[event], dispatch, p) != NULL) {
+			p->event = event;
+			p->handler = handler;
+			rc = WIFIMAN_SUCCESS;
+		}
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	return rc;
+}
+
+wifiman_error_t wifiman_unregister_event_handler(wifiman_event_t event,
+		wifiman_event_handler_t handler)
+{
+	wifiman_error_t rc = WIFIMAN_INVALID_PARAM;
+
+	if (event <= WIFIMAN_EVENT_UNKNOWN || event >= WIFIMAN_EVENT_MAX) {
+		return WIFIMAN_INVALID_PARAM;
+	}
+
+	pthread_mutex_lock(&m.lock);
+	{
+		struct listener *p = find_listener(event, handler);
+
+		if (p != NULL) {
+			pubsub_unsubscribe(&p->subscription);
+			memset(p, 0, sizeof(*p));
+			rc = WIFIMAN_SUCCESS;
+		}
+	}
+	pthread_mutex_unlock(&m.lock);
+
+	return rc;
+}
@@ -0,0 +1,113 @@
+#include "wifiman_rank.h"
+#include <string.h>
+
+/* dB the success rate can move a candidate, either way */
+#define HISTORY_WEIGHT_DB		10
+
+static int get_security_bonus(wifiman_security_t security)
+{
+	switch (security) {
+	case WIFIMAN_SECURITY_WPA3:
+		return 4;
+	case WIFIMAN_SECURITY_WPA2:
+	case WIFIMAN_SECURITY_WPA2_ENTERPRISE:
+		return 3;
+	case WIFIMAN_SECURITY_WPA:
+		return 1;
+	case WIFIMAN_SECURITY_WEP:
+		return -3;
+	case WIFIMAN_SECURITY_OPEN:
+		return -5;
+	case WIFIMAN_SECURITY_AUTO:
+	case WIFIMAN_SECURITY_MAX:
+	default:
+		return 0;
+	}
+}
+
+/* Laplace-smoothed success rate mapped onto
+ * [-HISTORY_WEIGHT_DB, HISTORY_WEIGHT_DB], so that an unknown network is
+ * neutral */
+static int get_history_bonus(const wifiman_saved_network_t *saved)
+{
+	int successes = saved->successes + 1;
+	int attempts = saved->attempts + 2;
+
+	return 2 * HISTORY_WEIGHT_DB * successes / attempts - HISTORY_WEIGHT_DB;
+}
+
+static int get_score(const wifiman_network_profile_t *scanned,
+		const wifiman_saved_network_t *saved)
+{
+	return scanned->rssi + get_security_bonus(scanned->security)
+		+ get_history_bonus(saved);
+}
+
+static const wifiman_network_profile_t *find_strongest(
+		const wifiman_network_profile_t *scanlist, int nr_scanned,
+		const wifiman_saved_network_t *saved)
+{
+	const wifiman_network_profile_t *strongest = NULL;
+
+	for (int i = 0; i < nr_scanned; i++) {
+		const wifiman_network_profile_t *p = &scanlist[i];
+
+		if (strncmp(p->ssid, saved->ssid, WIFIMAN_SSID_MAXLEN) != 0) {
+			continue;
+		}
+		if (saved->bssid != NULL && memcmp(p->bssid, saved->bssid,
+					sizeof(p->bssid)) != 0) {
+			continue;
+		}
+		if (strongest == NULL || p->rssi > strongest->rssi) {
+			strongest = p;
+		}
+	}
+
+	return strongest;
+}
+
+static void insert_sorted(wifiman_candidate_t *candidates, int n,
+		const wifiman_candidate_t *candidate)
+{
+	int i = n;
+
+	while (i > 0 && candidates[i-1].score < candidate->score) {
+		candidates[i] = candidates[i-1];
+		i--;
+	}
+
+	candidates[i] = *candidate;
+}
+
+int wifiman_rank(wifiman_candidate_t *candidates, int maxlen,
+		const wifiman_network_profile_t *scanlist, int nr_scanned,
+		const wifiman_saved_network_t *saved, int nr_saved)
+{
+	int n = 0;
+
+	if (candidates == NULL || scanlist == NULL || saved == NULL) {
+		return 0;
+	}
+
+	for (int i = 0; i < nr_saved && n < maxlen; i++) {
+		const wifiman_network_profile_t *p =
+			find_strongest(scanlist, nr_scanned, &saved[i]);
+		if (p == NULL) {
+			continue;
+		}
+
+		wifiman_candidate_t candidate = {
+			.index = saved[i].index,
+			.channel = p->channel,
+			.rssi = p->rssi,
+			.security = p->security,
+			.score = get_score(p, &saved[i]),
+		};
+		memcpy(candidate.bssid, p->bssid, sizeof(candidate.bssid));
+
+		insert_sorted(candidates, n++, &candidate);
+	}
+
+	return n;
+}
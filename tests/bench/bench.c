@@ -0,0 +1,177 @@
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#if !defined(VERSION)
+#define VERSION				unknown
+#endif
+
+#define def2str(x)			_def2str(x)
+#define _def2str(x)			#x
+
+#define NSEC_PER_SEC			1000000000ULL
+#define DEFAULT_MIN_TIME_MSEC		500
+#define BATCHES				5
+#define CALIBRATION_TARGET_NSEC		(2ULL * 1000000) /* 2ms */
+
+struct bench_result {
+	const char *name;
+	uint64_t iterations;
+	double ns_per_op_best;
+	double ns_per_op_median;
+	double bytes_per_sec;
+};
+
+static const void * volatile sink;
+
+void bench_consume(const void *p)
+{
+	sink = p;
+}
+
+static uint64_t get_time_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * NSEC_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t run_batch(const struct bench_case *bench, uint64_t n)
+{
+	if (bench->setup != NULL) {
+		bench->setup(bench->context);
+	}
+
+	uint64_t t0 = get_time_ns();
+	for (uint64_t i = 0; i < n; i++) {
+		bench->run(bench->context);
+	}
+	return get_time_ns() - t0;
+}
+
+static uint64_t calibrate(const struct bench_case *bench)
+{
+	uint64_t n = 1;
+
+	while (run_batch(bench, n) < CALIBRATION_TARGET_NSEC && n < (1ULL << 40)) {
+		n <<= 1;
+	}
+
+	return n;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+static void run_case(const struct bench_case *bench, unsigned int min_time_ms,
+		struct bench_result *result)
+{
+	uint64_t per_batch_ns = (uint64_t)min_time_ms * 1000000 / BATCHES;
+	uint64_t n = calibrate(bench);
+	uint64_t n_per_batch = n * (per_batch_ns / CALIBRATION_TARGET_NSEC + 1);
+	double samples[BATCHES];
+
+	for (int i = 0; i < BATCHES; i++) {
+		uint64_t elapsed = run_batch(bench, n_per_batch);
+		samples[i] = (double)elapsed / (double)n_per_batch;
+	}
+
+	qsort(samples, BATCHES, sizeof(samples[0]), compare_double);
+
+	*result = (struct bench_result) {
+		.name = bench->name,
+		.iterations = n_per_batch * BATCHES,
+		.ns_per_op_best = samples[0],
+		.ns_per_op_median = samples[BATCHES / 2],
+		.bytes_per_sec = bench->bytes_per_op == 0? 0 :
+			(double)bench->bytes_per_op * 1e9 / samples[BATCHES / 2],
+	};
+}
+
+static void print_result(const struct bench_result *result)
+{
+	printf("%-32s %12llu %12.1f %12.1f", result->name,
+			(unsigned long long)result->iterations,
+			result->ns_per_op_best, result->ns_per_op_median);
+	if (result->bytes_per_sec > 0) {
+		printf(" %10.2f MB/s", result->bytes_per_sec / 1e6);
+	}
+	printf("\n");
+}
+
+static void write_result(FILE *fp, const struct bench_result *result)
+{
+	fprintf(fp, "%s,%s,%llu,%.1f,%.1f,%.0f\n", def2str(VERSION),
+			result->name, (unsigned long long)result->iterations,
+			result->ns_per_op_best, result->ns_per_op_median,
+			result->bytes_per_sec);
+}
+
+static void usage(const char *progname)
+{
+	fprintf(stderr, "usage: %s [-o output.csv] [-t min_time_ms] "
+			"[-f filter]\n", progname);
+}
+
+int main(int argc, char **argv)
+{
+	const char *outfile = NULL;
+	const char *filter = NULL;
+	unsigned int min_time_ms = DEFAULT_MIN_TIME_MSEC;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+			outfile = argv[++i];
+		} else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+			min_time_ms = (unsigned int)strtoul(argv[++i], NULL, 10);
+		} else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+			filter = argv[++i];
+		} else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	FILE *fp = NULL;
+	if (outfile != NULL) {
+		if ((fp = fopen(outfile, "w")) == NULL) {
+			perror(outfile);
+			return 1;
+		}
+		fprintf(fp, "version,name,iterations,"
+				"ns_per_op_best,ns_per_op_median,bytes_per_sec\n");
+	}
+
+	printf("%-32s %12s %12s %12s %15s\n", "benchmark", "iterations",
+			"best ns/op", "median ns/op", "throughput");
+
+	for (size_t i = 0; i < bench_cases_count; i++) {
+		const struct bench_case *bench = &bench_cases[i];
+		struct bench_result result;
+
+		if (filter != NULL && strstr(bench->name, filter) == NULL) {
+			continue;
+		}
+
+		run_case(bench, min_time_ms, &result);
+		print_result(&result);
+
+		if (fp != NULL) {
+			write_result(fp, &result);
+		}
+	}
+
+	if (fp != NULL) {
+		fclose(fp);
+	}
+
+	return 0;
+}
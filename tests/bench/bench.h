@@ -0,0 +1,31 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+struct bench_case {
+	const char *name;
+	/* payload bytes processed per call, 0 to leave bytes/s out */
+	size_t bytes_per_op;
+	/* called before every batch, not timed */
+	void (*setup)(void *context);
+	void (*run)(void *context);
+	void *context;
+};
+
+/* defined by each benchmark source file */
+extern const struct bench_case bench_cases[];
+extern const size_t bench_cases_count;
+
+/* keeps the compiler from optimizing away results */
+void bench_consume(const void *p);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* BENCH_H */
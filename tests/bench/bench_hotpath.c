@@ -0,0 +1,267 @@
+#include "bench.h"
+
+#include <string.h>
+#include <stdint.h>
+
+#include "libmcu/base64.h"
+
+#include "jsmnn.h"
+#include "url.h"
+#include "mqtt.h"
+
+#define JSMN_MEMSIZE			384 /* the same to ota/format/json.c */
+#define OTA_CHUNK_SIZE			128
+#define OTA_CHUNK_SIZE_LARGE		512
+
+#define BASE64_LEN(n)			(((n) + 2) / 3 * 4)
+#define STRLEN(s)			(sizeof(s) - 1)
+
+#define CHUNK_JSON_HEAD			"{\"index\":42,\"data\":\""
+#define CHUNK_JSON_TAIL			"\"}"
+#define CHUNK_JSON_LEN			(STRLEN(CHUNK_JSON_HEAD) \
+		+ BASE64_LEN(OTA_CHUNK_SIZE) + STRLEN(CHUNK_JSON_TAIL))
+
+#define VERSION_REQUEST_JSON		\
+	"{\"type\":\"request\",\"version\":\"1.2.4\"," \
+	"\"size\":524288,\"force\":false}"
+#define PROVISIONING_FORM		\
+	"ssid=My%20Home%20Network%202.4G" \
+	"&pass=p%40ssw0rd%21%23%24%25%5E%26*%28%29"
+
+struct json_context {
+	const char *json;
+	size_t len;
+	const char * const *keys;
+	size_t nr_keys;
+};
+
+struct base64_context {
+	const char *encoded;
+	size_t len;
+	char buf[OTA_CHUNK_SIZE_LARGE * 2];
+};
+
+struct url_context {
+	const char *encoded;
+	char buf[256];
+};
+
+struct topic_context {
+	const char * const *filters;
+	size_t nr_filters;
+	const char *topic;
+};
+
+static const char *ota_request_keys[] = {
+	"type", "version", "size", "force", "index", "data",
+};
+
+static char ota_chunk_json[OTA_CHUNK_SIZE_LARGE * 2];
+static char ota_chunk_b64[OTA_CHUNK_SIZE * 2];
+static char ota_chunk_b64_large[OTA_CHUNK_SIZE_LARGE * 2];
+
+static struct json_context version_request = {
+	.json = VERSION_REQUEST_JSON,
+	.len = STRLEN(VERSION_REQUEST_JSON),
+	.keys = ota_request_keys,
+	.nr_keys = sizeof(ota_request_keys) / sizeof(ota_request_keys[0]),
+};
+
+static struct json_context data_chunk = {
+	.json = ota_chunk_json,
+	.len = CHUNK_JSON_LEN,
+	.keys = ota_request_keys,
+	.nr_keys = sizeof(ota_request_keys) / sizeof(ota_request_keys[0]),
+};
+
+static struct base64_context chunk_b64 = {
+	.encoded = ota_chunk_b64,
+	.len = BASE64_LEN(OTA_CHUNK_SIZE),
+};
+
+static struct base64_context chunk_b64_large = {
+	.encoded = ota_chunk_b64_large,
+	.len = BASE64_LEN(OTA_CHUNK_SIZE_LARGE),
+};
+
+static struct url_context provisioning_form = {
+	.encoded = PROVISIONING_FORM,
+};
+
+static const char *subscriptions[] = {
+	"cmd/all/hello/sn5ccf7f0a1b2c/version",
+	"cmd/all/hello/sn5ccf7f0a1b2c/version/data",
+	"cmd/all/hello/sn5ccf7f0a1b2c/logging",
+	"cmd/all/hello/sn5ccf7f0a1b2c/room",
+	"cmd/all/hello/+/broadcast",
+	"cmd/all/#",
+};
+
+static struct topic_context topic_exact = {
+	.filters = subscriptions,
+	.nr_filters = sizeof(subscriptions) / sizeof(subscriptions[0]),
+	.topic = "cmd/all/hello/sn5ccf7f0a1b2c/room",
+};
+
+static struct topic_context topic_wildcard = {
+	.filters = subscriptions,
+	.nr_filters = sizeof(subscriptions) / sizeof(subscriptions[0]),
+	.topic = "cmd/all/hello/sn5ccf7f0a1b2c/broadcast",
+};
+
+static struct topic_context topic_miss = {
+	.filters = subscriptions,
+	.nr_filters = 4,
+	.topic = "cmd/all/hello/sn000000000000/room",
+};
+
+static void fill_pattern(uint8_t *buf, size_t bufsize)
+{
+	uint32_t x = 0x12345678;
+	for (size_t i = 0; i < bufsize; i++) {
+		x = x * 1103515245 + 12345;
+		buf[i] = (uint8_t)(x >> 16);
+	}
+}
+
+static size_t encode_base64(char *dst, const uint8_t *src, size_t len)
+{
+	static const char table[] =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	size_t n = 0;
+
+	for (size_t i = 0; i < len; i += 3) {
+		uint32_t v = (uint32_t)src[i] << 16;
+		if (i + 1 < len) {
+			v |= (uint32_t)src[i+1] << 8;
+		}
+		if (i + 2 < len) {
+			v |= src[i+2];
+		}
+
+		dst[n++] = table[(v >> 18) & 0x3f];
+		dst[n++] = table[(v >> 12) & 0x3f];
+		dst[n++] = i + 1 < len? table[(v >> 6) & 0x3f] : '=';
+		dst[n++] = i + 2 < len? table[v & 0x3f] : '=';
+	}
+
+	return n;
+}
+
+static void prepare_payloads(void)
+{
+	uint8_t raw[OTA_CHUNK_SIZE_LARGE];
+	fill_pattern(raw, sizeof(raw));
+
+	size_t len = encode_base64(ota_chunk_b64, raw, OTA_CHUNK_SIZE);
+	ota_chunk_b64[len] = '\0';
+	len = encode_base64(ota_chunk_b64_large, raw, OTA_CHUNK_SIZE_LARGE);
+	ota_chunk_b64_large[len] = '\0';
+
+	strcpy(ota_chunk_json, CHUNK_JSON_HEAD);
+	strcat(ota_chunk_json, ota_chunk_b64);
+	strcat(ota_chunk_json, CHUNK_JSON_TAIL);
+}
+
+static void setup_once(void *context)
+{
+	static int prepared;
+	(void)context;
+
+	if (!prepared) {
+		prepare_payloads();
+		prepared = 1;
+	}
+}
+
+static void run_jsmn_load(void *context)
+{
+	const struct json_context *p = (const struct json_context *)context;
+	uint8_t mem[JSMN_MEMSIZE];
+
+	jsmn_t *jsmn = jsmn_load(mem, sizeof(mem), p->json, p->len);
+	bench_consume(jsmn);
+}
+
+static void run_jsmn_get(void *context)
+{
+	const struct json_context *p = (const struct json_context *)context;
+	uint8_t mem[JSMN_MEMSIZE];
+	jsmn_value_t value;
+
+	jsmn_t *jsmn = jsmn_load(mem, sizeof(mem), p->json, p->len);
+	for (size_t i = 0; i < p->nr_keys; i++) {
+		jsmn_get(jsmn, &value, p->keys[i]);
+		bench_consume(value.string);
+	}
+}
+
+static void run_json_writer(void *context)
+{
+	char buf[80]; /* PAYLOAD_BUFSIZE in ota.c */
+	(void)context;
+
+	jsmn_t *json = jsmn_create(buf, sizeof(buf));
+	jsmn_add_object(json, NULL);
+	jsmn_add_string(json, "version", "1.2.4");
+	jsmn_add_number(json, "packet_size", OTA_CHUNK_SIZE);
+	jsmn_add_number(json, "index", 42);
+	jsmn_fin_object(json);
+	bench_consume(jsmn_stringify(json));
+}
+
+static void run_base64_decode_overwrite(void *context)
+{
+	struct base64_context *p = (struct base64_context *)context;
+
+	/* decoding is in place, so every call starts from a fresh copy */
+	memcpy(p->buf, p->encoded, p->len);
+	size_t len = base64_decode_overwrite(p->buf, p->len);
+	bench_consume(&len);
+}
+
+static void run_url_decode(void *context)
+{
+	struct url_context *p = (struct url_context *)context;
+	size_t len = url_decode(p->encoded, p->buf, sizeof(p->buf));
+	bench_consume(&len);
+}
+
+static void run_topic_match(void *context)
+{
+	const struct topic_context *p = (const struct topic_context *)context;
+
+	for (size_t i = 0; i < p->nr_filters; i++) {
+		if (mqtt_is_topic_matched(p->filters[i], p->topic)) {
+			bench_consume(p->filters[i]);
+			return;
+		}
+	}
+}
+
+const struct bench_case bench_cases[] = {
+	{ "jsmn_load/version_request", STRLEN(VERSION_REQUEST_JSON),
+		setup_once, run_jsmn_load, &version_request },
+	{ "jsmn_load/data_chunk", CHUNK_JSON_LEN,
+		setup_once, run_jsmn_load, &data_chunk },
+	{ "jsmn_get/version_request", STRLEN(VERSION_REQUEST_JSON),
+		setup_once, run_jsmn_get, &version_request },
+	{ "jsmn_get/data_chunk", CHUNK_JSON_LEN,
+		setup_once, run_jsmn_get, &data_chunk },
+	{ "json_writer/ota_request", 0,
+		NULL, run_json_writer, NULL },
+	{ "base64_decode_overwrite/128", OTA_CHUNK_SIZE,
+		setup_once, run_base64_decode_overwrite, &chunk_b64 },
+	{ "base64_decode_overwrite/512", OTA_CHUNK_SIZE_LARGE,
+		setup_once, run_base64_decode_overwrite, &chunk_b64_large },
+	{ "url_decode/provisioning_form", STRLEN(PROVISIONING_FORM),
+		setup_once, run_url_decode, &provisioning_form },
+	{ "mqtt_topic/exact", 0,
+		NULL, run_topic_match, &topic_exact },
+	{ "mqtt_topic/wildcard", 0,
+		NULL, run_topic_match, &topic_wildcard },
+	{ "mqtt_topic/miss", 0,
+		NULL, run_topic_match, &topic_miss },
+};
+
+const size_t bench_cases_count = sizeof(bench_cases) / sizeof(bench_cases[0]);
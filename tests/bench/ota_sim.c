@@ -0,0 +1,748 @@
+/*
+ * OTA throughput simulator
+ *
+ * Runs the real components/ota and components/dfu code on the host against a
+ * loopback stand-in for the MQTT OTA protocol and a simulated NOR flash. Time
+ * is virtual: link latency, jitter, bandwidth and flash operation costs all
+ * advance a simulated clock, so a transfer that takes minutes on a device
+ * finishes in well under a second here and every run is reproducible for a
+ * given seed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <time.h>
+#include <semaphore.h>
+
+#include "libmcu/logging.h"
+#include "libmcu/compiler.h"
+#include "libmcu/system.h"
+#include "libmcu/timext.h"
+#include "libmcu/metrics.h"
+
+#include "jsmnn.h"
+#include "sha256.h"
+#include "uptime.h"
+#include "dfu/dfu.h"
+#include "ota/ota.h"
+#include "ota/format/json.h"
+
+#if !defined(VERSION)
+#define VERSION				unknown
+#endif
+
+#define FLASH_SECTOR_SIZE		4096
+#define SIM_PARTITION_SIZE		(2 * 1024 * 1024)
+#define SIM_BOOTOPT_SIZE		FLASH_SECTOR_SIZE
+
+#define MAX_INFLIGHT			32
+#define MAX_PAYLOAD_SIZE		2048
+
+/* fixed header(2), topic length(2) and packet identifier(2) of QoS1 */
+#define MQTT_PUBLISH_OVERHEAD		6
+#define MQTT_PUBACK_SIZE		4
+#define MQTT_TOPIC_LEN			44 /* cmd/all/hello/sn.../version/data */
+
+#define USEC_PER_MSEC			1000ULL
+
+static const char *metric_names[] = {
+#define METRICS_DEFINE(id, key)		[id] = #key,
+#include "metrics.def"
+#undef METRICS_DEFINE
+};
+#define METRICS_MAX			\
+	(sizeof(metric_names) / sizeof(metric_names[0]))
+
+uint8_t __bootopt[SIM_BOOTOPT_SIZE]
+	__attribute__((aligned(FLASH_SECTOR_SIZE)));
+uint8_t __app_partition[SIM_PARTITION_SIZE]
+	__attribute__((aligned(FLASH_SECTOR_SIZE)));
+uint8_t __dfu_partition[SIM_PARTITION_SIZE]
+	__attribute__((aligned(FLASH_SECTOR_SIZE)));
+
+struct delivery {
+	bool used;
+	uint64_t at_us;
+	size_t len;
+	char payload[MAX_PAYLOAD_SIZE];
+};
+
+static struct {
+	size_t image_size;
+	unsigned int rtt_ms;
+	unsigned int jitter_ms;
+	double loss;
+	unsigned int bandwidth_kbps; /* 0 for unlimited */
+	unsigned int erase_ms; /* per sector */
+	unsigned int program_us_per_kb;
+	unsigned int read_us_per_kb;
+	uint32_t seed;
+	int verbose;
+	const char *outfile;
+} conf = {
+	.image_size = 256 * 1024,
+	.rtt_ms = 50,
+	.jitter_ms = 10,
+	.loss = 0,
+	.bandwidth_kbps = 1000,
+	.erase_ms = 30,
+	.program_us_per_kb = 2400,
+	.read_us_per_kb = 100,
+	.seed = 1,
+};
+
+static struct {
+	uint64_t now_us;
+	uint32_t random;
+
+	uint8_t *image;
+	size_t image_total;
+
+	void (*rx_handler)(void *context, const void *data, size_t datasize);
+	void *rx_context;
+	unsigned int sem_count;
+	struct delivery inflight[MAX_INFLIGHT];
+
+	int last_index;
+	unsigned int chunk_size;
+	bool rebooted;
+	int result;
+
+	struct {
+		bool set;
+		int32_t value;
+	} metrics[METRICS_MAX];
+
+	struct {
+		uint64_t tx_bytes;
+		uint64_t rx_bytes;
+		unsigned int requests;
+		unsigned int retries;
+		unsigned int timeouts;
+		unsigned int lost;
+		unsigned int reports;
+		unsigned int flash_reads;
+		unsigned int flash_writes;
+		unsigned int flash_erases;
+		unsigned int flash_violations;
+		uint64_t flash_bytes_read;
+		uint64_t flash_bytes_written;
+		uint64_t flash_us;
+	} stats;
+} sim;
+
+static uint32_t get_random(void)
+{
+	uint32_t x = sim.random;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	sim.random = x;
+	return x;
+}
+
+static bool is_lost(void)
+{
+	return conf.loss > 0 &&
+		(double)get_random() / (double)UINT32_MAX < conf.loss;
+}
+
+static uint64_t get_one_way_delay_us(size_t bytes)
+{
+	uint64_t delay = (uint64_t)conf.rtt_ms * USEC_PER_MSEC / 2;
+
+	if (conf.jitter_ms > 0) {
+		delay += get_random() % (conf.jitter_ms * USEC_PER_MSEC);
+	}
+	if (conf.bandwidth_kbps > 0) {
+		delay += (uint64_t)bytes * 8 * USEC_PER_MSEC
+			/ conf.bandwidth_kbps;
+	}
+
+	return delay;
+}
+
+static void spend_flash_time(uint64_t usec)
+{
+	sim.now_us += usec;
+	sim.stats.flash_us += usec;
+}
+
+/*
+ * libmcu and platform stand-ins
+ */
+size_t logging_save(const logging_t type, const void *pc, const void *lr, ...)
+{
+	unused(pc);
+	unused(lr);
+
+	int threshold = conf.verbose > 1? LOGGING_TYPE_DEBUG :
+		conf.verbose > 0? LOGGING_TYPE_INFO : LOGGING_TYPE_ALERT;
+	if ((int)type < threshold) {
+		return 0;
+	}
+
+	va_list ap;
+	va_start(ap, lr);
+	const char *fmt = va_arg(ap, const char *);
+	int len = printf("%10.3f: ", (double)sim.now_us / 1e6);
+	if (fmt != NULL) {
+		len += vprintf(fmt, ap);
+	}
+	len += printf("\n");
+	va_end(ap);
+
+	return (size_t)len;
+}
+
+void metrics_set(metric_key_t key, int32_t val)
+{
+	if ((size_t)key < METRICS_MAX) {
+		sim.metrics[key].set = true;
+		sim.metrics[key].value = val;
+	}
+}
+
+void system_reboot(void)
+{
+	sim.rebooted = true;
+}
+
+unsigned int uptime_get_ms(void)
+{
+	return (unsigned int)(sim.now_us / USEC_PER_MSEC);
+}
+
+void timeout_set(unsigned int *goal, unsigned int msec)
+{
+	*goal = (unsigned int)(sim.now_us / USEC_PER_MSEC) + msec;
+}
+
+bool timeout_is_expired(unsigned int goal)
+{
+	return (int)(goal - (unsigned int)(sim.now_us / USEC_PER_MSEC)) <= 0;
+}
+
+void sleep_ms(unsigned int msec)
+{
+	sim.now_us += msec * USEC_PER_MSEC;
+}
+
+int sem_init(sem_t *sem, int pshared, unsigned int value)
+{
+	unused(sem);
+	unused(pshared);
+	sim.sem_count = value;
+	return 0;
+}
+
+int sem_post(sem_t *sem)
+{
+	unused(sem);
+	sim.sem_count++;
+	return 0;
+}
+
+static struct delivery *get_earliest_delivery(void)
+{
+	struct delivery *earliest = NULL;
+
+	for (int i = 0; i < MAX_INFLIGHT; i++) {
+		struct delivery *p = &sim.inflight[i];
+		if (p->used && (earliest == NULL || p->at_us < earliest->at_us)) {
+			earliest = p;
+		}
+	}
+
+	return earliest;
+}
+
+int sem_timedwait(sem_t *sem, unsigned int timeout_ms)
+{
+	uint64_t deadline = sim.now_us + timeout_ms * USEC_PER_MSEC;
+	unused(sem);
+
+	while (sim.sem_count == 0) {
+		struct delivery *p = get_earliest_delivery();
+
+		if (p == NULL || p->at_us > deadline) {
+			sim.now_us = deadline;
+			sim.stats.timeouts++;
+			return -1;
+		}
+
+		sim.now_us = p->at_us;
+		p->used = false;
+
+		if (sim.rx_handler != NULL) {
+			sim.rx_handler(sim.rx_context, p->payload, p->len);
+		}
+	}
+
+	sim.sem_count--;
+	return 0;
+}
+
+/*
+ * simulated NOR flash
+ */
+static uint64_t get_cost_us(size_t bytes, unsigned int us_per_kb)
+{
+	return (uint64_t)bytes * us_per_kb / 1024;
+}
+
+static bool flash_read(void *buf, const void *addr, size_t bufsize)
+{
+	memcpy(buf, addr, bufsize);
+	sim.stats.flash_reads++;
+	sim.stats.flash_bytes_read += bufsize;
+	spend_flash_time(get_cost_us(bufsize, conf.read_us_per_kb));
+	return true;
+}
+
+static bool flash_write(void *addr, const void *data, size_t datasize)
+{
+	uint8_t *dst = (uint8_t *)addr;
+	const uint8_t *src = (const uint8_t *)data;
+
+	for (size_t i = 0; i < datasize; i++) {
+		if ((dst[i] & src[i]) != src[i]) {
+			sim.stats.flash_violations++;
+		}
+		dst[i] &= src[i]; /* bits only go from 1 to 0 */
+	}
+
+	sim.stats.flash_writes++;
+	sim.stats.flash_bytes_written += datasize;
+	spend_flash_time(get_cost_us(datasize, conf.program_us_per_kb));
+	return true;
+}
+
+static bool flash_erase(void *addr, size_t size)
+{
+	size = ALIGN(size, FLASH_SECTOR_SIZE);
+	memset(addr, 0xff, size);
+
+	unsigned int sectors = (unsigned int)(size / FLASH_SECTOR_SIZE);
+	sim.stats.flash_erases += sectors;
+	spend_flash_time((uint64_t)sectors * conf.erase_ms * USEC_PER_MSEC);
+	return true;
+}
+
+/* the same policy to ports/esp*\/src/dfu_flash.c */
+static bool flash_overwrite(void *addr, const void *data, size_t datasize)
+{
+	if (((uintptr_t)addr & (FLASH_SECTOR_SIZE-1)) == 0) {
+		flash_erase(addr, FLASH_SECTOR_SIZE);
+	}
+
+	return flash_write(addr, data, datasize);
+}
+
+static bool flash_prepare(void *context)
+{
+	unused(context);
+	return true;
+}
+
+static bool flash_finish(void *context)
+{
+	unused(context);
+	return true;
+}
+
+static const dfu_io_t flash_io = {
+	.prepare = flash_prepare,
+	.write = flash_write,
+	.overwrite = flash_overwrite,
+	.read = flash_read,
+	.erase = flash_erase,
+	.finish = flash_finish,
+};
+
+/*
+ * loopback OTA protocol
+ */
+static size_t encode_base64(char *dst, const uint8_t *src, size_t len)
+{
+	static const char table[] =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	size_t n = 0;
+
+	for (size_t i = 0; i < len; i += 3) {
+		uint32_t v = (uint32_t)src[i] << 16;
+		if (i + 1 < len) {
+			v |= (uint32_t)src[i+1] << 8;
+		}
+		if (i + 2 < len) {
+			v |= src[i+2];
+		}
+
+		dst[n++] = table[(v >> 18) & 0x3f];
+		dst[n++] = table[(v >> 12) & 0x3f];
+		dst[n++] = i + 1 < len? table[(v >> 6) & 0x3f] : '=';
+		dst[n++] = i + 2 < len? table[v & 0x3f] : '=';
+	}
+
+	return n;
+}
+
+static size_t get_wire_size(size_t payload_size)
+{
+	return MQTT_PUBLISH_OVERHEAD + MQTT_TOPIC_LEN + payload_size;
+}
+
+static struct delivery *get_free_delivery(void)
+{
+	for (int i = 0; i < MAX_INFLIGHT; i++) {
+		if (!sim.inflight[i].used) {
+			return &sim.inflight[i];
+		}
+	}
+	return NULL;
+}
+
+static void respond(int index, unsigned int chunk_size, uint64_t request_delay)
+{
+	size_t offset = (size_t)(index - 1) * chunk_size;
+	if (index <= 0 || chunk_size == 0 || offset >= sim.image_total) {
+		return;
+	}
+
+	size_t len = sim.image_total - offset;
+	if (len > chunk_size) {
+		len = chunk_size;
+	}
+
+	struct delivery *p = get_free_delivery();
+	if (p == NULL) {
+		fprintf(stderr, "too many messages in flight\n");
+		exit(1);
+	}
+
+	int n = snprintf(p->payload, sizeof(p->payload),
+			"{\"index\":%d,\"data\":\"", index);
+	if (n <= 0 || (size_t)n + (len + 2) / 3 * 4 + 3
+			> sizeof(p->payload)) {
+		fprintf(stderr, "chunk %u does not fit\n", chunk_size);
+		exit(1);
+	}
+	n += (int)encode_base64(&p->payload[n], &sim.image[offset], len);
+	n += snprintf(&p->payload[n], sizeof(p->payload) - (size_t)n, "\"}");
+
+	size_t wire = get_wire_size((size_t)n);
+	sim.stats.rx_bytes += wire;
+	sim.stats.tx_bytes += MQTT_PUBACK_SIZE;
+
+	if (is_lost()) {
+		sim.stats.lost++;
+		return;
+	}
+
+	p->used = true;
+	p->len = (size_t)n;
+	p->at_us = sim.now_us + request_delay + get_one_way_delay_us(wire);
+}
+
+static bool request(void *context, const void *data, size_t datasize)
+{
+	uint8_t mem[384];
+	jsmn_value_t index = { 0, };
+	jsmn_value_t packet_size = { 0, };
+	unused(context);
+
+	jsmn_t *jsmn = jsmn_load(mem, sizeof(mem), data, datasize);
+	if (jsmn == NULL || !jsmn_get(jsmn, &index, "index")
+			|| !jsmn_get(jsmn, &packet_size, "packet_size")) {
+		error("malformed request %.*s", (int)datasize, data);
+		return false;
+	}
+
+	size_t wire = get_wire_size(datasize);
+	sim.stats.tx_bytes += wire;
+	sim.stats.rx_bytes += MQTT_PUBACK_SIZE;
+	sim.stats.requests++;
+	if (index.intval == sim.last_index) {
+		sim.stats.retries++;
+	}
+	sim.last_index = index.intval;
+	sim.chunk_size = packet_size.uintval;
+
+	if (is_lost()) {
+		sim.stats.lost++;
+		return true;
+	}
+
+	respond(index.intval, packet_size.uintval,
+			get_one_way_delay_us(wire));
+
+	return true;
+}
+
+static bool report(void *context, const void *data, size_t datasize)
+{
+	unused(context);
+	info("report %.*s", (int)datasize, data);
+	sim.stats.tx_bytes += get_wire_size(datasize);
+	sim.stats.reports++;
+	return true;
+}
+
+static bool prepare(void *context, void (*rx_handler)(void *context,
+			const void *data, size_t datasize), sem_t *next_chunk)
+{
+	unused(context);
+	sim.rx_handler = rx_handler;
+	sim.rx_context = next_chunk;
+	sim.last_index = 0;
+	memset(sim.inflight, 0, sizeof(sim.inflight));
+	return true;
+}
+
+static bool finish(void *context)
+{
+	unused(context);
+	sim.rx_handler = NULL;
+	return true;
+}
+
+static const ota_protocol_t loopback = {
+	.name = "loopback",
+	.prepare = prepare,
+	.finish = finish,
+	.request = request,
+	.report = report,
+};
+
+/*
+ * image and report
+ */
+static bool build_image(void)
+{
+	/* the layout of dfu_image_t in components/dfu/dfu.c */
+	const size_t header_size = sizeof(uint32_t) + sizeof(size_t)
+		+ SHA256_DIGEST_SIZE;
+	uint32_t magic = DFU_MAGIC;
+
+	sim.image_total = header_size + conf.image_size;
+	if (sim.image_total > SIM_PARTITION_SIZE) {
+		fprintf(stderr, "image too large (max %u)\n",
+				(unsigned int)(SIM_PARTITION_SIZE - header_size));
+		return false;
+	}
+	if ((sim.image = (uint8_t *)malloc(sim.image_total)) == NULL) {
+		return false;
+	}
+
+	uint8_t *data = &sim.image[header_size];
+	for (size_t i = 0; i < conf.image_size; i++) {
+		data[i] = (uint8_t)get_random();
+	}
+
+	sha256_t sha256;
+	sha256_start(&sha256);
+	sha256_update(&sha256, data, conf.image_size);
+
+	memcpy(&sim.image[0], &magic, sizeof(magic));
+	memcpy(&sim.image[sizeof(magic)], &conf.image_size, sizeof(size_t));
+	sha256_finish(&sha256, &sim.image[sizeof(magic) + sizeof(size_t)]);
+
+	return true;
+}
+
+static void on_ota_result(ota_error_t error)
+{
+	sim.result = (int)error;
+}
+
+static uint64_t get_host_time_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static void print_report(bool verified, uint64_t host_us)
+{
+	double secs = (double)sim.now_us / 1e6;
+
+	printf("result          %s (%d)%s\n",
+			sim.rebooted? "success" : "failure", sim.result,
+			sim.rebooted && !verified? " (image mismatch)" : "");
+	printf("image           %zu bytes, chunk %u bytes\n",
+			sim.image_total, sim.chunk_size);
+	printf("link            rtt %ums, jitter %ums, loss %.1f%%, %ukbps\n",
+			conf.rtt_ms, conf.jitter_ms, conf.loss * 100,
+			conf.bandwidth_kbps);
+	printf("wall time       %.3f s simulated, %.3f s host\n",
+			secs, (double)host_us / 1e6);
+	printf("throughput      %.0f B/s\n",
+			secs > 0? (double)sim.image_total / secs : 0);
+	printf("on the wire     %llu bytes tx, %llu bytes rx\n",
+			(unsigned long long)sim.stats.tx_bytes,
+			(unsigned long long)sim.stats.rx_bytes);
+	printf("requests        %u (%u retried, %u timed out, %u lost)\n",
+			sim.stats.requests, sim.stats.retries,
+			sim.stats.timeouts, sim.stats.lost);
+	printf("flash           %u reads, %u writes, %u sector erases, "
+			"%.3f s busy\n",
+			sim.stats.flash_reads, sim.stats.flash_writes,
+			sim.stats.flash_erases,
+			(double)sim.stats.flash_us / 1e6);
+	if (sim.stats.flash_violations) {
+		printf("flash           %u writes over unerased bits\n",
+				sim.stats.flash_violations);
+	}
+
+	for (size_t i = 0; i < METRICS_MAX; i++) {
+		if (sim.metrics[i].set && metric_names[i] != NULL) {
+			printf("metric          %-20s %d\n", metric_names[i],
+					sim.metrics[i].value);
+		}
+	}
+}
+
+static bool write_csv(const char *path, bool verified, uint64_t host_us)
+{
+	FILE *fp = fopen(path, "a");
+	if (fp == NULL) {
+		perror(path);
+		return false;
+	}
+
+	if (ftell(fp) == 0) {
+		fprintf(fp, "version,image_size,chunk_size,rtt_ms,jitter_ms,"
+				"loss,bandwidth_kbps,result,sim_time_ms,"
+				"host_time_ms,tx_bytes,rx_bytes,requests,"
+				"retries,timeouts,lost,flash_reads,"
+				"flash_writes,flash_erases,flash_busy_ms\n");
+	}
+
+	fprintf(fp, "%s,%zu,%u,%u,%u,%.4f,%u,%s,%llu,%llu,%llu,%llu,"
+			"%u,%u,%u,%u,%u,%u,%u,%llu\n",
+			def2str(VERSION), sim.image_total, sim.chunk_size,
+			conf.rtt_ms, conf.jitter_ms, conf.loss,
+			conf.bandwidth_kbps,
+			sim.rebooted && verified? "success" : "failure",
+			(unsigned long long)(sim.now_us / USEC_PER_MSEC),
+			(unsigned long long)(host_us / USEC_PER_MSEC),
+			(unsigned long long)sim.stats.tx_bytes,
+			(unsigned long long)sim.stats.rx_bytes,
+			sim.stats.requests, sim.stats.retries,
+			sim.stats.timeouts, sim.stats.lost,
+			sim.stats.flash_reads, sim.stats.flash_writes,
+			sim.stats.flash_erases,
+			(unsigned long long)(sim.stats.flash_us
+				/ USEC_PER_MSEC));
+
+	fclose(fp);
+	return true;
+}
+
+static void usage(const char *progname)
+{
+	fprintf(stderr, "usage: %s [options]\n"
+		"  --size BYTES        firmware image size (%zu)\n"
+		"  --rtt MSEC          round-trip time (%u)\n"
+		"  --jitter MSEC       one-way jitter upper bound (%u)\n"
+		"  --loss PERCENT      message loss in each direction (%.1f)\n"
+		"  --bandwidth KBPS    link bandwidth, 0 for unlimited (%u)\n"
+		"  --erase MSEC        flash sector erase time (%u)\n"
+		"  --program USEC      flash program time per KiB (%u)\n"
+		"  --read USEC         flash read time per KiB (%u)\n"
+		"  --seed N            random seed (%u)\n"
+		"  -o FILE             append a CSV line to FILE\n"
+		"  -v                  verbose, repeat for debug logs\n",
+		progname, conf.image_size, conf.rtt_ms, conf.jitter_ms,
+		conf.loss * 100, conf.bandwidth_kbps, conf.erase_ms,
+		conf.program_us_per_kb, conf.read_us_per_kb, conf.seed);
+}
+
+static bool parse_args(int argc, char **argv)
+{
+	for (int i = 1; i < argc; i++) {
+		const char *opt = argv[i];
+		const char *val = i + 1 < argc? argv[i+1] : NULL;
+
+		if (strcmp(opt, "-v") == 0) {
+			conf.verbose++;
+			continue;
+		} else if (strcmp(opt, "-vv") == 0) {
+			conf.verbose += 2;
+			continue;
+		} else if (val == NULL) {
+			return false;
+		} else if (strcmp(opt, "--size") == 0) {
+			conf.image_size = strtoul(val, NULL, 0);
+		} else if (strcmp(opt, "--rtt") == 0) {
+			conf.rtt_ms = (unsigned int)strtoul(val, NULL, 0);
+		} else if (strcmp(opt, "--jitter") == 0) {
+			conf.jitter_ms = (unsigned int)strtoul(val, NULL, 0);
+		} else if (strcmp(opt, "--loss") == 0) {
+			conf.loss = strtod(val, NULL) / 100;
+		} else if (strcmp(opt, "--bandwidth") == 0) {
+			conf.bandwidth_kbps = (unsigned int)strtoul(val, NULL, 0);
+		} else if (strcmp(opt, "--erase") == 0) {
+			conf.erase_ms = (unsigned int)strtoul(val, NULL, 0);
+		} else if (strcmp(opt, "--program") == 0) {
+			conf.program_us_per_kb =
+				(unsigned int)strtoul(val, NULL, 0);
+		} else if (strcmp(opt, "--read") == 0) {
+			conf.read_us_per_kb = (unsigned int)strtoul(val, NULL, 0);
+		} else if (strcmp(opt, "--seed") == 0) {
+			conf.seed = (uint32_t)strtoul(val, NULL, 0);
+		} else if (strcmp(opt, "-o") == 0) {
+			conf.outfile = val;
+		} else {
+			return false;
+		}
+		i++;
+	}
+
+	return conf.seed != 0;
+}
+
+int main(int argc, char **argv)
+{
+	if (!parse_args(argc, argv)) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	sim.random = conf.seed;
+	if (!build_image()) {
+		return 2;
+	}
+
+	memset(__bootopt, 0xff, sizeof(__bootopt));
+	memset(__app_partition, 0xff, sizeof(__app_partition));
+	memset(__dfu_partition, 0xff, sizeof(__dfu_partition));
+
+	char msg[128];
+	int len = snprintf(msg, sizeof(msg), "{\"type\":\"request\","
+			"\"version\":\"99.0.0\",\"size\":%zu,\"force\":false}",
+			sim.image_total);
+
+	dfu_init(&flash_io);
+	ota_register_result_handler(on_ota_result);
+	ota_init(&sim, &loopback, ota_json_parser());
+
+	uint64_t t0 = get_host_time_us();
+	ota_start(&sim, msg, (size_t)len);
+	uint64_t host_us = get_host_time_us() - t0;
+
+	bool verified = memcmp(__dfu_partition, sim.image,
+			sim.image_total) == 0;
+
+	print_report(verified, host_us);
+	if (conf.outfile != NULL) {
+		write_csv(conf.outfile, verified, host_us);
+	}
+
+	free(sim.image);
+
+	return sim.rebooted && verified? 0 : 1;
+}
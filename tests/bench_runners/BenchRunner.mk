@@ -0,0 +1,53 @@
+ifndef SILENCE
+SILENCE = @
+endif
+
+CC ?= gcc
+
+BENCH_HARNESS ?= bench/bench.c
+BENCH_SRC_FILES += $(BENCH_HARNESS)
+INCLUDE_DIRS += bench
+
+BENCH_OBJS_DIR := $(BUILDIR)/bench/$(COMPONENT_NAME)
+BENCH_TARGET := $(BUILDIR)/$(COMPONENT_NAME)_bench
+BENCH_OUTPUT ?= $(BUILDIR)/$(COMPONENT_NAME)_bench.csv
+BENCH_ARGS ?=
+
+BENCH_CFLAGS += \
+	-std=gnu99 \
+	-O2 \
+	-g \
+	-Wall \
+	-Wextra \
+	-Wno-unused-parameter \
+	-DVERSION=$(or $(VERSION),unknown)
+BENCH_LDFLAGS += -lpthread
+
+BENCH_OBJS := $(addprefix $(BENCH_OBJS_DIR)/, \
+	$(subst ../,,$(SRC_FILES:.c=.o) $(BENCH_SRC_FILES:.c=.o)))
+
+.PHONY: all
+all: start
+	$(BENCH_TARGET) -o $(BENCH_OUTPUT) $(BENCH_ARGS)
+
+.PHONY: start
+start: $(BENCH_TARGET)
+
+$(BENCH_TARGET): $(BENCH_OBJS)
+	$(SILENCE)$(CC) -o $@ $^ $(BENCH_LDFLAGS)
+
+define compile_rule
+$(BENCH_OBJS_DIR)/$(subst ../,,$(1:.c=.o)): $(1)
+	@mkdir -p $$(@D)
+	$(SILENCE)$(CC) -o $$@ -c $$< -MMD \
+		$$(addprefix -I, $$(INCLUDE_DIRS)) \
+		$$(BENCH_CPPFLAGS) $$(BENCH_CFLAGS)
+endef
+$(foreach src, $(SRC_FILES) $(BENCH_SRC_FILES), \
+	$(eval $(call compile_rule,$(src))))
+
+-include $(BENCH_OBJS:.o=.d)
+
+.PHONY: clean
+clean:
+	rm -rf $(BENCH_OBJS_DIR) $(BENCH_TARGET)
@@ -0,0 +1,17 @@
+COMPONENT_NAME = hotpath
+
+LIBMCU_ROOT ?= ../external/libmcu
+
+SRC_FILES = \
+	../src/jsmnn.c \
+	../src/url.c \
+	../src/mqtt_topic.c \
+	$(LIBMCU_ROOT)/components/common/src/base64.c
+
+BENCH_SRC_FILES = \
+	bench/bench_hotpath.c
+
+INCLUDE_DIRS += \
+	$(LIBMCU_ROOT)/components/common/include
+
+include bench_runners/BenchRunner.mk
@@ -0,0 +1,35 @@
+# OTA throughput simulator. It brings its own main(), so the common bench
+# harness is left out. Compile-time OTA defaults can be overridden with e.g.
+# BENCH_CPPFLAGS=-DDEFAULT_FILE_CHUNK_SIZE=512 and the link model with
+# BENCH_ARGS="--rtt 120 --loss 2".
+COMPONENT_NAME = ota_sim
+
+LIBMCU_ROOT ?= ../external/libmcu
+
+BENCH_HARNESS :=
+
+SRC_FILES = \
+	../components/ota/ota.c \
+	../components/ota/format/json.c \
+	../components/dfu/dfu.c \
+	../src/jsmnn.c \
+	../src/histogram.c \
+	$(LIBMCU_ROOT)/components/common/src/base64.c \
+	stubs/jobpool.c \
+	stubs/sha256.c
+
+BENCH_SRC_FILES = \
+	bench/ota_sim.c
+
+INCLUDE_DIRS += \
+	../src \
+	../components/ota/include \
+	../components/dfu/include \
+	$(LIBMCU_ROOT)/components/common/include \
+	$(LIBMCU_ROOT)/components/common/include/libmcu/posix \
+	$(LIBMCU_ROOT)/components/jobqueue/include \
+	$(LIBMCU_ROOT)/examples
+
+BENCH_CPPFLAGS += -DVERSION_TAG=v1.2.3
+
+include bench_runners/BenchRunner.mk
@@ -0,0 +1,157 @@
+#include "fake_flash.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+static struct {
+	FILE *fp;
+	size_t size;
+	size_t sector_size;
+	size_t power_left;
+	bool power_cut;
+	unsigned int erase_count;
+	unsigned int write_count;
+} m;
+
+static bool is_range_valid(uintptr_t addr, size_t size)
+{
+	return m.fp != NULL && addr + size <= m.size;
+}
+
+static bool read_flash(void *buf, const void *addr, size_t bufsize)
+{
+	uintptr_t offset = (uintptr_t)addr;
+
+	if (!is_range_valid(offset, bufsize)
+			|| fseek(m.fp, (long)offset, SEEK_SET) != 0) {
+		return false;
+	}
+
+	return fread(buf, 1, bufsize, m.fp) == bufsize;
+}
+
+static bool write_flash(void *addr, const void *data, size_t datasize)
+{
+	uintptr_t offset = (uintptr_t)addr;
+	const uint8_t *src = (const uint8_t *)data;
+	uint8_t byte;
+
+	if (!is_range_valid(offset, datasize)) {
+		return false;
+	}
+
+	m.write_count++;
+
+	for (size_t i = 0; i < datasize; i++) {
+		if (m.power_cut) {
+			if (m.power_left == 0) {
+				return false;
+			}
+			m.power_left--;
+		}
+		if (!read_flash(&byte, (const void *)(offset + i), 1)
+				|| fseek(m.fp, (long)(offset + i), SEEK_SET)) {
+			return false;
+		}
+		byte &= src[i];
+		if (fwrite(&byte, 1, 1, m.fp) != 1) {
+			return false;
+		}
+	}
+
+	fflush(m.fp);
+
+	return true;
+}
+
+static bool erase_flash(void *addr, size_t size)
+{
+	uintptr_t offset = (uintptr_t)addr;
+	uint8_t buf[256];
+
+	offset -= offset % m.sector_size;
+	size = (size + m.sector_size - 1) / m.sector_size * m.sector_size;
+
+	if (!is_range_valid(offset, size)
+			|| fseek(m.fp, (long)offset, SEEK_SET) != 0) {
+		return false;
+	}
+
+	m.erase_count += (unsigned int)(size / m.sector_size);
+
+	memset(buf, 0xff, sizeof(buf));
+	for (size_t i = 0; i < size; i += sizeof(buf)) {
+		size_t len = size - i < sizeof(buf)? size - i : sizeof(buf);
+		if (fwrite(buf, 1, len, m.fp) != len) {
+			return false;
+		}
+	}
+
+	fflush(m.fp);
+
+	return true;
+}
+
+const dfu_io_t *fake_flash_open(const char *path, size_t size,
+		size_t sector_size)
+{
+	static const dfu_io_t io = {
+		.write = write_flash,
+		.read = read_flash,
+		.erase = erase_flash,
+	};
+
+	memset(&m, 0, sizeof(m));
+	m.size = size;
+	m.sector_size = sector_size;
+
+	if ((m.fp = fopen(path, "r+b")) != NULL) {
+		fseek(m.fp, 0, SEEK_END);
+		if ((size_t)ftell(m.fp) >= size) {
+			return &io;
+		}
+		fclose(m.fp);
+	}
+
+	if ((m.fp = fopen(path, "w+b")) == NULL) {
+		return NULL;
+	}
+	if (!erase_flash((void *)0, size)) {
+		fake_flash_close();
+		return NULL;
+	}
+	m.erase_count = 0;
+
+	return &io;
+}
+
+void fake_flash_close(void)
+{
+	if (m.fp != NULL) {
+		fclose(m.fp);
+		m.fp = NULL;
+	}
+}
+
+void fake_flash_cut_power_after(size_t bytes)
+{
+	m.power_cut = true;
+	m.power_left = bytes;
+}
+
+void fake_flash_restore_power(void)
+{
+	m.power_cut = false;
+}
+
+unsigned int fake_flash_erase_count(void)
+{
+	return m.erase_count;
+}
+
+unsigned int fake_flash_write_count(void)
+{
+	return m.write_count;
+}
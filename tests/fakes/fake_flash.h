@@ -0,0 +1,29 @@
+#ifndef FAKE_FLASH_H
+#define FAKE_FLASH_H
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include "dfu/io.h"
+
+/* NOR flash backed by a file. Addresses are offsets into the file. A write
+ * can only clear bits and an erase sets the sector back to 0xff. The content
+ * is kept when the file exists already. */
+const dfu_io_t *fake_flash_open(const char *path, size_t size,
+		size_t sector_size);
+void fake_flash_close(void);
+/* writes fail once the given number of bytes got written, leaving the last
+ * one partially written as a power loss does */
+void fake_flash_cut_power_after(size_t bytes);
+/* writes go through again as if the device came back without a reboot */
+void fake_flash_restore_power(void);
+unsigned int fake_flash_erase_count(void);
+unsigned int fake_flash_write_count(void);
+
+#if defined(__cplusplus)
+}
+#endif
+
+#endif /* FAKE_FLASH_H */
@@ -0,0 +1,162 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/TestHarness_c.h"
+
+#include <stdint.h>
+#include <string.h>
+
+extern "C" {
+#include "apptimer.h"
+#include "uptime.h"
+}
+
+static struct {
+	unsigned int now;
+	unsigned int armed;
+	int nr_armed;
+	int fired[4];
+	apptimer_t *rearm;
+	unsigned int rearm_delay;
+} fake;
+
+unsigned int uptime_get_ms(void)
+{
+	return fake.now;
+}
+
+bool apptimer_hw_init(void)
+{
+	return true;
+}
+
+void apptimer_hw_arm(unsigned int delay_ms)
+{
+	fake.armed = delay_ms;
+	fake.nr_armed++;
+}
+
+static void fired(void *context)
+{
+	fake.fired[(intptr_t)context]++;
+}
+
+static void fired_and_rearm(void *context)
+{
+	fired(context);
+	apptimer_start(fake.rearm, fake.rearm_delay, fired_and_rearm, context);
+}
+
+TEST_GROUP(apptimer) {
+	apptimer_t timers[4];
+
+	void setup(void) {
+		memset(&fake, 0, sizeof(fake));
+		memset(timers, 0, sizeof(timers));
+		fake.now = 1000;
+		apptimer_init();
+	}
+	void teardown() {
+	}
+
+	unsigned int process_at(unsigned int ms) {
+		fake.now = ms;
+		return apptimer_process(ms);
+	}
+};
+
+TEST(apptimer, start_ShouldArmHardwareTimer) {
+	CHECK(apptimer_start(&timers[0], 100, fired, (void *)0));
+	LONGS_EQUAL(100, fake.armed);
+	CHECK(apptimer_is_pending(&timers[0]));
+}
+
+TEST(apptimer, start_ShouldRearm_OnlyWhenEarlierThanArmed) {
+	apptimer_start(&timers[0], 100, fired, (void *)0);
+	apptimer_start(&timers[1], 200, fired, (void *)1);
+	LONGS_EQUAL(1, fake.nr_armed);
+	apptimer_start(&timers[2], 50, fired, (void *)2);
+	LONGS_EQUAL(2, fake.nr_armed);
+	LONGS_EQUAL(50, fake.armed);
+}
+
+TEST(apptimer, process_ShouldRunExpiredOnly) {
+	apptimer_start(&timers[0], 100, fired, (void *)0);
+	apptimer_start(&timers[1], 300, fired, (void *)1);
+
+	LONGS_EQUAL(200, process_at(1100));
+	LONGS_EQUAL(1, fake.fired[0]);
+	LONGS_EQUAL(0, fake.fired[1]);
+	CHECK(!apptimer_is_pending(&timers[0]));
+
+	LONGS_EQUAL(0, process_at(1300));
+	LONGS_EQUAL(1, fake.fired[1]);
+}
+
+TEST(apptimer, process_ShouldArmHardwareTimer_ForNextExpiry) {
+	apptimer_start(&timers[0], 100, fired, (void *)0);
+	apptimer_start(&timers[1], 300, fired, (void *)1);
+	process_at(1100);
+	LONGS_EQUAL(2, fake.nr_armed);
+	LONGS_EQUAL(200, fake.armed);
+	process_at(1300);
+	LONGS_EQUAL(2, fake.nr_armed);
+}
+
+TEST(apptimer, process_ShouldRunTimer_WhenLaterThanWheelRevolution) {
+	apptimer_start(&timers[0], 3600000, fired, (void *)0);
+
+	for (unsigned int t = 1000; t < 1000 + 3600000; t += 500) {
+		process_at(t);
+	}
+	LONGS_EQUAL(0, fake.fired[0]);
+
+	LONGS_EQUAL(0, process_at(1000 + 3600000));
+	LONGS_EQUAL(1, fake.fired[0]);
+}
+
+TEST(apptimer, process_ShouldRunTimer_WhenProcessedLate) {
+	apptimer_start(&timers[0], 10, fired, (void *)0);
+	apptimer_start(&timers[1], 20000, fired, (void *)1);
+	process_at(100000);
+	LONGS_EQUAL(1, fake.fired[0]);
+	LONGS_EQUAL(1, fake.fired[1]);
+}
+
+TEST(apptimer, stop_ShouldCancelTimer) {
+	apptimer_start(&timers[0], 100, fired, (void *)0);
+	CHECK(apptimer_stop(&timers[0]));
+	CHECK(!apptimer_stop(&timers[0]));
+	LONGS_EQUAL(0, process_at(1200));
+	LONGS_EQUAL(0, fake.fired[0]);
+}
+
+TEST(apptimer, start_ShouldRestart_WhenPending) {
+	apptimer_start(&timers[0], 100, fired, (void *)0);
+	apptimer_start(&timers[0], 500, fired, (void *)0);
+	process_at(1100);
+	LONGS_EQUAL(0, fake.fired[0]);
+	process_at(1500);
+	LONGS_EQUAL(1, fake.fired[0]);
+}
+
+TEST(apptimer, process_ShouldNotRunRearmedTimerAgain_WhenDelayZero) {
+	fake.rearm = &timers[0];
+	fake.rearm_delay = 0;
+	apptimer_start(&timers[0], 10, fired_and_rearm, (void *)0);
+
+	LONGS_EQUAL(1, process_at(1010));
+	LONGS_EQUAL(1, fake.fired[0]);
+	CHECK(apptimer_is_pending(&timers[0]));
+
+	process_at(1011);
+	LONGS_EQUAL(2, fake.fired[0]);
+}
+
+TEST(apptimer, process_ShouldHandleUptimeWrapAround) {
+	fake.now = 0xfffffff0u;
+	apptimer_init();
+	apptimer_start(&timers[0], 0x20, fired, (void *)0);
+	process_at(0x8);
+	LONGS_EQUAL(0, fake.fired[0]);
+	process_at(0x10);
+	LONGS_EQUAL(1, fake.fired[0]);
+}
@@ -0,0 +1,114 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/TestHarness_c.h"
+
+#include <string.h>
+
+extern "C" {
+#include "debounce.h"
+}
+
+static struct {
+	int levels[2];
+	int changes;
+	unsigned int channel;
+	bool pressed;
+} fake;
+
+static int get_level(unsigned int channel)
+{
+	return fake.levels[channel];
+}
+
+static void changed(unsigned int channel, bool pressed, uint32_t usec)
+{
+	fake.changes++;
+	fake.channel = channel;
+	fake.pressed = pressed;
+}
+
+TEST_GROUP(debounce) {
+	struct debounce_queue queue;
+
+	void setup(void) {
+		memset(&fake, 0, sizeof(fake));
+		memset(&queue, 0, sizeof(queue));
+		debounce_init(2, changed, get_level);
+	}
+	void teardown() {
+	}
+
+	void edge(uint8_t channel, bool pressed, uint32_t usec) {
+		fake.levels[channel] = pressed;
+		debounce_push(&queue, channel, pressed, usec);
+	}
+};
+
+TEST(debounce, process_ShouldReportPress_OnTheFirstEdge) {
+	edge(0, true, 1000);
+	CHECK(debounce_process(&queue, 1000) > 0);
+	LONGS_EQUAL(1, fake.changes);
+	LONGS_EQUAL(0, fake.channel);
+	CHECK(fake.pressed);
+}
+
+TEST(debounce, process_ShouldIgnoreBounce_WithinLockout) {
+	edge(1, true, 1000);
+	edge(1, false, 1200);
+	edge(1, true, 1500);
+	debounce_process(&queue, 2000);
+	LONGS_EQUAL(1, fake.changes);
+	LONGS_EQUAL(1, fake.channel);
+}
+
+TEST(debounce, process_ShouldReportRelease_AfterLockout) {
+	edge(0, true, 1000);
+	debounce_process(&queue, 1000);
+	edge(0, false, 100000);
+	LONGS_EQUAL(0, debounce_process(&queue, 100000 + 30000));
+	LONGS_EQUAL(2, fake.changes);
+	CHECK_FALSE(fake.pressed);
+}
+
+TEST(debounce, process_ShouldCatchUpWithLevel_WhenLastEdgeFellInLockout) {
+	edge(0, true, 1000);
+	edge(0, false, 5000); /* a quick tap */
+	uint32_t wait = debounce_process(&queue, 6000);
+	LONGS_EQUAL(30000 - 5000, wait);
+	LONGS_EQUAL(1, fake.changes);
+
+	debounce_process(&queue, 6000 + wait);
+	LONGS_EQUAL(2, fake.changes);
+	CHECK_FALSE(fake.pressed);
+}
+
+TEST(debounce, process_ShouldReturnZero_WhenAllSettled) {
+	LONGS_EQUAL(0, debounce_process(&queue, 1000));
+	edge(0, true, 1000);
+	debounce_process(&queue, 1000);
+	LONGS_EQUAL(0, debounce_process(&queue, 1000 + 30000));
+	LONGS_EQUAL(1, fake.changes);
+}
+
+TEST(debounce, process_ShouldHandleTimerWrapAround) {
+	edge(0, true, 0xfffffff0u);
+	debounce_process(&queue, 0xfffffff0u);
+	edge(0, false, 0x10u);
+	debounce_process(&queue, 0x10u);
+	LONGS_EQUAL(1, fake.changes);
+}
+
+TEST(debounce, push_ShouldDrop_WhenQueueIsFull) {
+	for (uint32_t i = 0; i < DEBOUNCE_QUEUE_LEN; i++) {
+		CHECK(debounce_push(&queue, 0, i & 1, i));
+	}
+	CHECK_FALSE(debounce_push(&queue, 0, true, 100));
+	LONGS_EQUAL(1, queue.dropped);
+	debounce_process(&queue, 100);
+	CHECK(debounce_push(&queue, 0, true, 100));
+}
+
+TEST(debounce, process_ShouldIgnoreUnknownChannel) {
+	debounce_push(&queue, 5, true, 1000);
+	debounce_process(&queue, 1000);
+	LONGS_EQUAL(0, fake.changes);
+}
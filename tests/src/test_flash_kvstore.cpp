@@ -0,0 +1,166 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/TestHarness_c.h"
+
+#include <stdio.h>
+#include <string.h>
+
+extern "C" {
+#include "flash_kvstore.h"
+#include "fake_flash.h"
+}
+
+#define FLASH_FILE			"flash_kvstore_test.bin"
+#define SECTOR_SIZE			256
+#define NR_SECTORS			4
+
+TEST_GROUP(flash_kvstore) {
+	const dfu_io_t *io;
+	kvstore_t *kvstore;
+
+	void setup(void) {
+		remove(FLASH_FILE);
+		io = fake_flash_open(FLASH_FILE,
+				SECTOR_SIZE * NR_SECTORS, SECTOR_SIZE);
+		kvstore = flash_kvstore_new(io, 0, SECTOR_SIZE, NR_SECTORS);
+		CHECK(kvstore != NULL);
+	}
+	void teardown() {
+		if (kvstore != NULL) {
+			flash_kvstore_delete(kvstore);
+		}
+		fake_flash_close();
+		remove(FLASH_FILE);
+	}
+
+	void reopen(void) {
+		flash_kvstore_delete(kvstore);
+		fake_flash_close();
+		io = fake_flash_open(FLASH_FILE,
+				SECTOR_SIZE * NR_SECTORS, SECTOR_SIZE);
+		kvstore = flash_kvstore_new(io, 0, SECTOR_SIZE, NR_SECTORS);
+		CHECK(kvstore != NULL);
+	}
+	size_t write(const char *key, uint32_t value) {
+		return kvstore_write(kvstore, key, &value, sizeof(value));
+	}
+	uint32_t read(const char *key) {
+		uint32_t value = 0;
+		kvstore_read(kvstore, key, &value, sizeof(value));
+		return value;
+	}
+};
+
+TEST(flash_kvstore, new_ShouldFail_WhenLessThanTwoSectors) {
+	POINTERS_EQUAL(NULL, flash_kvstore_new(io, 0, SECTOR_SIZE, 1));
+}
+
+TEST(flash_kvstore, read_ShouldReturnWhatWritten) {
+	const char value[] = "value";
+	char buf[sizeof(value)];
+	LONGS_EQUAL(sizeof(value), kvstore_write(kvstore, "key", value,
+				sizeof(value)));
+	LONGS_EQUAL(sizeof(value), kvstore_read(kvstore, "key", buf,
+				sizeof(buf)));
+	STRCMP_EQUAL(value, buf);
+}
+
+TEST(flash_kvstore, read_ShouldReturnZero_WhenKeyNotFound) {
+	uint32_t value;
+	LONGS_EQUAL(0, kvstore_read(kvstore, "key", &value, sizeof(value)));
+}
+
+TEST(flash_kvstore, read_ShouldReturnZero_WhenBufferIsSmallerThanValue) {
+	uint8_t buf[1];
+	write("key", 1);
+	LONGS_EQUAL(0, kvstore_read(kvstore, "key", buf, sizeof(buf)));
+}
+
+TEST(flash_kvstore, read_ShouldReturnTheLatest_WhenWrittenMoreThanOnce) {
+	write("key", 1);
+	write("key", 2);
+	LONGS_EQUAL(2, read("key"));
+	LONGS_EQUAL(1, flash_kvstore_count(kvstore));
+}
+
+TEST(flash_kvstore, write_ShouldFail_WhenKeyIsTooLong) {
+	LONGS_EQUAL(0, write("0123456789abcdef", 1));
+	LONGS_EQUAL(4, write("0123456789abcde", 1));
+}
+
+TEST(flash_kvstore, write_ShouldNotTouchFlash_WhenValueUnchanged) {
+	write("key", 1);
+	unsigned int count = fake_flash_write_count();
+	LONGS_EQUAL(4, write("key", 1));
+	LONGS_EQUAL(count, fake_flash_write_count());
+}
+
+TEST(flash_kvstore, remove_ShouldDeleteKey) {
+	write("key", 1);
+	CHECK(flash_kvstore_remove(kvstore, "key"));
+	uint32_t value;
+	LONGS_EQUAL(0, kvstore_read(kvstore, "key", &value, sizeof(value)));
+	LONGS_EQUAL(0, flash_kvstore_count(kvstore));
+}
+
+TEST(flash_kvstore, new_ShouldRebuildIndex_WhenReopened) {
+	write("a", 1);
+	write("b", 2);
+	write("a", 3);
+	write("c", 4);
+	flash_kvstore_remove(kvstore, "c");
+	reopen();
+	LONGS_EQUAL(2, flash_kvstore_count(kvstore));
+	LONGS_EQUAL(3, read("a"));
+	LONGS_EQUAL(2, read("b"));
+}
+
+TEST(flash_kvstore, write_ShouldCollectGarbage_WhenSectorsRunOut) {
+	write("fixed", 0xdeadbeef);
+	for (uint32_t i = 0; i < 1000; i++) {
+		LONGS_EQUAL(4, write("counter", i));
+	}
+	LONGS_EQUAL(999, read("counter"));
+	LONGS_EQUAL(0xdeadbeef, read("fixed"));
+	CHECK(fake_flash_erase_count() > 0);
+	reopen();
+	LONGS_EQUAL(999, read("counter"));
+	LONGS_EQUAL(0xdeadbeef, read("fixed"));
+}
+
+TEST(flash_kvstore, write_ShouldFail_WhenLiveRecordsFillUpFlash) {
+	uint8_t value[200];
+	memset(value, 0xa5, sizeof(value));
+	LONGS_EQUAL(sizeof(value), kvstore_write(kvstore, "a", value,
+				sizeof(value)));
+	LONGS_EQUAL(sizeof(value), kvstore_write(kvstore, "b", value,
+				sizeof(value)));
+	LONGS_EQUAL(sizeof(value), kvstore_write(kvstore, "c", value,
+				sizeof(value)));
+	LONGS_EQUAL(0, kvstore_write(kvstore, "d", value, sizeof(value)));
+	reopen();
+	LONGS_EQUAL(3, flash_kvstore_count(kvstore));
+}
+
+TEST(flash_kvstore, new_ShouldDropTornRecord_WhenPowerLostWhileWriting) {
+	write("a", 1);
+	fake_flash_cut_power_after(10);
+	LONGS_EQUAL(0, write("b", 2));
+	reopen();
+	LONGS_EQUAL(1, read("a"));
+	uint32_t value;
+	LONGS_EQUAL(0, kvstore_read(kvstore, "b", &value, sizeof(value)));
+	LONGS_EQUAL(4, write("b", 2));
+	reopen();
+	LONGS_EQUAL(2, read("b"));
+}
+
+TEST(flash_kvstore, write_ShouldKeepLaterRecords_WhenWriteFailedBefore) {
+	write("a", 1);
+	fake_flash_cut_power_after(10);
+	LONGS_EQUAL(0, write("b", 2));
+	fake_flash_restore_power();
+	LONGS_EQUAL(4, write("c", 3));
+	reopen();
+	LONGS_EQUAL(1, read("a"));
+	LONGS_EQUAL(3, read("c"));
+}
@@ -0,0 +1,131 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/TestHarness_c.h"
+
+#include <string.h>
+
+extern "C" {
+#include "gesture.h"
+}
+
+#define MS				1000u
+
+static struct {
+	int counts[GESTURE_MAX];
+	gesture_t last;
+	unsigned int channel;
+	int total;
+} fake;
+
+static void recognized(unsigned int channel, gesture_t gesture)
+{
+	fake.counts[gesture]++;
+	fake.last = gesture;
+	fake.channel = channel;
+	fake.total++;
+}
+
+TEST_GROUP(gesture) {
+	uint32_t now;
+
+	void setup(void) {
+		memset(&fake, 0, sizeof(fake));
+		now = 1000 * MS;
+		gesture_init(2, NULL, recognized);
+	}
+	void teardown() {
+	}
+
+	void press(unsigned int channel, uint32_t held_ms) {
+		gesture_feed(channel, true, now);
+		step(held_ms);
+		gesture_feed(channel, false, now);
+	}
+	void step(uint32_t ms) {
+		for (uint32_t i = 0; i < ms; i += 10) {
+			now += 10 * MS;
+			gesture_poll(now);
+		}
+	}
+};
+
+TEST(gesture, feed_ShouldReportPressAtOnce) {
+	gesture_feed(1, true, now);
+	LONGS_EQUAL(1, fake.counts[GESTURE_PRESS]);
+	LONGS_EQUAL(1, fake.channel);
+}
+
+TEST(gesture, poll_ShouldReportClick_AfterGap) {
+	press(0, 100);
+	LONGS_EQUAL(0, fake.counts[GESTURE_CLICK]);
+	step(300);
+	LONGS_EQUAL(1, fake.counts[GESTURE_CLICK]);
+	LONGS_EQUAL(0, gesture_poll(now));
+}
+
+TEST(gesture, poll_ShouldReportDoubleClick) {
+	press(0, 80);
+	step(100);
+	press(0, 80);
+	step(300);
+	LONGS_EQUAL(0, fake.counts[GESTURE_CLICK]);
+	LONGS_EQUAL(1, fake.counts[GESTURE_DOUBLE_CLICK]);
+	LONGS_EQUAL(2, fake.counts[GESTURE_PRESS]);
+}
+
+TEST(gesture, feed_ShouldReportTripleClick_OnThirdRelease) {
+	press(0, 80);
+	step(100);
+	press(0, 80);
+	step(100);
+	press(0, 80);
+	LONGS_EQUAL(GESTURE_TRIPLE_CLICK, fake.last);
+	step(500);
+	LONGS_EQUAL(0, fake.counts[GESTURE_CLICK]);
+	LONGS_EQUAL(0, fake.counts[GESTURE_DOUBLE_CLICK]);
+}
+
+TEST(gesture, poll_ShouldReportTwoClicks_WhenGapIsTooLong) {
+	press(0, 80);
+	step(400);
+	press(0, 80);
+	step(400);
+	LONGS_EQUAL(2, fake.counts[GESTURE_CLICK]);
+}
+
+TEST(gesture, poll_ShouldReportLongPressAndRepeat_WhenHeld) {
+	press(0, 1500);
+	LONGS_EQUAL(1, fake.counts[GESTURE_LONG_PRESS]);
+	LONGS_EQUAL(3, fake.counts[GESTURE_HOLD_REPEAT]); /* 1000,1200,1400 */
+	step(500);
+	LONGS_EQUAL(0, fake.counts[GESTURE_CLICK]);
+}
+
+TEST(gesture, poll_ShouldReturnTimeToNextDeadline) {
+	gesture_feed(0, true, now);
+	LONGS_EQUAL(800 * MS, gesture_poll(now));
+	gesture_feed(0, false, now + 100 * MS);
+	LONGS_EQUAL(300 * MS, gesture_poll(now + 100 * MS));
+}
+
+TEST(gesture, init_ShouldTakeTiming) {
+	const struct gesture_timing timing = {
+		.click_gap_ms = 100,
+		.long_press_ms = 200,
+		.repeat_ms = 50,
+	};
+	gesture_init(1, &timing, recognized);
+	press(0, 250);
+	LONGS_EQUAL(1, fake.counts[GESTURE_LONG_PRESS]);
+	LONGS_EQUAL(1, fake.counts[GESTURE_HOLD_REPEAT]);
+}
+
+TEST(gesture, feed_ShouldKeepChannelsApart) {
+	gesture_feed(0, true, now);
+	press(1, 50);
+	step(400);
+	LONGS_EQUAL(1, fake.counts[GESTURE_CLICK]);
+	LONGS_EQUAL(1, fake.channel);
+	step(400);
+	LONGS_EQUAL(1, fake.counts[GESTURE_LONG_PRESS]);
+	LONGS_EQUAL(0, fake.channel);
+}
@@ -0,0 +1,90 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/TestHarness_c.h"
+
+#include <string.h>
+
+extern "C" {
+#include "heartbeat.h"
+}
+
+static int32_t fake_metrics[HEARTBEAT_NR_METRICS];
+
+int32_t metrics_get(metric_key_t key)
+{
+	return fake_metrics[key];
+}
+
+TEST_GROUP(heartbeat) {
+	uint8_t buf[HEARTBEAT_MAXLEN];
+
+	void setup(void) {
+		memset(fake_metrics, 0, sizeof(fake_metrics));
+		memset(buf, 0, sizeof(buf));
+		histogram_reset();
+	}
+	void teardown() {
+	}
+};
+
+TEST(heartbeat, encode_ShouldWriteHeaderOnly_WhenAllZero) {
+	const uint8_t expected[] = { 'H', 1, 0, 0 };
+	LONGS_EQUAL(sizeof(expected), heartbeat_encode(buf, sizeof(buf)));
+	MEMCMP_EQUAL(expected, buf, sizeof(expected));
+}
+
+TEST(heartbeat, encode_ShouldWriteKeyDeltasAndZigzagValues) {
+	const uint8_t expected[] = {
+		'H', 1,
+		3,
+		0, 0x90, 0x1c, /* ReportInterval 1800 */
+		3, 0x9f, 0x01, /* WifiRssi -80 */
+		2, 0x02, /* OtaBytesPerSec 1 */
+		0,
+	};
+
+	fake_metrics[ReportInterval] = 1800;
+	fake_metrics[WifiRssi] = -80;
+	fake_metrics[OtaBytesPerSec] = 1;
+
+	LONGS_EQUAL(sizeof(expected), heartbeat_encode(buf, sizeof(buf)));
+	MEMCMP_EQUAL(expected, buf, sizeof(expected));
+}
+
+TEST(heartbeat, encode_ShouldWriteSparseBuckets) {
+	const uint8_t expected[] = {
+		'H', 1,
+		0,
+		2,
+		1, 2, 3, 1, 5, 2, /* OtaChunkRtt: 1 at bucket 3, 2 at 8 */
+		2, 1, 12, 1, /* WifiReconnectTime: 1 at bucket 12 */
+	};
+
+	for (int i = 0; i < 2; i++) {
+		histogram_record(OtaChunkRtt, 200);
+	}
+	histogram_record(OtaChunkRtt, 5);
+	histogram_record(WifiReconnectTime, 3000);
+
+	LONGS_EQUAL(sizeof(expected), heartbeat_encode(buf, sizeof(buf)));
+	MEMCMP_EQUAL(expected, buf, sizeof(expected));
+}
+
+TEST(heartbeat, encode_ShouldReturnZero_WhenBufferTooSmall) {
+	fake_metrics[ReportInterval] = 1800;
+	LONGS_EQUAL(0, heartbeat_encode(buf, 4));
+}
+
+TEST(heartbeat, encode_ShouldFitMaxlen_WhenEverythingNonzero) {
+	for (int i = 0; i < HEARTBEAT_NR_METRICS; i++) {
+		fake_metrics[i] = INT32_MIN;
+	}
+	for (int i = 0; i < HISTOGRAM_MAX; i++) {
+		for (uint32_t v = 0; v < (1u << 23); v = v? v << 1 : 1) {
+			for (int n = 0; n < 3; n++) {
+				histogram_record((histogram_key_t)i, v);
+			}
+		}
+	}
+
+	CHECK(heartbeat_encode(buf, sizeof(buf)) > 0);
+}
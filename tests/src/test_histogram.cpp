@@ -0,0 +1,61 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/TestHarness_c.h"
+
+#include <string.h>
+
+extern "C" {
+#include "histogram.h"
+}
+
+TEST_GROUP(histogram) {
+	uint16_t counts[HISTOGRAM_BUCKETS];
+
+	void setup(void) {
+		histogram_reset();
+		memset(counts, 0, sizeof(counts));
+	}
+	void teardown() {
+	}
+};
+
+TEST(histogram, get_bucket_ShouldReturnLog2Bucket) {
+	LONGS_EQUAL(0, histogram_get_bucket(0));
+	LONGS_EQUAL(1, histogram_get_bucket(1));
+	LONGS_EQUAL(2, histogram_get_bucket(2));
+	LONGS_EQUAL(2, histogram_get_bucket(3));
+	LONGS_EQUAL(3, histogram_get_bucket(4));
+	LONGS_EQUAL(10, histogram_get_bucket(1000));
+}
+
+TEST(histogram, get_bucket_ShouldReturnLastBucket_WhenValueTooLarge) {
+	LONGS_EQUAL(HISTOGRAM_BUCKETS - 1, histogram_get_bucket(1u << 23));
+	LONGS_EQUAL(HISTOGRAM_BUCKETS - 1, histogram_get_bucket(UINT32_MAX));
+}
+
+TEST(histogram, record_ShouldCountInBucket) {
+	histogram_record(OtaChunkRtt, 150);
+	histogram_record(OtaChunkRtt, 200);
+	histogram_record(OtaChunkRtt, 5);
+
+	histogram_get(OtaChunkRtt, counts);
+	LONGS_EQUAL(2, counts[8]);
+	LONGS_EQUAL(1, counts[3]);
+
+	histogram_get(MqttPublishLatency, counts);
+	LONGS_EQUAL(0, counts[8]);
+}
+
+TEST(histogram, record_ShouldSaturate) {
+	for (unsigned int i = 0; i < UINT16_MAX + 10u; i++) {
+		histogram_record(MqttPublishLatency, 0);
+	}
+	histogram_get(MqttPublishLatency, counts);
+	LONGS_EQUAL(UINT16_MAX, counts[0]);
+}
+
+TEST(histogram, reset_ShouldClearAll) {
+	histogram_record(WifiReconnectTime, 3000);
+	histogram_reset();
+	histogram_get(WifiReconnectTime, counts);
+	LONGS_EQUAL(0, counts[12]);
+}
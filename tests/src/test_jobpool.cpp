@@ -0,0 +1,321 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/TestHarness_c.h"
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+extern "C" {
+#include "jobpool.h"
+#include "uptime.h"
+}
+
+static struct {
+	unsigned int now;
+	pthread_mutex_t lock;
+	char order[16];
+	unsigned int nr_done;
+	sem_t done;
+	sem_t blocked;
+	sem_t gates[JOBPOOL_PRIO_MAX];
+} fake;
+
+unsigned int uptime_get_ms(void)
+{
+	return fake.now;
+}
+
+static void record(void *context)
+{
+	pthread_mutex_lock(&fake.lock);
+	fake.order[fake.nr_done++] = (char)(uintptr_t)context;
+	pthread_mutex_unlock(&fake.lock);
+	sem_post(&fake.done);
+}
+
+static void block(void *context)
+{
+	sem_post(&fake.blocked);
+	sem_wait((sem_t *)context);
+}
+
+static bool wait_for(sem_t *sem)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += 1;
+	return sem_timedwait(sem, &ts) == 0;
+}
+
+TEST_GROUP(jobpool) {
+	void setup(void) {
+		memset(&fake, 0, sizeof(fake));
+		pthread_mutex_init(&fake.lock, NULL);
+		sem_init(&fake.done, 0, 0);
+		sem_init(&fake.blocked, 0, 0);
+		for (int i = 0; i < JOBPOOL_PRIO_MAX; i++) {
+			sem_init(&fake.gates[i], 0, 0);
+		}
+		jobpool_init();
+		jobpool_reset_stats();
+	}
+	void teardown() {
+		for (int i = 0; i < JOBPOOL_PRIO_MAX; i++) {
+			sem_post(&fake.gates[i]);
+		}
+		jobpool_deinit();
+		for (int i = 0; i < JOBPOOL_PRIO_MAX; i++) {
+			sem_destroy(&fake.gates[i]);
+		}
+		sem_destroy(&fake.blocked);
+		sem_destroy(&fake.done);
+		pthread_mutex_destroy(&fake.lock);
+	}
+
+	/* the lowest lane first so that each lands on the workers of its own */
+	void occupy(jobpool_prio_t prio) {
+		CHECK(jobpool_schedule_prio(prio, block,
+					&fake.gates[prio], 0));
+		CHECK(wait_for(&fake.blocked));
+	}
+	void release(jobpool_prio_t prio) {
+		sem_post(&fake.gates[prio]);
+	}
+	void schedule(jobpool_prio_t prio, char id, unsigned int deadline_ms) {
+		CHECK(jobpool_schedule_prio(prio, record,
+					(void *)(uintptr_t)id, deadline_ms));
+	}
+	/* NULL for the other entry */
+	struct jobpool_stats get_stats(void (*job)(void *context)) {
+		struct jobpool_stats stats[JOBPOOL_STATS_MAX];
+		jobpool_get_stats(stats);
+		for (int i = 0; job != NULL && i < JOBPOOL_STATS_JOBS; i++) {
+			if (stats[i].job == job) {
+				return stats[i];
+			}
+		}
+		return stats[JOBPOOL_STATS_OTHER];
+	}
+	unsigned int count_runs(void (*job)(void *context)) {
+		struct jobpool_stats stats = get_stats(job);
+		unsigned int n = 0;
+		for (int i = 0; i < JOBPOOL_HISTOGRAM_BUCKETS; i++) {
+			n += stats.run[i];
+		}
+		return n;
+	}
+	/* the stats get updated after the job returns */
+	void wait_runs(void (*job)(void *context), unsigned int n) {
+		for (int i = 0; i < 1000 && count_runs(job) < n; i++) {
+			usleep(1000);
+		}
+		LONGS_EQUAL(n, count_runs(job));
+	}
+	void wait_done(unsigned int n) {
+		for (unsigned int i = 0; i < n; i++) {
+			CHECK(wait_for(&fake.done));
+		}
+	}
+};
+
+TEST(jobpool, schedule_ShouldRunJob) {
+	CHECK(jobpool_schedule(record, (void *)'a'));
+	wait_done(1);
+	STRCMP_EQUAL("a", fake.order);
+}
+
+TEST(jobpool, schedule_ShouldReturnFalse_WhenInvalidArgumentsGiven) {
+	CHECK(!jobpool_schedule(NULL, NULL));
+	CHECK(!jobpool_schedule_prio(JOBPOOL_PRIO_MAX, record, NULL, 0));
+}
+
+TEST(jobpool, schedule_ShouldRunHighJob_WhenOtherLanesBlocked) {
+	occupy(JOBPOOL_PRIO_BULK);
+	occupy(JOBPOOL_PRIO_LOW);
+	occupy(JOBPOOL_PRIO_NORMAL);
+	schedule(JOBPOOL_PRIO_HIGH, 'h', 0);
+	wait_done(1);
+	STRCMP_EQUAL("h", fake.order);
+}
+
+TEST(jobpool, schedule_ShouldRunNormalJob_WhenLowLaneBlocked) {
+	occupy(JOBPOOL_PRIO_BULK);
+	occupy(JOBPOOL_PRIO_LOW);
+	schedule(JOBPOOL_PRIO_NORMAL, 'n', 0);
+	wait_done(1);
+	STRCMP_EQUAL("n", fake.order);
+}
+
+TEST(jobpool, schedule_ShouldRunLowJob_WhenBulkLaneBlocked) {
+	occupy(JOBPOOL_PRIO_BULK);
+	schedule(JOBPOOL_PRIO_LOW, 'l', 0);
+	wait_done(1);
+	STRCMP_EQUAL("l", fake.order);
+}
+
+TEST(jobpool, worker_ShouldServeHigherLanesFirst) {
+	occupy(JOBPOOL_PRIO_BULK);
+	occupy(JOBPOOL_PRIO_LOW);
+	occupy(JOBPOOL_PRIO_NORMAL);
+	occupy(JOBPOOL_PRIO_HIGH);
+	schedule(JOBPOOL_PRIO_LOW, 'l', 0);
+	schedule(JOBPOOL_PRIO_NORMAL, 'n', 0);
+	schedule(JOBPOOL_PRIO_HIGH, 'h', 0);
+	LONGS_EQUAL(3, jobpool_count());
+
+	release(JOBPOOL_PRIO_LOW);
+	wait_done(3);
+	STRCMP_EQUAL("hnl", fake.order);
+}
+
+TEST(jobpool, worker_ShouldRunEarliestDeadlineFirst) {
+	occupy(JOBPOOL_PRIO_BULK);
+	occupy(JOBPOOL_PRIO_LOW);
+	occupy(JOBPOOL_PRIO_NORMAL);
+	schedule(JOBPOOL_PRIO_NORMAL, 'c', 0);
+	schedule(JOBPOOL_PRIO_NORMAL, 'a', 100);
+	schedule(JOBPOOL_PRIO_NORMAL, 'b', 50);
+	schedule(JOBPOOL_PRIO_NORMAL, 'd', 0);
+
+	release(JOBPOOL_PRIO_NORMAL);
+	wait_done(4);
+	STRCMP_EQUAL("bacd", fake.order);
+}
+
+TEST(jobpool, worker_ShouldDropJob_WhenDeadlineMissed) {
+	occupy(JOBPOOL_PRIO_BULK);
+	occupy(JOBPOOL_PRIO_LOW);
+	occupy(JOBPOOL_PRIO_NORMAL);
+	schedule(JOBPOOL_PRIO_NORMAL, 'x', 10);
+	schedule(JOBPOOL_PRIO_NORMAL, 'y', 0);
+	fake.now += 11;
+
+	release(JOBPOOL_PRIO_NORMAL);
+	wait_done(1);
+	STRCMP_EQUAL("y", fake.order);
+	LONGS_EQUAL(0, jobpool_count());
+}
+
+TEST(jobpool, schedule_ShouldReturnFalse_WhenLaneFull) {
+	unsigned int n = 0;
+
+	occupy(JOBPOOL_PRIO_BULK);
+	occupy(JOBPOOL_PRIO_LOW);
+	while (jobpool_schedule_prio(JOBPOOL_PRIO_LOW, record, NULL, 0)) {
+		n++;
+	}
+
+	CHECK(n > 0);
+	LONGS_EQUAL(n, jobpool_count());
+	CHECK(jobpool_schedule_prio(JOBPOOL_PRIO_NORMAL, record,
+				(void *)'n', 0));
+	wait_done(1);
+	STRCMP_EQUAL("n", fake.order);
+}
+
+TEST(jobpool, stats_ShouldRecordWaitAndRunTimePerJob) {
+	struct jobpool_stats stats;
+
+	occupy(JOBPOOL_PRIO_BULK);
+	occupy(JOBPOOL_PRIO_LOW);
+	occupy(JOBPOOL_PRIO_NORMAL);
+	schedule(JOBPOOL_PRIO_NORMAL, 'a', 0);
+	fake.now += 150;
+
+	release(JOBPOOL_PRIO_NORMAL);
+	wait_done(1);
+	wait_runs(block, 1);
+	wait_runs(record, 1);
+
+	stats = get_stats(record);
+	POINTERS_EQUAL((void *)record, (void *)stats.job);
+	LONGS_EQUAL(1, stats.wait[2]);
+	LONGS_EQUAL(150, stats.max_wait_ms);
+	LONGS_EQUAL(1, stats.run[0]);
+
+	stats = get_stats(block);
+	LONGS_EQUAL(3, stats.wait[0]);
+	LONGS_EQUAL(0, stats.max_wait_ms);
+	LONGS_EQUAL(1, stats.run[2]);
+	LONGS_EQUAL(150, stats.max_run_ms);
+}
+
+TEST(jobpool, stats_ShouldCountExpiredAndRejected) {
+	struct jobpool_stats stats;
+	unsigned int n = 1; /* 'x' */
+
+	occupy(JOBPOOL_PRIO_BULK);
+	occupy(JOBPOOL_PRIO_LOW);
+	schedule(JOBPOOL_PRIO_LOW, 'x', 10);
+	while (jobpool_schedule_prio(JOBPOOL_PRIO_LOW, record,
+				(void *)'y', 0)) {
+		n++;
+	}
+	fake.now += 11;
+
+	release(JOBPOOL_PRIO_LOW);
+	wait_runs(record, n - 1); /* all but 'x' */
+
+	stats = get_stats(record);
+	LONGS_EQUAL(1, stats.expired);
+	LONGS_EQUAL(1, stats.rejected);
+	LONGS_EQUAL(n, jobpool_get_max_depth(JOBPOOL_PRIO_LOW));
+	LONGS_EQUAL(1, jobpool_get_max_depth(JOBPOOL_PRIO_BULK));
+}
+
+#define DEFINE_JOB(n) \
+	static void job##n(void *context) { record(context); }
+DEFINE_JOB(0)
+DEFINE_JOB(1)
+DEFINE_JOB(2)
+DEFINE_JOB(3)
+DEFINE_JOB(4)
+DEFINE_JOB(5)
+DEFINE_JOB(6)
+DEFINE_JOB(7)
+
+TEST(jobpool, stats_ShouldAddUpInOther_WhenJobsOutnumberEntries) {
+	static void (* const jobs[])(void *context) = {
+		job0, job1, job2, job3, job4, job5, job6, job7,
+	};
+	const unsigned int n = sizeof(jobs) / sizeof(*jobs);
+	struct jobpool_stats stats[JOBPOOL_STATS_MAX];
+	unsigned int others = 0;
+
+	CHECK(n > JOBPOOL_STATS_JOBS);
+
+	for (unsigned int i = 0; i < n; i++) {
+		CHECK(jobpool_schedule(jobs[i], (void *)'j'));
+		wait_done(1);
+		wait_runs(jobs[i], i < JOBPOOL_STATS_JOBS? 1 : ++others);
+	}
+
+	jobpool_get_stats(stats);
+	for (unsigned int i = 0; i < JOBPOOL_STATS_JOBS; i++) {
+		POINTERS_EQUAL((void *)jobs[i], (void *)stats[i].job);
+	}
+	POINTERS_EQUAL(NULL, (void *)stats[JOBPOOL_STATS_OTHER].job);
+	LONGS_EQUAL(n - JOBPOOL_STATS_JOBS,
+			stats[JOBPOOL_STATS_OTHER].wait[0]);
+}
+
+TEST(jobpool, stats_ShouldClearEntries_WhenReset) {
+	struct jobpool_stats stats[JOBPOOL_STATS_MAX];
+
+	schedule(JOBPOOL_PRIO_NORMAL, 'a', 0);
+	wait_done(1);
+	wait_runs(record, 1);
+
+	jobpool_reset_stats();
+
+	jobpool_get_stats(stats);
+	for (int i = 0; i < JOBPOOL_STATS_MAX; i++) {
+		POINTERS_EQUAL(NULL, (void *)stats[i].job);
+		LONGS_EQUAL(0, stats[i].wait[0]);
+		LONGS_EQUAL(0, stats[i].run[0]);
+	}
+	LONGS_EQUAL(0, jobpool_get_max_depth(JOBPOOL_PRIO_NORMAL));
+}
@@ -0,0 +1,70 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/TestHarness_c.h"
+
+#include "linkq.h"
+
+TEST_GROUP(linkq) {
+	void setup(void) {
+		linkq_reset();
+	}
+	void teardown() {
+	}
+};
+
+TEST(linkq, get_ShouldReturnZero_WhenNoSampleGiven) {
+	LONGS_EQUAL(0, linkq_get_rssi());
+	LONGS_EQUAL(0, linkq_get_rssi_min());
+	LONGS_EQUAL(0, linkq_get_rssi_max());
+	LONGS_EQUAL(0, linkq_count());
+}
+
+TEST(linkq, get_ShouldReturnTheSample_WhenFirstSampleGiven) {
+	linkq_update(-67);
+	LONGS_EQUAL(-67, linkq_get_rssi());
+	LONGS_EQUAL(-67, linkq_get_rssi_min());
+	LONGS_EQUAL(-67, linkq_get_rssi_max());
+	LONGS_EQUAL(1, linkq_count());
+}
+
+TEST(linkq, get_ShouldConverge_WhenTheSameSampleRepeated) {
+	linkq_update(-40);
+	for (int i = 0; i < 100; i++) {
+		linkq_update(-80);
+	}
+	LONGS_EQUAL(-80, linkq_get_rssi());
+}
+
+TEST(linkq, get_ShouldSmoothOutSpike) {
+	for (int i = 0; i < 20; i++) {
+		linkq_update(-70);
+	}
+	linkq_update(-30);
+	CHECK(linkq_get_rssi() <= -64);
+	CHECK(linkq_get_rssi() > -70);
+}
+
+TEST(linkq, minmax_ShouldTrackWindow) {
+	linkq_update(-90);
+	linkq_update(-30);
+	linkq_update(-60);
+	LONGS_EQUAL(-90, linkq_get_rssi_min());
+	LONGS_EQUAL(-30, linkq_get_rssi_max());
+}
+
+TEST(linkq, minmax_ShouldForgetSamplesOutOfWindow) {
+	linkq_update(-90);
+	linkq_update(-30);
+	for (int i = 0; i < LINKQ_WINDOW_SIZE; i++) {
+		linkq_update(-60);
+	}
+	LONGS_EQUAL(-60, linkq_get_rssi_min());
+	LONGS_EQUAL(-60, linkq_get_rssi_max());
+	LONGS_EQUAL(LINKQ_WINDOW_SIZE, linkq_count());
+}
+
+TEST(linkq, reset_ShouldClearSamples) {
+	linkq_update(-50);
+	linkq_reset();
+	LONGS_EQUAL(0, linkq_count());
+	LONGS_EQUAL(0, linkq_get_rssi());
+}
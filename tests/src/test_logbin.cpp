@@ -0,0 +1,198 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/TestHarness_c.h"
+
+#include <stdint.h>
+#include <string.h>
+
+extern "C" {
+#include "logbin.h"
+#include "uptime.h"
+}
+
+#define LONG_STRING	"0123456789abcdef0123456789abcdef0123456789"
+
+unsigned int uptime_get_ms(void)
+{
+	return 1000;
+}
+
+static uint64_t get_varint(const uint8_t **p)
+{
+	uint64_t value = 0;
+
+	for (unsigned int shift = 0; ; shift += 7) {
+		uint8_t byte = *(*p)++;
+		value |= (uint64_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			return value;
+		}
+	}
+}
+
+/* returns the arguments of the record, setting the length of them */
+static const uint8_t *parse_record(const uint8_t *p, logging_t type,
+		const char *format, size_t *args_len)
+{
+	const uint8_t *end = p + 1 + p[0];
+
+	p++;
+	LONGS_EQUAL(type, *p++);
+	LONGS_EQUAL(1000, get_varint(&p));
+	CHECK((uintptr_t)format == get_varint(&p));
+
+	*args_len = (size_t)(end - p);
+	return p;
+}
+
+TEST_GROUP(logbin) {
+	uint8_t storage[256];
+	uint8_t buf[256];
+	size_t args_len;
+
+	void setup(void) {
+		logbin_init(storage, sizeof(storage));
+		memset(buf, 0, sizeof(buf));
+	}
+	void teardown() {
+	}
+};
+
+TEST(logbin, read_ShouldReturnZero_WhenEmpty) {
+	LONGS_EQUAL(0, logbin_read(buf, sizeof(buf)));
+}
+
+TEST(logbin, save_ShouldEncodeIntegers) {
+	const char *fmt = "%d %u %x %%";
+	const uint8_t expected[] = { 0x01, 0xac, 0x02, 0x7f };
+
+	logbin_save(LOGGING_TYPE_INFO, fmt, -1, 300u, 0x7f);
+
+	LONGS_EQUAL(1, logbin_count());
+	CHECK(logbin_read(buf, sizeof(buf)) > 0);
+	LONGS_EQUAL('L', buf[0]);
+	LONGS_EQUAL(1, buf[1]);
+
+	const uint8_t *args = parse_record(&buf[2], LOGGING_TYPE_INFO, fmt,
+			&args_len);
+	LONGS_EQUAL(sizeof(expected), args_len);
+	MEMCMP_EQUAL(expected, args, sizeof(expected));
+	LONGS_EQUAL(0, logbin_count());
+}
+
+TEST(logbin, save_ShouldCopyStrings_WithinPrecision) {
+	const char *fmt = "%s/%.3s/%s";
+	const uint8_t expected[] = { 4, 's', 's', 'i', 'd', 3, 'a', 'b', 'c',
+		LOGBIN_STRING_MAXLEN };
+
+	logbin_save(LOGGING_TYPE_DEBUG, fmt, "ssid", "abcdef", LONG_STRING);
+	logbin_read(buf, sizeof(buf));
+
+	const uint8_t *args = parse_record(&buf[2], LOGGING_TYPE_DEBUG, fmt,
+			&args_len);
+	LONGS_EQUAL(sizeof(expected) + LOGBIN_STRING_MAXLEN, args_len);
+	MEMCMP_EQUAL(expected, args, sizeof(expected));
+}
+
+TEST(logbin, save_ShouldEncodeDoubles) {
+	const char *fmt = "%.2f";
+	const double value = 1.5;
+	uint8_t expected[sizeof(value)];
+
+	memcpy(expected, &value, sizeof(value)); /* little endian host */
+	logbin_save(LOGGING_TYPE_INFO, fmt, value);
+	logbin_read(buf, sizeof(buf));
+
+	const uint8_t *args = parse_record(&buf[2], LOGGING_TYPE_INFO, fmt,
+			&args_len);
+	LONGS_EQUAL(sizeof(expected), args_len);
+	MEMCMP_EQUAL(expected, args, sizeof(expected));
+}
+
+TEST(logbin, save_ShouldDropArgs_WhenRecordFull) {
+	const char *fmt = "%s %s %s";
+
+	logbin_save(LOGGING_TYPE_ERROR, fmt, LONG_STRING, LONG_STRING,
+			LONG_STRING);
+	logbin_read(buf, sizeof(buf));
+
+	CHECK(buf[2] < LOGBIN_RECORD_MAXLEN);
+	parse_record(&buf[2], LOGGING_TYPE_ERROR, fmt, &args_len);
+	LONGS_EQUAL(2 * (1 + LOGBIN_STRING_MAXLEN), args_len);
+}
+
+TEST(logbin, save_ShouldDropOldest_WhenFull) {
+	const char *fmt = "%s";
+
+	logbin_init(storage, 100);
+	logbin_save(LOGGING_TYPE_INFO, fmt, "first");
+	logbin_save(LOGGING_TYPE_INFO, fmt, LONG_STRING);
+	logbin_save(LOGGING_TYPE_INFO, fmt, LONG_STRING);
+
+	LONGS_EQUAL(2, logbin_count());
+	logbin_read(buf, sizeof(buf));
+	const uint8_t *args = parse_record(&buf[2], LOGGING_TYPE_INFO, fmt,
+			&args_len);
+	LONGS_EQUAL(LOGBIN_STRING_MAXLEN, args[0]);
+}
+
+TEST(logbin, read_ShouldMoveWholeRecordsOnly) {
+	const char *fmt = "%s";
+
+	size_t len = logbin_save(LOGGING_TYPE_INFO, fmt, "first");
+	logbin_save(LOGGING_TYPE_INFO, fmt, "second");
+
+	LONGS_EQUAL(2 + len, logbin_read(buf, 2 + len + 3));
+	LONGS_EQUAL(1, logbin_count());
+	logbin_read(buf, sizeof(buf));
+	const uint8_t *args = parse_record(&buf[2], LOGGING_TYPE_INFO, fmt,
+			&args_len);
+	MEMCMP_EQUAL("second", &args[1], 6);
+}
+
+TEST(logbin, save_ShouldKeepRecordsAcrossWrapAround) {
+	const char *fmt = "%d";
+
+	logbin_init(storage, 32);
+	for (int i = 0; i < 20; i++) {
+		logbin_save(LOGGING_TYPE_INFO, fmt, i);
+	}
+
+	size_t n = logbin_count();
+	size_t len = logbin_read(buf, sizeof(buf));
+	const uint8_t *p = &buf[2];
+
+	for (size_t i = 0; i < n; i++) {
+		const uint8_t *args = parse_record(p, LOGGING_TYPE_INFO, fmt,
+				&args_len);
+		LONGS_EQUAL((20 - n + i) * 2, args[0]);
+		p = args + args_len;
+	}
+	LONGS_EQUAL(len, (size_t)(p - buf));
+}
+
+TEST(logbin, save_ShouldDrop_WhenBelowLevel) {
+	logbin_set_level(LOGGING_TYPE_WARN);
+	LONGS_EQUAL(0, logbin_save(LOGGING_TYPE_INFO, "%d", 1));
+	CHECK(logbin_save(LOGGING_TYPE_WARN, "%d", 1) > 0);
+	logbin_set_level(LOGGING_TYPE_VERBOSE);
+
+	LONGS_EQUAL(1, logbin_count());
+}
+
+TEST(logbin, get_status_ShouldReportPending) {
+	struct logbin_status status;
+
+	size_t len = logbin_save(LOGGING_TYPE_ERROR, "%d", 1);
+	logbin_save(LOGGING_TYPE_INFO, "%d", 2);
+	logbin_get_status(&status);
+
+	LONGS_EQUAL(2, status.count);
+	LONGS_EQUAL(2 * len, status.bytes);
+	LONGS_EQUAL(1000, status.oldest_ms);
+	LONGS_EQUAL(LOGGING_TYPE_ERROR, status.max_type);
+
+	logbin_read(buf, sizeof(buf));
+	logbin_get_status(&status);
+	LONGS_EQUAL(0, status.count);
+	LONGS_EQUAL(LOGGING_TYPE_VERBOSE, status.max_type);
+}
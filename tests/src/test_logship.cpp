@@ -0,0 +1,102 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/TestHarness_c.h"
+
+#include <stdint.h>
+#include <string.h>
+
+extern "C" {
+#include "logship.h"
+#include "lz.h"
+#include "uptime.h"
+}
+
+static unsigned int fake_uptime;
+static uint8_t sent[1024];
+static size_t sent_len;
+static int nr_sent;
+static bool send_fails;
+
+unsigned int uptime_get_ms(void)
+{
+	return fake_uptime;
+}
+
+static bool fake_send(const void *data, size_t datasize)
+{
+	if (send_fails) {
+		return false;
+	}
+
+	memcpy(sent, data, datasize);
+	sent_len = datasize;
+	nr_sent++;
+	return true;
+}
+
+TEST_GROUP(logship) {
+	uint8_t storage[1024];
+
+	void setup(void) {
+		fake_uptime = 1000;
+		sent_len = 0;
+		nr_sent = 0;
+		send_fails = false;
+		logbin_init(storage, sizeof(storage));
+		logship_init(fake_send);
+	}
+	void teardown() {
+	}
+};
+
+TEST(logship, poll_ShouldHold_WhenFewAndYoung) {
+	logbin_save(LOGGING_TYPE_INFO, "%s", "hello");
+	fake_uptime += LOGSHIP_FLUSH_AGE_MSEC - 1;
+	CHECK_FALSE(logship_poll(fake_uptime));
+	LONGS_EQUAL(0, nr_sent);
+}
+
+TEST(logship, poll_ShouldFlush_WhenOldestAged) {
+	logbin_save(LOGGING_TYPE_INFO, "%s", "hello");
+	fake_uptime += LOGSHIP_FLUSH_AGE_MSEC;
+	CHECK_TRUE(logship_poll(fake_uptime));
+	LONGS_EQUAL(1, nr_sent);
+	LONGS_EQUAL(0, logbin_count());
+}
+
+TEST(logship, poll_ShouldFlush_WhenSevere) {
+	logbin_save(LOGGING_TYPE_INFO, "%s", "hello");
+	logbin_save(LOGGING_TYPE_ERROR, "%s", "failed");
+	CHECK_TRUE(logship_poll(fake_uptime));
+	LONGS_EQUAL(0, logbin_count());
+}
+
+TEST(logship, poll_ShouldFlushCompressed_WhenEnoughPending) {
+	uint8_t batch[LOGSHIP_BATCH_MAXLEN];
+
+	for (int i = 0; i < 20; i++) {
+		logbin_save(LOGGING_TYPE_INFO, "%s %d", "wifi disconnected", i);
+	}
+
+	CHECK_TRUE(logship_poll(fake_uptime));
+	LONGS_EQUAL('Z', sent[0]);
+	LONGS_EQUAL(1, sent[1]);
+
+	size_t len = (size_t)(sent[2] & 0x7f) | (size_t)sent[3] << 7;
+	LONGS_EQUAL(len, lz_decompress(&sent[4], sent_len - 4,
+				batch, sizeof(batch)));
+	LONGS_EQUAL('L', batch[0]);
+	CHECK(sent_len < len / 2);
+}
+
+TEST(logship, poll_ShouldRetry_WhenSendFailed) {
+	logbin_save(LOGGING_TYPE_ERROR, "%s", "failed");
+	send_fails = true;
+	CHECK_FALSE(logship_poll(fake_uptime));
+	logbin_save(LOGGING_TYPE_ERROR, "%s", "the next");
+
+	send_fails = false;
+	CHECK_TRUE(logship_poll(fake_uptime));
+	LONGS_EQUAL(1, logbin_count());
+	CHECK_TRUE(logship_poll(fake_uptime));
+	LONGS_EQUAL(2, nr_sent);
+}
@@ -0,0 +1,83 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/TestHarness_c.h"
+
+#include <stdint.h>
+#include <string.h>
+
+extern "C" {
+#include "lz.h"
+}
+
+TEST_GROUP(lz) {
+	uint8_t src[1024];
+	uint8_t compressed[1024 + 1024 / 8 + 1];
+	uint8_t decompressed[1024];
+
+	void setup(void) {
+		memset(compressed, 0, sizeof(compressed));
+		memset(decompressed, 0, sizeof(decompressed));
+	}
+	void teardown() {
+	}
+
+	void check_round_trip(size_t len) {
+		size_t n = lz_compress(src, len, compressed,
+				sizeof(compressed));
+		CHECK(n > 0);
+		LONGS_EQUAL(len, lz_decompress(compressed, n,
+					decompressed, sizeof(decompressed)));
+		MEMCMP_EQUAL(src, decompressed, len);
+	}
+};
+
+TEST(lz, compress_ShouldShrink_WhenRepetitive) {
+	const char *line = "wifi state changed to 1: connected. ";
+
+	for (size_t i = 0; i < sizeof(src); i++) {
+		src[i] = (uint8_t)line[i % strlen(line)];
+	}
+
+	size_t n = lz_compress(src, sizeof(src), compressed,
+			sizeof(compressed));
+	CHECK(n > 0);
+	CHECK(n < sizeof(src) / 4);
+	check_round_trip(sizeof(src));
+}
+
+TEST(lz, compress_ShouldKeepData_WhenIncompressible) {
+	uint32_t x = 2463534242u;
+
+	for (size_t i = 0; i < sizeof(src); i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		src[i] = (uint8_t)x;
+	}
+
+	check_round_trip(sizeof(src));
+}
+
+TEST(lz, compress_ShouldHandleRuns) {
+	memset(src, 'a', 100);
+	check_round_trip(100);
+	check_round_trip(1);
+	check_round_trip(3);
+}
+
+TEST(lz, compress_ShouldReturnZero_WhenOutputTooSmall) {
+	memcpy(src, "abcdefgh", 8);
+	LONGS_EQUAL(0, lz_compress(src, 8, compressed, 8));
+	LONGS_EQUAL(9, lz_compress(src, 8, compressed, 9));
+}
+
+TEST(lz, decompress_ShouldReturnZero_WhenDistanceBeyondOutput) {
+	const uint8_t broken[] = { 0x01, 0x05, 0x00 };
+	LONGS_EQUAL(0, lz_decompress(broken, sizeof(broken),
+				decompressed, sizeof(decompressed)));
+}
+
+TEST(lz, decompress_ShouldReturnZero_WhenOutputTooSmall) {
+	memset(src, 'a', 100);
+	size_t n = lz_compress(src, 100, compressed, sizeof(compressed));
+	LONGS_EQUAL(0, lz_decompress(compressed, n, decompressed, 99));
+}
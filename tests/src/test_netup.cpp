@@ -0,0 +1,217 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/TestHarness_c.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "netup.h"
+#include "wifi.h"
+
+static struct {
+	wifiman_error_t last;
+	wifiman_error_t best;
+	int saved; /* networks saved from index 0 */
+	wifiman_error_t start; /* what wifiman_connect_async() returns */
+	int last_calls;
+	int best_calls;
+	int started;
+	char ssid[WIFIMAN_SSID_MAXLEN + 1];
+	unsigned int timeout_ms;
+	wifiman_connect_cb_t cb;
+	void *context;
+	int done;
+	bool connected;
+	void *done_context;
+} fake;
+
+wifiman_error_t wifiman_connect_last(void)
+{
+	fake.last_calls++;
+	return fake.last;
+}
+
+wifiman_error_t wifiman_connect_best(void)
+{
+	fake.best_calls++;
+	return fake.best;
+}
+
+bool wifiman_get_network(wifiman_network_profile_t *profile, uint8_t index)
+{
+	if (index >= fake.saved) {
+		return false;
+	}
+
+	snprintf(profile->ssid, sizeof(profile->ssid), "ap%u", index);
+	return true;
+}
+
+wifiman_error_t wifiman_connect_async(const wifiman_network_profile_t *info,
+		wifiman_connect_cb_t cb, void *context, unsigned int timeout_ms)
+{
+	fake.started++;
+	strcpy(fake.ssid, info->ssid);
+	fake.timeout_ms = timeout_ms;
+	if (fake.start == WIFIMAN_SUCCESS) {
+		fake.cb = cb;
+		fake.context = context;
+	}
+	return fake.start;
+}
+
+static void done(bool connected, void *context)
+{
+	fake.done++;
+	fake.connected = connected;
+	fake.done_context = context;
+}
+
+static void complete(wifiman_error_t rc)
+{
+	wifiman_connect_cb_t cb = fake.cb;
+	fake.cb = NULL;
+	cb(rc, fake.context);
+}
+
+TEST_GROUP(netup) {
+	void setup(void) {
+		memset(&fake, 0, sizeof(fake));
+		fake.last = WIFIMAN_ERROR;
+		fake.best = WIFIMAN_ERROR;
+		fake.start = WIFIMAN_SUCCESS;
+	}
+	void teardown() {
+		/* leave no bring-up behind for the next test */
+		while (fake.cb != NULL) {
+			complete(WIFIMAN_ERROR);
+		}
+	}
+};
+
+TEST(netup, start_ShouldReturnFalse_WhenDoneIsNull) {
+	CHECK_FALSE(netup_start(NULL, NULL));
+}
+
+TEST(netup, start_ShouldConnectToLastAp_WhenItAnswers) {
+	fake.last = WIFIMAN_SUCCESS;
+
+	CHECK_TRUE(netup_start(done, &fake));
+
+	LONGS_EQUAL(1, fake.done);
+	CHECK_TRUE(fake.connected);
+	POINTERS_EQUAL(&fake, fake.done_context);
+	LONGS_EQUAL(0, fake.best_calls);
+	LONGS_EQUAL(0, fake.started);
+}
+
+TEST(netup, start_ShouldFallBackToBestNetwork_WhenLastApFails) {
+	fake.best = WIFIMAN_SUCCESS;
+
+	CHECK_TRUE(netup_start(done, NULL));
+
+	LONGS_EQUAL(1, fake.last_calls);
+	LONGS_EQUAL(1, fake.best_calls);
+	LONGS_EQUAL(1, fake.done);
+	CHECK_TRUE(fake.connected);
+	LONGS_EQUAL(0, fake.started);
+}
+
+TEST(netup, start_ShouldReturnBeforeConnected_WhenTryingSavedNetworks) {
+	fake.saved = 2;
+
+	CHECK_TRUE(netup_start(done, NULL));
+
+	LONGS_EQUAL(1, fake.started);
+	STRCMP_EQUAL("ap0", fake.ssid);
+	CHECK(fake.timeout_ms > 0);
+	LONGS_EQUAL(0, fake.done);
+}
+
+TEST(netup, start_ShouldCallDone_WhenSavedNetworkGetsIp) {
+	fake.saved = 2;
+	netup_start(done, NULL);
+
+	complete(WIFIMAN_SUCCESS);
+
+	LONGS_EQUAL(1, fake.started);
+	LONGS_EQUAL(1, fake.done);
+	CHECK_TRUE(fake.connected);
+}
+
+TEST(netup, start_ShouldTryNextSavedNetwork_WhenOneTimesOut) {
+	fake.saved = 2;
+	netup_start(done, NULL);
+
+	complete(WIFIMAN_NOT_RESPONDING);
+
+	LONGS_EQUAL(2, fake.started);
+	STRCMP_EQUAL("ap1", fake.ssid);
+	LONGS_EQUAL(0, fake.done);
+
+	complete(WIFIMAN_SUCCESS);
+
+	LONGS_EQUAL(1, fake.done);
+	CHECK_TRUE(fake.connected);
+}
+
+TEST(netup, start_ShouldSkipSavedNetwork_WhenAssociationFailsToStart) {
+	fake.saved = 2;
+	fake.start = WIFIMAN_WRONG_SETTINGS;
+
+	netup_start(done, NULL);
+
+	LONGS_EQUAL(2, fake.started);
+	LONGS_EQUAL(1, fake.done);
+	CHECK_FALSE(fake.connected);
+}
+
+TEST(netup, start_ShouldCallDoneWithFalse_WhenAllSavedNetworksFail) {
+	fake.saved = 3;
+	netup_start(done, NULL);
+
+	complete(WIFIMAN_ERROR);
+	complete(WIFIMAN_ERROR);
+	complete(WIFIMAN_NOT_RESPONDING);
+
+	LONGS_EQUAL(3, fake.started);
+	LONGS_EQUAL(1, fake.done);
+	CHECK_FALSE(fake.connected);
+}
+
+TEST(netup, start_ShouldCallDoneWithFalse_WhenNothingSaved) {
+	netup_start(done, NULL);
+
+	LONGS_EQUAL(0, fake.started);
+	LONGS_EQUAL(1, fake.done);
+	CHECK_FALSE(fake.connected);
+}
+
+TEST(netup, start_ShouldReturnFalse_WhenBringUpInProgress) {
+	fake.saved = 1;
+	CHECK_TRUE(netup_start(done, NULL));
+
+	CHECK_FALSE(netup_start(done, NULL));
+
+	complete(WIFIMAN_SUCCESS);
+	LONGS_EQUAL(1, fake.done);
+}
+
+TEST(netup, start_ShouldStartAgain_WhenPreviousOneFinished) {
+	netup_start(done, NULL);
+	fake.last = WIFIMAN_SUCCESS;
+
+	CHECK_TRUE(netup_start(done, NULL));
+
+	LONGS_EQUAL(2, fake.done);
+	CHECK_TRUE(fake.connected);
+}
+
+TEST(netup, start_ShouldStartOverFromFirstSavedNetwork) {
+	fake.saved = 2;
+	netup_start(done, NULL);
+	complete(WIFIMAN_ERROR);
+	complete(WIFIMAN_ERROR);
+
+	netup_start(done, NULL);
+
+	STRCMP_EQUAL("ap0", fake.ssid);
+}
@@ -0,0 +1,292 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/TestHarness_c.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+extern "C" {
+#include "ota/protocol/http.h"
+#include "ota/protocol/mqtt.h"
+}
+
+#define IMAGE_SIZE			10000
+
+typedef enum {
+	SERVE_RANGE,
+	SERVE_IGNORING_RANGE,
+	SERVE_IGNORING_RANGE_WITHOUT_LENGTH,
+	SERVE_WRONG_RANGE,
+	SERVE_HALF_AND_CLOSE,
+	SERVE_NOT_FOUND,
+	SERVE_CHUNKED,
+} serve_mode_t;
+
+static struct {
+	int fd;
+	uint16_t port;
+	pthread_t thread;
+	serve_mode_t mode;
+	int requests;
+	char request[512];
+} server;
+
+static uint8_t image[IMAGE_SIZE];
+static uint8_t received[IMAGE_SIZE];
+static size_t received_len;
+
+static bool mqtt_report(void *context, const void *data, size_t datasize)
+{
+	return true;
+}
+
+const ota_protocol_t *ota_mqtt(void)
+{
+	static ota_protocol_t mqtt;
+	mqtt.name = "mqtt";
+	mqtt.report = mqtt_report;
+	return &mqtt;
+}
+
+static void send_response(int fd, const char *header,
+		const uint8_t *body, size_t body_len)
+{
+	send(fd, header, strlen(header), 0);
+	if (body_len > 0) {
+		send(fd, body, body_len, 0);
+	}
+}
+
+static void serve_request(int fd)
+{
+	char header[256];
+	size_t len = 0;
+	unsigned long start = 0, end = IMAGE_SIZE - 1;
+
+	while (len < sizeof(server.request) - 1) {
+		ssize_t n = recv(fd, &server.request[len],
+				sizeof(server.request) - 1 - len, 0);
+		if (n <= 0) {
+			return;
+		}
+		len += (size_t)n;
+		server.request[len] = '\0';
+		if (strstr(server.request, "\r\n\r\n") != NULL) {
+			break;
+		}
+	}
+
+	server.requests++;
+
+	const char *range = strstr(server.request, "Range: bytes=");
+	if (range != NULL) {
+		sscanf(range, "Range: bytes=%lu-%lu", &start, &end);
+	}
+	if (end >= IMAGE_SIZE) {
+		end = IMAGE_SIZE - 1;
+	}
+	size_t body_len = end - start + 1;
+
+	switch (server.mode) {
+	case SERVE_IGNORING_RANGE:
+		sprintf(header, "HTTP/1.1 200 OK\r\n"
+				"Content-Length: %d\r\n\r\n", IMAGE_SIZE);
+		send_response(fd, header, image, IMAGE_SIZE);
+		break;
+	case SERVE_IGNORING_RANGE_WITHOUT_LENGTH:
+		send_response(fd, "HTTP/1.1 200 OK\r\n\r\n",
+				image, IMAGE_SIZE);
+		break;
+	case SERVE_WRONG_RANGE:
+		start++;
+		/* fall through */
+	case SERVE_RANGE:
+	case SERVE_HALF_AND_CLOSE:
+		sprintf(header, "HTTP/1.1 206 Partial Content\r\n"
+				"content-range: bytes %lu-%lu/%d\r\n"
+				"Content-Length: %lu\r\n\r\n",
+				start, end, IMAGE_SIZE, (unsigned long)body_len);
+		if (server.mode == SERVE_HALF_AND_CLOSE) {
+			body_len /= 2;
+		}
+		send_response(fd, header, &image[start], body_len);
+		break;
+	case SERVE_CHUNKED:
+		send_response(fd, "HTTP/1.1 200 OK\r\n"
+				"Transfer-Encoding: chunked\r\n\r\n"
+				"4\r\nabcd\r\n0\r\n\r\n", NULL, 0);
+		break;
+	case SERVE_NOT_FOUND:
+	default:
+		send_response(fd, "HTTP/1.1 404 Not Found\r\n"
+				"Content-Length: 0\r\n\r\n", NULL, 0);
+		break;
+	}
+}
+
+static void *serve(void *context)
+{
+	int fd;
+
+	while ((fd = accept(server.fd, NULL, NULL)) >= 0) {
+		serve_request(fd);
+		close(fd);
+	}
+
+	return context;
+}
+
+static void start_server(void)
+{
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof(addr);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+
+	server.fd = socket(AF_INET, SOCK_STREAM, 0);
+	CHECK(server.fd >= 0);
+	LONGS_EQUAL(0, bind(server.fd, (struct sockaddr *)&addr, addrlen));
+	LONGS_EQUAL(0, listen(server.fd, 1));
+	getsockname(server.fd, (struct sockaddr *)&addr, &addrlen);
+	server.port = ntohs(addr.sin_port);
+
+	pthread_create(&server.thread, NULL, serve, NULL);
+}
+
+static void stop_server(void)
+{
+	shutdown(server.fd, SHUT_RDWR);
+	close(server.fd);
+	pthread_join(server.thread, NULL);
+}
+
+static void data_arrived(void *context, const void *data, size_t datasize)
+{
+	memcpy(&received[received_len], data, datasize);
+	received_len += datasize;
+}
+
+TEST_GROUP(ota_http) {
+	const ota_protocol_t *http;
+	char url[64];
+
+	void setup(void) {
+		for (int i = 0; i < IMAGE_SIZE; i++) {
+			image[i] = (uint8_t)(i * 7 + (i >> 8));
+		}
+		memset(received, 0, sizeof(received));
+		received_len = 0;
+
+		memset(&server, 0, sizeof(server));
+		start_server();
+		sprintf(url, "http://127.0.0.1:%u/fw.bin", server.port);
+
+		http = ota_http();
+	}
+	void teardown() {
+		stop_server();
+	}
+
+	bool download(size_t offset, size_t size) {
+		return http->download(NULL, url, offset, size,
+				data_arrived, NULL);
+	}
+};
+
+TEST(ota_http, ota_http_ShouldKeepHandshakeOnMqtt) {
+	STRCMP_EQUAL("http", http->name);
+	POINTERS_EQUAL(ota_mqtt()->report, http->report);
+	CHECK(http->download != NULL);
+}
+
+TEST(ota_http, download_ShouldRequestTheRange) {
+	CHECK(download(100, 100));
+	CHECK(strstr(server.request, "GET /fw.bin HTTP/1.1\r\n") != NULL);
+	CHECK(strstr(server.request, "Range: bytes=100-199\r\n") != NULL);
+	char host[32];
+	sprintf(host, "Host: 127.0.0.1:%u\r\n", server.port);
+	CHECK(strstr(server.request, host) != NULL);
+}
+
+TEST(ota_http, download_ShouldDeliverTheRange) {
+	CHECK(download(1000, 5000));
+	LONGS_EQUAL(5000, received_len);
+	MEMCMP_EQUAL(&image[1000], received, 5000);
+}
+
+TEST(ota_http, download_ShouldDeliverTheLastRange) {
+	CHECK(download(IMAGE_SIZE - 10, 10));
+	LONGS_EQUAL(10, received_len);
+	MEMCMP_EQUAL(&image[IMAGE_SIZE - 10], received, 10);
+}
+
+TEST(ota_http, download_ShouldTakeWholeImage_WhenServerIgnoresRange) {
+	server.mode = SERVE_IGNORING_RANGE;
+	CHECK(download(0, 3000));
+	LONGS_EQUAL(IMAGE_SIZE, received_len);
+	MEMCMP_EQUAL(image, received, IMAGE_SIZE);
+	LONGS_EQUAL(1, server.requests);
+}
+
+TEST(ota_http, download_ShouldSkipToOffset_WhenServerIgnoresRange) {
+	server.mode = SERVE_IGNORING_RANGE;
+	CHECK(download(3000, 3000));
+	LONGS_EQUAL(IMAGE_SIZE - 3000, received_len);
+	MEMCMP_EQUAL(&image[3000], received, IMAGE_SIZE - 3000);
+}
+
+TEST(ota_http, download_ShouldStopAtRange_WhenServerIgnoresRangeWithoutLength) {
+	server.mode = SERVE_IGNORING_RANGE_WITHOUT_LENGTH;
+	CHECK(download(3000, 2000));
+	LONGS_EQUAL(2000, received_len);
+	MEMCMP_EQUAL(&image[3000], received, 2000);
+}
+
+TEST(ota_http, download_ShouldFail_WhenTransferEncodingIsChunked) {
+	server.mode = SERVE_CHUNKED;
+	CHECK_FALSE(download(0, 100));
+	LONGS_EQUAL(0, received_len);
+}
+
+TEST(ota_http, download_ShouldFail_WhenServerRespondsWithAnotherRange) {
+	server.mode = SERVE_WRONG_RANGE;
+	CHECK_FALSE(download(3000, 100));
+	LONGS_EQUAL(0, received_len);
+}
+
+TEST(ota_http, download_ShouldDeliverWhatArrived_WhenConnectionClosedEarly) {
+	server.mode = SERVE_HALF_AND_CLOSE;
+	CHECK_FALSE(download(2000, 4000));
+	LONGS_EQUAL(2000, received_len);
+	MEMCMP_EQUAL(&image[2000], received, 2000);
+}
+
+TEST(ota_http, download_ShouldFail_WhenStatusIsNotSuccess) {
+	server.mode = SERVE_NOT_FOUND;
+	CHECK_FALSE(download(0, 100));
+	LONGS_EQUAL(0, received_len);
+}
+
+TEST(ota_http, download_ShouldFail_WhenSchemeIsNotHttp) {
+	CHECK_FALSE(http->download(NULL, "https://127.0.0.1/fw.bin", 0, 100,
+				data_arrived, NULL));
+	LONGS_EQUAL(0, server.requests);
+}
+
+TEST(ota_http, download_ShouldFail_WhenHostIsMissing) {
+	CHECK_FALSE(http->download(NULL, "http:///fw.bin", 0, 100,
+				data_arrived, NULL));
+	LONGS_EQUAL(0, server.requests);
+}
+
+TEST(ota_http, download_ShouldDoNothing_WhenSizeIsZero) {
+	CHECK(download(0, 0));
+	LONGS_EQUAL(0, server.requests);
+}
@@ -0,0 +1,134 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/TestHarness_c.h"
+
+#include <string.h>
+
+extern "C" {
+#include "profile.h"
+}
+
+static struct profile_sample fake;
+
+void profile_hw_sample(struct profile_sample *sample)
+{
+	*sample = fake;
+}
+
+static void add_task(uint32_t id, const char *name, uint32_t runtime)
+{
+	struct profile_task *task = &fake.tasks[fake.nr_tasks++];
+
+	task->id = id;
+	task->runtime = runtime;
+	task->stack_free = 512;
+	task->prio = 5;
+	strncpy(task->name, name, PROFILE_TASK_NAME_MAXLEN);
+}
+
+static uint32_t get_varint(const uint8_t **p)
+{
+	uint32_t value = 0;
+
+	for (unsigned int shift = 0; ; shift += 7) {
+		uint8_t byte = *(*p)++;
+		value |= (uint32_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			return value;
+		}
+	}
+}
+
+TEST_GROUP(profile) {
+	uint8_t buf[128];
+
+	void setup(void) {
+		memset(&fake, 0, sizeof(fake));
+		memset(buf, 0, sizeof(buf));
+		profile_init();
+	}
+	void teardown() {
+	}
+
+	/* cpu share of the nth task in the encoded */
+	uint32_t get_cpu(unsigned int n) {
+		const uint8_t *p = &buf[2];
+
+		get_varint(&p);
+		get_varint(&p);
+		p++; /* nr_tasks */
+
+		for (unsigned int i = 0; ; i++) {
+			p += *p + 1 + 1; /* name and prio */
+			uint32_t cpu = get_varint(&p);
+			if (i == n) {
+				return cpu;
+			}
+			get_varint(&p);
+		}
+	}
+};
+
+TEST(profile, encode_ShouldWriteHeaderAndTasks) {
+	const uint8_t expected[] = {
+		'P', 1,
+		0xb0, 0xea, 0x01, /* 30000 */
+		0xa0, 0x9c, 0x01, /* 20000 */
+		1,
+		4, 'm', 'a', 'i', 'n', 5,
+		0xfa, 0x01, /* 250 */
+		0x80, 0x04, /* 512 */
+	};
+
+	fake.free_heap = 30000;
+	fake.min_free_heap = 20000;
+	fake.total_runtime = 1000;
+	add_task(1, "main", 250);
+
+	LONGS_EQUAL(sizeof(expected), profile_encode(buf, sizeof(buf)));
+	MEMCMP_EQUAL(expected, buf, sizeof(expected));
+}
+
+TEST(profile, encode_ShouldReportCpuShareSincePreviousProfile) {
+	fake.total_runtime = 1000;
+	add_task(1, "idle", 500);
+	add_task(2, "wifi", 100);
+	profile_encode(buf, sizeof(buf));
+
+	fake.total_runtime = 2000;
+	fake.tasks[0].runtime = 1400;
+	fake.tasks[1].runtime = 200;
+	profile_encode(buf, sizeof(buf));
+
+	LONGS_EQUAL(900, get_cpu(0));
+	LONGS_EQUAL(100, get_cpu(1));
+}
+
+TEST(profile, encode_ShouldCountNewTaskFromZero) {
+	fake.total_runtime = 1000;
+	add_task(1, "idle", 1000);
+	profile_encode(buf, sizeof(buf));
+
+	fake.total_runtime = 2000;
+	fake.tasks[0].runtime = 1700;
+	add_task(7, "ota", 300);
+	profile_encode(buf, sizeof(buf));
+
+	LONGS_EQUAL(700, get_cpu(0));
+	LONGS_EQUAL(300, get_cpu(1));
+}
+
+TEST(profile, encode_ShouldReportZeroCpu_WhenNoRuntimeStats) {
+	add_task(1, "idle", 0);
+	CHECK(profile_encode(buf, sizeof(buf)) > 0);
+	LONGS_EQUAL(0, get_cpu(0));
+}
+
+TEST(profile, encode_ShouldKeepInterval_WhenBufferTooSmall) {
+	fake.total_runtime = 1000;
+	add_task(1, "idle", 500);
+
+	LONGS_EQUAL(0, profile_encode(buf, 8));
+
+	CHECK(profile_encode(buf, sizeof(buf)) > 0);
+	LONGS_EQUAL(500, get_cpu(0));
+}
@@ -0,0 +1,119 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/TestHarness_c.h"
+
+#include <string.h>
+#include "roaming.h"
+#include "wifi.h"
+#include "uptime.h"
+
+static struct {
+	bool connected;
+	int8_t rssi;
+	int8_t rssi_after_roam;
+	wifiman_error_t roam_result;
+	int roams;
+	unsigned int now;
+	int roamed;
+} fake;
+
+bool wifiman_is_connected(void)
+{
+	return fake.connected;
+}
+
+int8_t wifiman_get_rssi(void)
+{
+	return fake.rssi;
+}
+
+wifiman_error_t wifiman_roam(uint8_t min_gain_db)
+{
+	fake.roams++;
+	if (fake.roam_result == WIFIMAN_SUCCESS) {
+		fake.rssi = fake.rssi_after_roam;
+	}
+	return fake.roam_result;
+}
+
+unsigned int uptime_get_ms(void)
+{
+	return fake.now;
+}
+
+static void roamed(void *context)
+{
+	fake.roamed++;
+}
+
+TEST_GROUP(roaming) {
+	void setup(void) {
+		memset(&fake, 0, sizeof(fake));
+		fake.connected = true;
+		fake.rssi = -50;
+		fake.rssi_after_roam = -50;
+		fake.roam_result = WIFIMAN_ERROR;
+		fake.now = 1000;
+		roaming_init(roamed, NULL);
+	}
+	void teardown() {
+	}
+
+	void poll_at(unsigned int ms) {
+		fake.now = ms;
+		roaming_poll();
+	}
+};
+
+TEST(roaming, poll_ShouldNotRoam_WhenSignalIsGood) {
+	poll_at(1000000);
+	LONGS_EQUAL(0, fake.roams);
+}
+
+TEST(roaming, poll_ShouldNotRoam_WhenDisconnected) {
+	fake.connected = false;
+	fake.rssi = -90;
+	poll_at(1000000);
+	LONGS_EQUAL(0, fake.roams);
+}
+
+TEST(roaming, poll_ShouldNotRoam_WhenWeakRightAfterInit) {
+	fake.rssi = -90;
+	poll_at(2000);
+	LONGS_EQUAL(0, fake.roams);
+}
+
+TEST(roaming, poll_ShouldRoam_WhenSignalDropsBelowThreshold) {
+	fake.rssi = -90;
+	fake.rssi_after_roam = -55;
+	fake.roam_result = WIFIMAN_SUCCESS;
+	poll_at(100000);
+	LONGS_EQUAL(1, fake.roams);
+	LONGS_EQUAL(1, fake.roamed);
+}
+
+TEST(roaming, poll_ShouldBackOff_WhenNothingBetterFound) {
+	fake.rssi = -90;
+	poll_at(100000);
+	LONGS_EQUAL(1, fake.roams);
+	poll_at(100000 + 30000);
+	LONGS_EQUAL(1, fake.roams);
+	poll_at(100000 + 60000);
+	LONGS_EQUAL(2, fake.roams);
+	poll_at(100000 + 60000 + 60000);
+	LONGS_EQUAL(2, fake.roams);
+	poll_at(100000 + 60000 + 120000);
+	LONGS_EQUAL(3, fake.roams);
+	LONGS_EQUAL(0, fake.roamed);
+}
+
+TEST(roaming, poll_ShouldResetBackOff_WhenSignalRecovers) {
+	fake.rssi = -90;
+	poll_at(100000);
+	poll_at(160000);
+	LONGS_EQUAL(2, fake.roams);
+	fake.rssi = -50;
+	poll_at(170000);
+	fake.rssi = -90;
+	poll_at(190000);
+	LONGS_EQUAL(3, fake.roams);
+}
@@ -0,0 +1,200 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/TestHarness_c.h"
+
+#include <stdio.h>
+#include <string.h>
+
+extern "C" {
+#include "rules.h"
+#include "flash_kvstore.h"
+#include "fake_flash.h"
+}
+
+#define FLASH_FILE			"rules_test.bin"
+#define SECTOR_SIZE			1024
+#define NR_SECTORS			2
+
+static struct {
+	uint32_t switches;
+	int sets;
+	int minute;
+	char published[32];
+	int publishes;
+} fake;
+
+static void set_switches(uint32_t mask, uint32_t states)
+{
+	fake.switches = (fake.switches & ~mask) | (states & mask);
+	fake.sets++;
+}
+
+static uint32_t get_switches(void)
+{
+	return fake.switches;
+}
+
+static bool publish(const void *payload, size_t payload_size)
+{
+	memcpy(fake.published, payload, payload_size);
+	fake.published[payload_size] = '\0';
+	fake.publishes++;
+	return true;
+}
+
+static int get_minute_of_day(void)
+{
+	return fake.minute;
+}
+
+static const struct rules_ops ops = {
+	.set_switches = set_switches,
+	.get_switches = get_switches,
+	.publish = publish,
+	.get_minute_of_day = get_minute_of_day,
+};
+
+TEST_GROUP(rules) {
+	kvstore_t *kvstore;
+
+	void setup(void) {
+		memset(&fake, 0, sizeof(fake));
+		fake.minute = -1;
+		remove(FLASH_FILE);
+		open();
+	}
+	void teardown() {
+		close();
+		remove(FLASH_FILE);
+	}
+
+	void open(void) {
+		const dfu_io_t *io = fake_flash_open(FLASH_FILE,
+				SECTOR_SIZE * NR_SECTORS, SECTOR_SIZE);
+		kvstore = flash_kvstore_new(io, 0, SECTOR_SIZE, NR_SECTORS);
+		rules_init(&ops, kvstore);
+	}
+	void close(void) {
+		flash_kvstore_delete(kvstore);
+		fake_flash_close();
+	}
+};
+
+TEST(rules, update_ShouldAcceptEmptyTable) {
+	CHECK(rules_update(NULL, 0));
+	LONGS_EQUAL(0, rules_count());
+}
+
+TEST(rules, update_ShouldReject_WhenHeaderIsWrong) {
+	const uint8_t table[] = { 'R', 'X', 1, 0 };
+	CHECK_FALSE(rules_update(table, sizeof(table)));
+}
+
+TEST(rules, update_ShouldReject_WhenOpIsTruncated) {
+	const uint8_t table[] = { 'R', 'L', 1, 1,
+		RULE_TRIGGER_BUTTON, 0, 0, 2, RULE_OP_SET, 0x01 };
+	CHECK_FALSE(rules_update(table, sizeof(table)));
+}
+
+TEST(rules, update_ShouldReject_WhenOpIsUnknown) {
+	const uint8_t table[] = { 'R', 'L', 1, 1,
+		RULE_TRIGGER_BUTTON, 0, 0, 2, 0x7f, 0x01 };
+	CHECK_FALSE(rules_update(table, sizeof(table)));
+}
+
+TEST(rules, trigger_ShouldRunActions_WhenButtonPressed) {
+	const uint8_t table[] = { 'R', 'L', 1, 1,
+		RULE_TRIGGER_BUTTON, 1, 0, 3, RULE_OP_SET, 0x03, 0x03 };
+	CHECK(rules_update(table, sizeof(table)));
+	LONGS_EQUAL(1, rules_trigger(RULE_TRIGGER_BUTTON, 1, 0, NULL, 0));
+	LONGS_EQUAL(3, fake.switches);
+	LONGS_EQUAL(0, rules_trigger(RULE_TRIGGER_BUTTON, 0, 0, NULL, 0));
+	LONGS_EQUAL(1, fake.sets);
+}
+
+TEST(rules, trigger_ShouldSkipActions_WhenConditionFails) {
+	const uint8_t table[] = { 'R', 'L', 1, 1,
+		RULE_TRIGGER_BUTTON, 0, 0, 5,
+			RULE_OP_IF_SWITCH, 0x02, 0x02,
+			RULE_OP_TOGGLE, 0x01 };
+	CHECK(rules_update(table, sizeof(table)));
+	LONGS_EQUAL(0, rules_trigger(RULE_TRIGGER_BUTTON, 0, 0, NULL, 0));
+	LONGS_EQUAL(0, fake.sets);
+
+	fake.switches = 0x02;
+	LONGS_EQUAL(1, rules_trigger(RULE_TRIGGER_BUTTON, 0, 0, NULL, 0));
+	LONGS_EQUAL(0x03, fake.switches);
+}
+
+TEST(rules, trigger_ShouldMatchPayload_WhenTopicTriggered) {
+	const uint8_t table[] = { 'R', 'L', 1, 2,
+		RULE_TRIGGER_TOPIC, 3, 0, 10,
+			RULE_OP_IF_PAYLOAD, 5, 'n', 'i', 'g', 'h', 't',
+			RULE_OP_SET, 0x03, 0x00,
+		RULE_TRIGGER_TOPIC, 3, 0, 9,
+			RULE_OP_IF_PAYLOAD, 4, 'h', 'o', 'm', 'e',
+			RULE_OP_PUBLISH, 1, 'h' };
+	CHECK(rules_update(table, sizeof(table)));
+	fake.switches = 0x03;
+	LONGS_EQUAL(1, rules_trigger(RULE_TRIGGER_TOPIC, 3, 0, "night", 5));
+	LONGS_EQUAL(0, fake.switches);
+	LONGS_EQUAL(0, fake.publishes);
+	LONGS_EQUAL(1, rules_trigger(RULE_TRIGGER_TOPIC, 3, 0, "home", 4));
+	STRCMP_EQUAL("h", fake.published);
+}
+
+TEST(rules, trigger_ShouldCompareSensorValue) {
+	const uint8_t table[] = { 'R', 'L', 1, 2,
+		RULE_TRIGGER_SENSOR, 7, 0, 6,
+			RULE_OP_IF_VALUE_GT, 0xf4, 0x01, /* 500 */
+			RULE_OP_SET, 0x01, 0x00,
+		RULE_TRIGGER_SENSOR, 7, 0, 6,
+			RULE_OP_IF_VALUE_LT, 0xf6, 0xff, /* -10 */
+			RULE_OP_SET, 0x01, 0x01 };
+	CHECK(rules_update(table, sizeof(table)));
+	fake.switches = 0x01;
+	LONGS_EQUAL(0, rules_trigger(RULE_TRIGGER_SENSOR, 7, 500, NULL, 0));
+	LONGS_EQUAL(1, rules_trigger(RULE_TRIGGER_SENSOR, 7, 501, NULL, 0));
+	LONGS_EQUAL(0, fake.switches);
+	LONGS_EQUAL(1, rules_trigger(RULE_TRIGGER_SENSOR, 7, -11, NULL, 0));
+	LONGS_EQUAL(1, fake.switches);
+}
+
+TEST(rules, poll_ShouldFireTimeRules_OnceAMinute) {
+	const uint8_t table[] = { 'R', 'L', 1, 1,
+		RULE_TRIGGER_TIME, 0xa4, 0x01, 2, /* 7:00 */
+			RULE_OP_TOGGLE, 0x01 };
+	CHECK(rules_update(table, sizeof(table)));
+	rules_poll();
+	LONGS_EQUAL(0, fake.sets);
+	fake.minute = 419;
+	rules_poll();
+	LONGS_EQUAL(0, fake.sets);
+	fake.minute = 420;
+	rules_poll();
+	rules_poll();
+	LONGS_EQUAL(1, fake.sets);
+}
+
+TEST(rules, trigger_ShouldCheckTimeWindow_AcrossMidnight) {
+	const uint8_t table[] = { 'R', 'L', 1, 1,
+		RULE_TRIGGER_BUTTON, 0, 0, 8,
+			RULE_OP_IF_TIME, 0x38, 0x04, 0x68, 0x01, /* 18:00-6:00 */
+			RULE_OP_SET, 0x01, 0x01 };
+	CHECK(rules_update(table, sizeof(table)));
+	fake.minute = 720;
+	LONGS_EQUAL(0, rules_trigger(RULE_TRIGGER_BUTTON, 0, 0, NULL, 0));
+	fake.minute = 1380;
+	LONGS_EQUAL(1, rules_trigger(RULE_TRIGGER_BUTTON, 0, 0, NULL, 0));
+	fake.minute = 60;
+	LONGS_EQUAL(1, rules_trigger(RULE_TRIGGER_BUTTON, 0, 0, NULL, 0));
+}
+
+TEST(rules, init_ShouldLoadTableSaved) {
+	const uint8_t table[] = { 'R', 'L', 1, 1,
+		RULE_TRIGGER_BUTTON, 0, 0, 3, RULE_OP_SET, 0x01, 0x01 };
+	CHECK(rules_update(table, sizeof(table)));
+	close();
+	open();
+	LONGS_EQUAL(1, rules_count());
+	LONGS_EQUAL(1, rules_trigger(RULE_TRIGGER_BUTTON, 0, 0, NULL, 0));
+}
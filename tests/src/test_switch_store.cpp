@@ -0,0 +1,118 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/TestHarness_c.h"
+
+#include <stdio.h>
+#include <string.h>
+
+extern "C" {
+#include "switch_store.h"
+#include "flash_kvstore.h"
+#include "fake_flash.h"
+#include "uptime.h"
+}
+
+#define FLASH_FILE			"switch_store_test.bin"
+#define SECTOR_SIZE			512
+#define NR_SECTORS			2
+
+static unsigned int now;
+
+unsigned int uptime_get_ms(void)
+{
+	return now;
+}
+
+TEST_GROUP(switch_store) {
+	kvstore_t *kvstore;
+
+	void setup(void) {
+		now = 1000;
+		remove(FLASH_FILE);
+		open();
+	}
+	void teardown() {
+		close();
+		remove(FLASH_FILE);
+	}
+
+	void open(void) {
+		const dfu_io_t *io = fake_flash_open(FLASH_FILE,
+				SECTOR_SIZE * NR_SECTORS, SECTOR_SIZE);
+		kvstore = flash_kvstore_new(io, 0, SECTOR_SIZE, NR_SECTORS);
+		switch_store_init(kvstore);
+	}
+	void close(void) {
+		flash_kvstore_delete(kvstore);
+		fake_flash_close();
+	}
+	void reboot(void) {
+		close();
+		open();
+	}
+};
+
+TEST(switch_store, load_ShouldReturnFalse_WhenNothingSaved) {
+	uint32_t state;
+	CHECK_FALSE(switch_store_load(&state));
+}
+
+TEST(switch_store, load_ShouldReturnSavedState_AfterReboot) {
+	uint32_t state = 0;
+	switch_store_save(5);
+	reboot();
+	CHECK(switch_store_load(&state));
+	LONGS_EQUAL(5, state);
+}
+
+TEST(switch_store, save_ShouldCoalesceWrites_WhenToggledWithinInterval) {
+	switch_store_save(1);
+	unsigned int writes = fake_flash_write_count();
+	for (uint32_t i = 0; i < 100; i++) {
+		now += 10;
+		switch_store_save(i & 1);
+	}
+	switch_store_save(2);
+	LONGS_EQUAL(writes, fake_flash_write_count());
+
+	now += 5000;
+	switch_store_poll();
+	CHECK(fake_flash_write_count() > writes);
+
+	uint32_t state = 0;
+	reboot();
+	CHECK(switch_store_load(&state));
+	LONGS_EQUAL(2, state);
+}
+
+TEST(switch_store, save_ShouldNotWrite_WhenStateIsBackToSaved) {
+	switch_store_save(1);
+	unsigned int writes = fake_flash_write_count();
+	switch_store_save(0);
+	switch_store_save(1);
+	now += 5000;
+	switch_store_poll();
+	LONGS_EQUAL(writes, fake_flash_write_count());
+}
+
+TEST(switch_store, flush_ShouldWritePendingAtOnce) {
+	switch_store_save(1);
+	switch_store_save(3);
+	CHECK(switch_store_flush());
+
+	uint32_t state = 0;
+	reboot();
+	CHECK(switch_store_load(&state));
+	LONGS_EQUAL(3, state);
+}
+
+TEST(switch_store, load_ShouldReturnTheLatest_WhenSlotsWrappedAround) {
+	for (uint32_t i = 0; i < 20; i++) {
+		switch_store_save(i);
+		switch_store_flush();
+	}
+
+	uint32_t state = 0;
+	reboot();
+	CHECK(switch_store_load(&state));
+	LONGS_EQUAL(19, state);
+}
@@ -0,0 +1,204 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/TestHarness_c.h"
+
+#include <string.h>
+
+extern "C" {
+#include "wifiman_event.h"
+#include "libmcu/pubsub.h"
+}
+
+#define LISTENERS_MAX			8
+
+static struct {
+	struct {
+		pubsub_subscribe_t *obj;
+		const char *topic;
+		pubsub_callback_t cb;
+		void *context;
+	} subs[LISTENERS_MAX];
+	int published;
+} fake;
+
+static struct {
+	int calls;
+	wifiman_event_t event;
+} received[LISTENERS_MAX + 1];
+
+pubsub_subscribe_t *pubsub_subscribe_static(pubsub_subscribe_t *obj,
+		const char *topic_filter, pubsub_callback_t cb, void *context)
+{
+	for (int i = 0; i < LISTENERS_MAX; i++) {
+		if (fake.subs[i].obj == NULL) {
+			fake.subs[i].obj = obj;
+			fake.subs[i].topic = topic_filter;
+			fake.subs[i].cb = cb;
+			fake.subs[i].context = context;
+			return obj;
+		}
+	}
+	return NULL;
+}
+
+pubsub_error_t pubsub_unsubscribe(pubsub_subscribe_t *obj)
+{
+	for (int i = 0; i < LISTENERS_MAX; i++) {
+		if (fake.subs[i].obj == obj) {
+			memset(&fake.subs[i], 0, sizeof(fake.subs[i]));
+			return PUBSUB_SUCCESS;
+		}
+	}
+	return PUBSUB_ERROR;
+}
+
+pubsub_error_t pubsub_publish(const char *topic_name,
+		const void *msg, size_t msglen)
+{
+	fake.published++;
+	for (int i = 0; i < LISTENERS_MAX; i++) {
+		if (fake.subs[i].obj != NULL
+				&& strcmp(fake.subs[i].topic, topic_name) == 0) {
+			fake.subs[i].cb(fake.subs[i].context, msg, msglen);
+		}
+	}
+	return PUBSUB_SUCCESS;
+}
+
+#define DEFINE_HANDLER(n) \
+	static void handler##n(wifiman_event_t event, void *context) { \
+		received[n].calls++; \
+		received[n].event = event; \
+	}
+DEFINE_HANDLER(0)
+DEFINE_HANDLER(1)
+DEFINE_HANDLER(2)
+DEFINE_HANDLER(3)
+DEFINE_HANDLER(4)
+DEFINE_HANDLER(5)
+DEFINE_HANDLER(6)
+DEFINE_HANDLER(7)
+DEFINE_HANDLER(8)
+
+static const wifiman_event_handler_t handlers[LISTENERS_MAX + 1] = {
+	handler0, handler1, handler2, handler3, handler4,
+	handler5, handler6, handler7, handler8,
+};
+
+TEST_GROUP(wifiman_event) {
+	void setup(void) {
+		memset(&fake, 0, sizeof(fake));
+		memset(received, 0, sizeof(received));
+	}
+	void teardown() {
+		for (int i = WIFIMAN_EVENT_UNKNOWN + 1;
+				i < WIFIMAN_EVENT_MAX; i++) {
+			for (int j = 0; j < LISTENERS_MAX + 1; j++) {
+				wifiman_unregister_event_handler(
+						(wifiman_event_t)i,
+						handlers[j]);
+			}
+		}
+	}
+};
+
+TEST(wifiman_event, register_ShouldReturnInvalidParam_WhenEventOutOfRange) {
+	LONGS_EQUAL(WIFIMAN_INVALID_PARAM, wifiman_register_event_handler(
+				WIFIMAN_EVENT_UNKNOWN, handler0));
+	LONGS_EQUAL(WIFIMAN_INVALID_PARAM, wifiman_register_event_handler(
+				WIFIMAN_EVENT_MAX, handler0));
+}
+
+TEST(wifiman_event, register_ShouldReturnInvalidParam_WhenHandlerIsNull) {
+	LONGS_EQUAL(WIFIMAN_INVALID_PARAM, wifiman_register_event_handler(
+				WIFIMAN_EVENT_CONNECTED, NULL));
+}
+
+TEST(wifiman_event, publish_ShouldDeliverToHandlerOfTheEvent) {
+	LONGS_EQUAL(WIFIMAN_SUCCESS, wifiman_register_event_handler(
+				WIFIMAN_EVENT_CONNECTED, handler0));
+	LONGS_EQUAL(WIFIMAN_SUCCESS, wifiman_register_event_handler(
+				WIFIMAN_EVENT_DISCONNECTED, handler1));
+
+	wifiman_event_publish(WIFIMAN_EVENT_CONNECTED);
+
+	LONGS_EQUAL(1, received[0].calls);
+	LONGS_EQUAL(WIFIMAN_EVENT_CONNECTED, received[0].event);
+	LONGS_EQUAL(0, received[1].calls);
+}
+
+TEST(wifiman_event, publish_ShouldFanOutToAllHandlersOfTheEvent) {
+	for (int i = 0; i < LISTENERS_MAX; i++) {
+		LONGS_EQUAL(WIFIMAN_SUCCESS, wifiman_register_event_handler(
+					WIFIMAN_EVENT_IP_ALLOCATED,
+					handlers[i]));
+	}
+
+	wifiman_event_publish(WIFIMAN_EVENT_IP_ALLOCATED);
+
+	for (int i = 0; i < LISTENERS_MAX; i++) {
+		LONGS_EQUAL(1, received[i].calls);
+		LONGS_EQUAL(WIFIMAN_EVENT_IP_ALLOCATED, received[i].event);
+	}
+}
+
+TEST(wifiman_event, publish_ShouldIgnore_WhenEventOutOfRange) {
+	wifiman_event_publish(WIFIMAN_EVENT_UNKNOWN);
+	wifiman_event_publish(WIFIMAN_EVENT_MAX);
+	LONGS_EQUAL(0, fake.published);
+}
+
+TEST(wifiman_event, register_ShouldNotDuplicate_WhenRegisteredTwice) {
+	LONGS_EQUAL(WIFIMAN_SUCCESS, wifiman_register_event_handler(
+				WIFIMAN_EVENT_READY, handler0));
+	LONGS_EQUAL(WIFIMAN_SUCCESS, wifiman_register_event_handler(
+				WIFIMAN_EVENT_READY, handler0));
+
+	wifiman_event_publish(WIFIMAN_EVENT_READY);
+
+	LONGS_EQUAL(1, received[0].calls);
+}
+
+TEST(wifiman_event, register_ShouldReturnError_WhenNoRoomLeft) {
+	for (int i = 0; i < LISTENERS_MAX; i++) {
+		wifiman_register_event_handler(WIFIMAN_EVENT_SCAN_COMPLETED,
+				handlers[i]);
+	}
+
+	LONGS_EQUAL(WIFIMAN_ERROR, wifiman_register_event_handler(
+				WIFIMAN_EVENT_SCAN_COMPLETED,
+				handlers[LISTENERS_MAX]));
+}
+
+TEST(wifiman_event, unregister_ShouldStopDelivery) {
+	wifiman_register_event_handler(WIFIMAN_EVENT_CONNECTED, handler0);
+	wifiman_register_event_handler(WIFIMAN_EVENT_CONNECTED, handler1);
+
+	LONGS_EQUAL(WIFIMAN_SUCCESS, wifiman_unregister_event_handler(
+				WIFIMAN_EVENT_CONNECTED, handler0));
+	wifiman_event_publish(WIFIMAN_EVENT_CONNECTED);
+
+	LONGS_EQUAL(0, received[0].calls);
+	LONGS_EQUAL(1, received[1].calls);
+}
+
+TEST(wifiman_event, unregister_ShouldMakeRoomForAnother) {
+	for (int i = 0; i < LISTENERS_MAX; i++) {
+		wifiman_register_event_handler(WIFIMAN_EVENT_CONNECTED,
+				handlers[i]);
+	}
+
+	wifiman_unregister_event_handler(WIFIMAN_EVENT_CONNECTED, handler3);
+
+	LONGS_EQUAL(WIFIMAN_SUCCESS, wifiman_register_event_handler(
+				WIFIMAN_EVENT_DISCONNECTED,
+				handlers[LISTENERS_MAX]));
+	wifiman_event_publish(WIFIMAN_EVENT_DISCONNECTED);
+	LONGS_EQUAL(1, received[LISTENERS_MAX].calls);
+}
+
+TEST(wifiman_event, unregister_ShouldReturnInvalidParam_WhenNotRegistered) {
+	LONGS_EQUAL(WIFIMAN_INVALID_PARAM, wifiman_unregister_event_handler(
+				WIFIMAN_EVENT_CONNECTED, handler0));
+	LONGS_EQUAL(WIFIMAN_INVALID_PARAM, wifiman_unregister_event_handler(
+				WIFIMAN_EVENT_UNKNOWN, handler0));
+}
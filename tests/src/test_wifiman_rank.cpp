@@ -0,0 +1,126 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/TestHarness_c.h"
+
+#include <string.h>
+#include "wifiman_rank.h"
+
+TEST_GROUP(wifiman_rank) {
+	wifiman_network_profile_t scanlist[8];
+	wifiman_saved_network_t saved[4];
+	wifiman_candidate_t candidates[4];
+	int nr_scanned;
+	int nr_saved;
+
+	void setup(void) {
+		memset(scanlist, 0, sizeof(scanlist));
+		memset(saved, 0, sizeof(saved));
+		memset(candidates, 0, sizeof(candidates));
+		nr_scanned = 0;
+		nr_saved = 0;
+	}
+	void teardown() {
+	}
+
+	void scanned(const char *ssid, int8_t rssi, uint8_t bssid_last,
+			wifiman_security_t security) {
+		wifiman_network_profile_t *p = &scanlist[nr_scanned++];
+		strcpy(p->ssid, ssid);
+		p->rssi = rssi;
+		p->bssid[5] = bssid_last;
+		p->channel = bssid_last;
+		p->security = security;
+	}
+	void saved_as(const char *ssid, uint8_t index,
+			uint8_t attempts, uint8_t successes) {
+		wifiman_saved_network_t *p = &saved[nr_saved++];
+		p->ssid = ssid;
+		p->index = index;
+		p->attempts = attempts;
+		p->successes = successes;
+	}
+	int rank(void) {
+		return wifiman_rank(candidates, 4, scanlist, nr_scanned,
+				saved, nr_saved);
+	}
+};
+
+TEST(wifiman_rank, rank_ShouldReturnZero_WhenNothingSaved) {
+	scanned("home", -50, 1, WIFIMAN_SECURITY_WPA2);
+	LONGS_EQUAL(0, rank());
+}
+
+TEST(wifiman_rank, rank_ShouldReturnZero_WhenNoSavedNetworkVisible) {
+	scanned("neighbor", -50, 1, WIFIMAN_SECURITY_WPA2);
+	saved_as("home", 0, 0, 0);
+	LONGS_EQUAL(0, rank());
+}
+
+TEST(wifiman_rank, rank_ShouldPickStrongestBssid_WhenSsidShared) {
+	scanned("home", -80, 1, WIFIMAN_SECURITY_WPA2);
+	scanned("home", -45, 2, WIFIMAN_SECURITY_WPA2);
+	scanned("home", -60, 3, WIFIMAN_SECURITY_WPA2);
+	saved_as("home", 5, 0, 0);
+
+	LONGS_EQUAL(1, rank());
+	LONGS_EQUAL(5, candidates[0].index);
+	LONGS_EQUAL(2, candidates[0].bssid[5]);
+	LONGS_EQUAL(2, candidates[0].channel);
+	LONGS_EQUAL(-45, candidates[0].rssi);
+}
+
+TEST(wifiman_rank, rank_ShouldStickToBssid_WhenSavedWithBssid) {
+	const uint8_t bssid[WIFIMAN_BSSID_MAXLEN] = { 0, 0, 0, 0, 0, 3 };
+	scanned("home", -45, 2, WIFIMAN_SECURITY_WPA2);
+	scanned("home", -70, 3, WIFIMAN_SECURITY_WPA2);
+	saved_as("home", 0, 0, 0);
+	saved[0].bssid = bssid;
+
+	LONGS_EQUAL(1, rank());
+	LONGS_EQUAL(3, candidates[0].bssid[5]);
+	LONGS_EQUAL(-70, candidates[0].rssi);
+}
+
+TEST(wifiman_rank, rank_ShouldSortByRssi) {
+	scanned("a", -80, 1, WIFIMAN_SECURITY_WPA2);
+	scanned("b", -50, 2, WIFIMAN_SECURITY_WPA2);
+	scanned("c", -65, 3, WIFIMAN_SECURITY_WPA2);
+	saved_as("a", 0, 0, 0);
+	saved_as("b", 1, 0, 0);
+	saved_as("c", 2, 0, 0);
+
+	LONGS_EQUAL(3, rank());
+	LONGS_EQUAL(1, candidates[0].index);
+	LONGS_EQUAL(2, candidates[1].index);
+	LONGS_EQUAL(0, candidates[2].index);
+}
+
+TEST(wifiman_rank, rank_ShouldPreferSecure_WhenRssiSimilar) {
+	scanned("open", -60, 1, WIFIMAN_SECURITY_OPEN);
+	scanned("wpa2", -62, 2, WIFIMAN_SECURITY_WPA2);
+	saved_as("open", 0, 0, 0);
+	saved_as("wpa2", 1, 0, 0);
+
+	LONGS_EQUAL(2, rank());
+	LONGS_EQUAL(1, candidates[0].index);
+}
+
+TEST(wifiman_rank, rank_ShouldDemoteUnreliableNetwork) {
+	scanned("flaky", -55, 1, WIFIMAN_SECURITY_WPA2);
+	scanned("solid", -60, 2, WIFIMAN_SECURITY_WPA2);
+	saved_as("flaky", 0, 10, 1);
+	saved_as("solid", 1, 10, 10);
+
+	LONGS_EQUAL(2, rank());
+	LONGS_EQUAL(1, candidates[0].index);
+	LONGS_EQUAL(0, candidates[1].index);
+}
+
+TEST(wifiman_rank, rank_ShouldNotExceedMaxlen) {
+	scanned("a", -50, 1, WIFIMAN_SECURITY_WPA2);
+	scanned("b", -50, 2, WIFIMAN_SECURITY_WPA2);
+	saved_as("a", 0, 0, 0);
+	saved_as("b", 1, 0, 0);
+
+	LONGS_EQUAL(1, wifiman_rank(candidates, 1, scanlist, nr_scanned,
+				saved, nr_saved));
+}
@@ -1,18 +1,46 @@
-#include "libmcu/jobqueue.h"
 #include "jobpool.h"
+#include <string.h>
 
-bool jobpool_schedule(void (*job)(void *context), void *job_context)
+bool jobpool_schedule_prio(jobpool_prio_t prio,
+		void (*job)(void *context), void *job_context,
+		unsigned int deadline_ms)
 {
+	(void)prio;
+	(void)deadline_ms;
 	job(job_context);
 	return true;
 }
 
+bool jobpool_schedule(void (*job)(void *context), void *job_context)
+{
+	return jobpool_schedule_prio(JOBPOOL_PRIO_NORMAL, job, job_context, 0);
+}
+
 bool jobpool_init(void)
 {
 	return true;
 }
 
+void jobpool_deinit(void)
+{
+}
+
 unsigned int jobpool_count(void)
 {
 	return 0;
 }
+
+void jobpool_get_stats(struct jobpool_stats stats[JOBPOOL_STATS_MAX])
+{
+	memset(stats, 0, sizeof(*stats) * JOBPOOL_STATS_MAX);
+}
+
+unsigned int jobpool_get_max_depth(jobpool_prio_t prio)
+{
+	(void)prio;
+	return 0;
+}
+
+void jobpool_reset_stats(void)
+{
+}
@@ -0,0 +1,124 @@
+#include "sha256.h"
+#include <string.h>
+
+#define ROTR(x, n)		(((x) >> (n)) | ((x) << (32 - (n))))
+
+struct sha256_ctx {
+	uint32_t state[8];
+	uint64_t bitlen;
+	uint8_t data[64];
+	uint32_t datalen;
+};
+
+_Static_assert(sizeof(sha256_t) >= sizeof(struct sha256_ctx),
+		"sha256_t too small");
+
+static const uint32_t k[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+	0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+	0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+	0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+	0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+	0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static void transform(struct sha256_ctx *ctx, const uint8_t data[64])
+{
+	uint32_t w[64];
+	uint32_t a, b, c, d, e, f, g, h;
+
+	for (int i = 0; i < 16; i++) {
+		w[i] = (uint32_t)data[i*4] << 24 | (uint32_t)data[i*4+1] << 16
+			| (uint32_t)data[i*4+2] << 8 | (uint32_t)data[i*4+3];
+	}
+	for (int i = 16; i < 64; i++) {
+		uint32_t s0 = ROTR(w[i-15], 7) ^ ROTR(w[i-15], 18)
+			^ (w[i-15] >> 3);
+		uint32_t s1 = ROTR(w[i-2], 17) ^ ROTR(w[i-2], 19)
+			^ (w[i-2] >> 10);
+		w[i] = w[i-16] + s0 + w[i-7] + s1;
+	}
+
+	a = ctx->state[0]; b = ctx->state[1];
+	c = ctx->state[2]; d = ctx->state[3];
+	e = ctx->state[4]; f = ctx->state[5];
+	g = ctx->state[6]; h = ctx->state[7];
+
+	for (int i = 0; i < 64; i++) {
+		uint32_t s1 = ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25);
+		uint32_t ch = (e & f) ^ (~e & g);
+		uint32_t t1 = h + s1 + ch + k[i] + w[i];
+		uint32_t s0 = ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22);
+		uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+		uint32_t t2 = s0 + maj;
+
+		h = g; g = f; f = e; e = d + t1;
+		d = c; c = b; b = a; a = t1 + t2;
+	}
+
+	ctx->state[0] += a; ctx->state[1] += b;
+	ctx->state[2] += c; ctx->state[3] += d;
+	ctx->state[4] += e; ctx->state[5] += f;
+	ctx->state[6] += g; ctx->state[7] += h;
+}
+
+void sha256_start(sha256_t *obj)
+{
+	static const uint32_t init[8] = {
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+		0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+	};
+	struct sha256_ctx *ctx = (struct sha256_ctx *)obj;
+
+	memcpy(ctx->state, init, sizeof(init));
+	ctx->bitlen = 0;
+	ctx->datalen = 0;
+}
+
+void sha256_update(sha256_t *self, const void *data, size_t datasize)
+{
+	struct sha256_ctx *ctx = (struct sha256_ctx *)self;
+	const uint8_t *p = (const uint8_t *)data;
+
+	for (size_t i = 0; i < datasize; i++) {
+		ctx->data[ctx->datalen++] = p[i];
+		if (ctx->datalen == 64) {
+			transform(ctx, ctx->data);
+			ctx->bitlen += 512;
+			ctx->datalen = 0;
+		}
+	}
+}
+
+void sha256_finish(sha256_t *self, uint8_t digest[SHA256_DIGEST_SIZE])
+{
+	struct sha256_ctx *ctx = (struct sha256_ctx *)self;
+	uint32_t i = ctx->datalen;
+
+	ctx->bitlen += (uint64_t)ctx->datalen * 8;
+	ctx->data[i++] = 0x80;
+
+	if (ctx->datalen >= 56) {
+		memset(&ctx->data[i], 0, 64 - i);
+		transform(ctx, ctx->data);
+		i = 0;
+	}
+	memset(&ctx->data[i], 0, 56 - i);
+
+	for (int j = 0; j < 8; j++) {
+		ctx->data[63 - j] = (uint8_t)(ctx->bitlen >> (j * 8));
+	}
+	transform(ctx, ctx->data);
+
+	for (int j = 0; j < 8; j++) {
+		digest[j*4] = (uint8_t)(ctx->state[j] >> 24);
+		digest[j*4+1] = (uint8_t)(ctx->state[j] >> 16);
+		digest[j*4+2] = (uint8_t)(ctx->state[j] >> 8);
+		digest[j*4+3] = (uint8_t)ctx->state[j];
+	}
+}
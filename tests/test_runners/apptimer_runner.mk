@@ -0,0 +1,9 @@
+COMPONENT_NAME = apptimer
+
+SRC_FILES = \
+	../src/apptimer.c
+
+TEST_SRC_FILES = \
+	src/test_apptimer.cpp
+
+include test_runners/MakefileRunner.mk
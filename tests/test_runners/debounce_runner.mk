@@ -0,0 +1,9 @@
+COMPONENT_NAME = debounce
+
+SRC_FILES = \
+	../src/debounce.c
+
+TEST_SRC_FILES = \
+	src/test_debounce.cpp
+
+include test_runners/MakefileRunner.mk
@@ -0,0 +1,14 @@
+COMPONENT_NAME = flash_kvstore
+
+SRC_FILES = \
+	../src/flash_kvstore.c \
+	fakes/fake_flash.c
+
+TEST_SRC_FILES = \
+	src/test_flash_kvstore.cpp
+
+INCLUDE_DIRS += \
+	../components/dfu/include \
+	../external/libmcu/include
+
+include test_runners/MakefileRunner.mk
@@ -0,0 +1,9 @@
+COMPONENT_NAME = gesture
+
+SRC_FILES = \
+	../src/gesture.c
+
+TEST_SRC_FILES = \
+	src/test_gesture.cpp
+
+include test_runners/MakefileRunner.mk
@@ -0,0 +1,13 @@
+COMPONENT_NAME = heartbeat
+
+SRC_FILES = \
+	../src/heartbeat.c \
+	../src/histogram.c
+
+TEST_SRC_FILES = \
+	src/test_heartbeat.cpp
+
+INCLUDE_DIRS += \
+	../external/libmcu/include
+
+include test_runners/MakefileRunner.mk
@@ -0,0 +1,9 @@
+COMPONENT_NAME = histogram
+
+SRC_FILES = \
+	../src/histogram.c
+
+TEST_SRC_FILES = \
+	src/test_histogram.cpp
+
+include test_runners/MakefileRunner.mk
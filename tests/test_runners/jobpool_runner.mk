@@ -0,0 +1,15 @@
+COMPONENT_NAME = jobpool
+
+SRC_FILES = \
+	../src/jobpool.c \
+	stubs/logging.c
+
+TEST_SRC_FILES = \
+	src/test_jobpool.cpp
+
+INCLUDE_DIRS += \
+	../external/libmcu/include
+
+LD_LIBRARIES += -lpthread
+
+include test_runners/MakefileRunner.mk
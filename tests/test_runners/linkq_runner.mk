@@ -0,0 +1,9 @@
+COMPONENT_NAME = linkq
+
+SRC_FILES = \
+	../src/linkq.c
+
+TEST_SRC_FILES = \
+	src/test_linkq.cpp
+
+include test_runners/MakefileRunner.mk
@@ -0,0 +1,12 @@
+COMPONENT_NAME = logbin
+
+SRC_FILES = \
+	../src/logbin.c
+
+TEST_SRC_FILES = \
+	src/test_logbin.cpp
+
+INCLUDE_DIRS += \
+	../external/libmcu/include
+
+include test_runners/MakefileRunner.mk
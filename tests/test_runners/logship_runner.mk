@@ -0,0 +1,14 @@
+COMPONENT_NAME = logship
+
+SRC_FILES = \
+	../src/logship.c \
+	../src/logbin.c \
+	../src/lz.c
+
+TEST_SRC_FILES = \
+	src/test_logship.cpp
+
+INCLUDE_DIRS += \
+	../external/libmcu/include
+
+include test_runners/MakefileRunner.mk
@@ -0,0 +1,9 @@
+COMPONENT_NAME = lz
+
+SRC_FILES = \
+	../src/lz.c
+
+TEST_SRC_FILES = \
+	src/test_lz.cpp
+
+include test_runners/MakefileRunner.mk
@@ -0,0 +1,14 @@
+COMPONENT_NAME = netup
+
+SRC_FILES = \
+	../src/netup.c \
+	stubs/logging.c \
+	stubs/jobpool.c
+
+TEST_SRC_FILES = \
+	src/test_netup.cpp
+
+INCLUDE_DIRS += \
+	../external/libmcu/include
+
+include test_runners/MakefileRunner.mk
@@ -0,0 +1,16 @@
+COMPONENT_NAME = ota_http
+
+SRC_FILES = \
+	../components/ota/protocol/http.c \
+	stubs/logging.c
+
+TEST_SRC_FILES = \
+	src/test_ota_http.cpp
+
+INCLUDE_DIRS += \
+	../components/ota/include \
+	../external/libmcu/components/common/include
+
+LD_LIBRARIES += -lpthread
+
+include test_runners/MakefileRunner.mk
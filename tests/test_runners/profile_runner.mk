@@ -0,0 +1,9 @@
+COMPONENT_NAME = profile
+
+SRC_FILES = \
+	../src/profile.c
+
+TEST_SRC_FILES = \
+	src/test_profile.cpp
+
+include test_runners/MakefileRunner.mk
@@ -0,0 +1,15 @@
+COMPONENT_NAME = roaming
+
+SRC_FILES = \
+	../src/roaming.c \
+	stubs/logging.c \
+	stubs/jobpool.c
+
+TEST_SRC_FILES = \
+	src/test_roaming.cpp
+
+INCLUDE_DIRS += \
+	../external/libmcu/include \
+	../external/libmcu/examples
+
+include test_runners/MakefileRunner.mk
@@ -0,0 +1,16 @@
+COMPONENT_NAME = rules
+
+SRC_FILES = \
+	../src/rules.c \
+	../src/flash_kvstore.c \
+	fakes/fake_flash.c \
+	stubs/logging.c
+
+TEST_SRC_FILES = \
+	src/test_rules.cpp
+
+INCLUDE_DIRS += \
+	../components/dfu/include \
+	../external/libmcu/include
+
+include test_runners/MakefileRunner.mk
@@ -0,0 +1,13 @@
+COMPONENT_NAME = wifiman_event
+
+SRC_FILES = \
+	../src/wifiman_event.c \
+	stubs/logging.c
+
+TEST_SRC_FILES = \
+	src/test_wifiman_event.cpp
+
+INCLUDE_DIRS += \
+	../external/libmcu/include
+
+include test_runners/MakefileRunner.mk
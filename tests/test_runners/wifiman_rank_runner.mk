@@ -0,0 +1,9 @@
+COMPONENT_NAME = wifiman_rank
+
+SRC_FILES = \
+	../src/wifiman_rank.c
+
+TEST_SRC_FILES = \
+	src/test_wifiman_rank.cpp
+
+include test_runners/MakefileRunner.mk
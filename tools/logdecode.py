@@ -0,0 +1,224 @@
+#!/usr/bin/env python3
+"""Turns binary logs back into text with the elf of the build they came from.
+
+usage: logdecode.py <elf> [batch ...]
+
+Each batch is a payload as published, read from stdin when none given. See
+include/logbin.h for the format and include/logship.h for the compressed.
+"""
+
+import re
+import struct
+import sys
+
+LEVELS = ['VERBOSE', 'DEBUG', 'INFO', 'NOTICE', 'WARN', 'ERROR', 'ALERT']
+SHT_NOBITS = 8
+
+# must read the format the same way src/logbin.c does
+CONVERSION = re.compile(
+        r'%([-+ #0]*)(\*|\d*)(?:\.(\*|\d*))?(hh|h|ll|l|j|z|t|L)?(.?)',
+        re.DOTALL)
+
+
+class Elf:
+    def __init__(self, path):
+        with open(path, 'rb') as f:
+            self.data = f.read()
+        if self.data[:4] != b'\x7fELF':
+            raise ValueError('%s: not an elf' % path)
+        is64 = self.data[4] == 2
+        endian = '<' if self.data[5] == 1 else '>'
+        if is64:
+            shoff, = struct.unpack_from(endian + 'Q', self.data, 0x28)
+            shentsize, shnum = struct.unpack_from(endian + 'HH',
+                    self.data, 0x3a)
+            layout = endian + 'IIQQQQ'
+        else:
+            shoff, = struct.unpack_from(endian + 'I', self.data, 0x20)
+            shentsize, shnum = struct.unpack_from(endian + 'HH',
+                    self.data, 0x2e)
+            layout = endian + 'IIIIII'
+        self.sections = []
+        for i in range(shnum):
+            _, sh_type, _, addr, offset, size = struct.unpack_from(layout,
+                    self.data, shoff + i * shentsize)
+            if sh_type != SHT_NOBITS and addr != 0 and size != 0:
+                self.sections.append((addr, offset, size))
+
+    def get_string(self, addr):
+        for base, offset, size in self.sections:
+            if base <= addr < base + size:
+                start = offset + addr - base
+                end = self.data.index(b'\0', start, offset + size)
+                return self.data[start:end].decode('utf-8', 'replace')
+        return None
+
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def left(self):
+        return len(self.data) - self.pos
+
+    def u8(self):
+        value = self.data[self.pos]
+        self.pos += 1
+        return value
+
+    def varint(self):
+        value = shift = 0
+        while True:
+            byte = self.u8()
+            value |= (byte & 0x7f) << shift
+            shift += 7
+            if not byte & 0x80:
+                return value
+
+    def signed(self):
+        value = self.varint()
+        return (value >> 1) ^ -(value & 1)
+
+    def double(self):
+        value, = struct.unpack_from('<d', self.data, self.pos)
+        self.pos += 8
+        return value
+
+    def string(self):
+        n = self.u8()
+        value = self.data[self.pos:self.pos + n]
+        self.pos += n
+        return value.decode('utf-8', 'replace')
+
+
+def get_arg(args, conversion):
+    if conversion in 'di':
+        return args.signed()
+    if conversion in 'uoxXcp':
+        return args.varint()
+    if conversion == 's':
+        return args.string()
+    if conversion in 'eEfFgGaA':
+        return args.double()
+    return None
+
+
+def format_arg(args, m):
+    flags, width, precision, _, conversion = m.groups()
+    if conversion in ('%', ''):
+        return '%' if conversion else ''
+    if conversion == 'n':
+        return ''
+
+    values = []
+    if width == '*':
+        values.append(args.signed())
+    if precision == '*':
+        values.append(args.signed())
+    values.append(get_arg(args, conversion))
+
+    if conversion == 'p':
+        conversion, flags = 'x', flags + '#'
+    elif conversion in 'aA':
+        return float.hex(values[-1])
+    elif conversion == 'c':
+        values[-1] = chr(values[-1])
+    elif conversion not in 'diouxXeEfFgGs':
+        return m.group(0)
+
+    spec = '%' + flags + (width or '')
+    if precision is not None:
+        spec += '.' + (precision or '0')
+    return (spec + conversion) % tuple(values)
+
+
+def format_message(fmt, args):
+    def substitute(m):
+        if args.left() <= 0 and m.group(5) not in ('%', '', 'n'):
+            return '<?>'
+        try:
+            return format_arg(args, m)
+        except (IndexError, struct.error):
+            args.pos = len(args.data)
+            return '<?>'
+    return CONVERSION.sub(substitute, fmt)
+
+
+def lz_decompress(data):
+    out = bytearray()
+    pos = 0
+    while pos < len(data):
+        flags = data[pos]
+        pos += 1
+        for bit in range(8):
+            if pos >= len(data):
+                break
+            if not flags & (1 << bit):
+                out.append(data[pos])
+                pos += 1
+                continue
+            distance = (data[pos] | (data[pos + 1] >> 4) << 8) + 1
+            length = (data[pos + 1] & 0xf) + 3
+            pos += 2
+            for _ in range(length):
+                out.append(out[-distance])
+    return bytes(out)
+
+
+def unpack(batch):
+    if len(batch) < 2 or batch[0] != ord('Z'):
+        return batch
+    if batch[1] != 1:
+        raise ValueError('unknown version of compressed batch')
+    header = Reader(batch[2:])
+    length = header.varint()
+    batch = lz_decompress(batch[2 + header.pos:])
+    if len(batch) != length:
+        raise ValueError('broken compressed batch')
+    return batch
+
+
+def decode(elf, batch, out):
+    batch = unpack(batch)
+    if len(batch) < 2 or batch[0] != ord('L') or batch[1] != 1:
+        raise ValueError('not a binary log batch')
+
+    data = Reader(batch[2:])
+    while data.left() > 0:
+        length = data.u8()
+        record = Reader(data.data[data.pos:data.pos + length])
+        data.pos += length
+
+        level = record.u8()
+        timestamp = record.varint()
+        addr = record.varint()
+        fmt = elf.get_string(addr)
+        level = LEVELS[level] if level < len(LEVELS) else str(level)
+
+        if fmt is None:
+            message = '<unknown format at 0x%x>' % addr
+        else:
+            args = Reader(record.data[record.pos:])
+            message = format_message(fmt, args)
+
+        out.write('%u.%03u: [%s] %s\n' % (timestamp // 1000,
+                timestamp % 1000, level, message))
+
+
+def main(argv):
+    if len(argv) < 2:
+        sys.stderr.write(__doc__)
+        return 1
+
+    elf = Elf(argv[1])
+    if len(argv) == 2:
+        decode(elf, sys.stdin.buffer.read(), sys.stdout)
+    for path in argv[2:]:
+        with open(path, 'rb') as f:
+            decode(elf, f.read(), sys.stdout)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))